@@ -0,0 +1,409 @@
+#include "AABBTree.h"
+
+using namespace std;
+using namespace glm;
+
+// Gribb and Hartmann, the planes point inwards so a box is outside when it lies behind any of them
+void Frustum::extract(const mat4& viewProjection)
+{
+	const mat4& m = viewProjection;
+	vec4 row0 = vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+	vec4 row1 = vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+	vec4 row2 = vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+	vec4 row3 = vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	const vec4 planes[8] =
+	{
+		row3 + row0, row3 - row0, // Left, right
+		row3 + row1, row3 - row1, // Bottom, top
+		row3 + row2, row3 - row2, // Near, far
+		vec4(0, 0, 0, 1), vec4(0, 0, 0, 1)
+	};
+
+	for (int i = 0; i < 8; i++)
+	{
+		planeX[i] = planes[i].x;
+		planeY[i] = planes[i].y;
+		planeZ[i] = planes[i].z;
+		planeW[i] = planes[i].w;
+	}
+}
+
+// Signed distance of the box center against its projected radius, for four planes per iteration
+FrustumTest Frustum::testBox(const vec3& boxMin, const vec3& boxMax) const
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 centerX = _mm_set1_ps((boxMin.x + boxMax.x) * 0.5f);
+	__m128 centerY = _mm_set1_ps((boxMin.y + boxMax.y) * 0.5f);
+	__m128 centerZ = _mm_set1_ps((boxMin.z + boxMax.z) * 0.5f);
+	__m128 extentX = _mm_set1_ps((boxMax.x - boxMin.x) * 0.5f);
+	__m128 extentY = _mm_set1_ps((boxMax.y - boxMin.y) * 0.5f);
+	__m128 extentZ = _mm_set1_ps((boxMax.z - boxMin.z) * 0.5f);
+
+	bool inside = true;
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 x = _mm_load_ps(&planeX[i]);
+		__m128 y = _mm_load_ps(&planeY[i]);
+		__m128 z = _mm_load_ps(&planeZ[i]);
+		__m128 w = _mm_load_ps(&planeW[i]);
+
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, centerX), _mm_mul_ps(y, centerY)), _mm_add_ps(_mm_mul_ps(z, centerZ), w));
+		__m128 radius = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_andnot_ps(signMask, x), extentX),
+			_mm_mul_ps(_mm_andnot_ps(signMask, y), extentY)),
+			_mm_mul_ps(_mm_andnot_ps(signMask, z), extentZ));
+
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero)) != 0) return FRUSTUM_OUTSIDE;
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero)) != 0) inside = false;
+	}
+
+	return inside ? FRUSTUM_INSIDE : FRUSTUM_INTERSECT;
+}
+
+AABBTree::AABBTree(float margin)
+{
+	this->margin = margin;
+}
+
+AABBTree::~AABBTree()
+{
+}
+
+int AABBTree::allocateNode()
+{
+	if (freeList == -1)
+	{
+		nodes.push_back(AABBTreeNode());
+		freeList = (int)nodes.size() - 1;
+		nodes[freeList].parent = -1;
+	}
+
+	int node = freeList;
+	freeList = nodes[node].parent;
+
+	nodes[node].parent = -1;
+	nodes[node].left = -1;
+	nodes[node].right = -1;
+	nodes[node].height = 0;
+	nodes[node].userData = -1;
+	return node;
+}
+
+void AABBTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+// Box of the proxy, enlarged so small movements stay inside
+int AABBTree::createProxy(const vec3& boxMin, const vec3& boxMax, int userData)
+{
+	int proxy = allocateNode();
+	nodes[proxy].boxMin = boxMin - vec3(margin);
+	nodes[proxy].boxMax = boxMax + vec3(margin);
+	nodes[proxy].userData = userData;
+
+	insertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void AABBTree::destroyProxy(int proxy)
+{
+	if (proxy < 0 || proxy >= (int)nodes.size() || !nodes[proxy].isLeaf() || nodes[proxy].height != 0) return;
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxyCount--;
+}
+
+// Returns true if the proxy left its fat box and was reinserted
+bool AABBTree::moveProxy(int proxy, const vec3& boxMin, const vec3& boxMax)
+{
+	if (proxy < 0 || proxy >= (int)nodes.size()) return false;
+
+	AABBTreeNode& node = nodes[proxy];
+	if (all(lessThanEqual(node.boxMin, boxMin)) && all(greaterThanEqual(node.boxMax, boxMax))) return false;
+
+	removeLeaf(proxy);
+	nodes[proxy].boxMin = boxMin - vec3(margin);
+	nodes[proxy].boxMax = boxMax + vec3(margin);
+	insertLeaf(proxy);
+	return true;
+}
+
+static float surfaceArea(const vec3& boxMin, const vec3& boxMax)
+{
+	vec3 size = boxMax - boxMin;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Walk down to the sibling with the cheapest surface area increase, then refit the ancestors
+void AABBTree::insertLeaf(int leaf)
+{
+	if (root == -1)
+	{
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	vec3 leafMin = nodes[leaf].boxMin;
+	vec3 leafMax = nodes[leaf].boxMax;
+	int index = root;
+
+	while (!nodes[index].isLeaf())
+	{
+		const AABBTreeNode& node = nodes[index];
+		float area = surfaceArea(node.boxMin, node.boxMax);
+		float combinedArea = surfaceArea(min(node.boxMin, leafMin), max(node.boxMax, leafMax));
+
+		// Cost of a new parent for this node and the leaf, and the increase pushed down to the children
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		const int children[2] = { node.left, node.right };
+
+		for (int i = 0; i < 2; i++)
+		{
+			const AABBTreeNode& child = nodes[children[i]];
+			float enlargedArea = surfaceArea(min(child.boxMin, leafMin), max(child.boxMax, leafMax));
+			childCost[i] = (child.isLeaf() ? enlargedArea : enlargedArea - surfaceArea(child.boxMin, child.boxMax)) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].boxMin = min(nodes[sibling].boxMin, leafMin);
+	nodes[newParent].boxMax = max(nodes[sibling].boxMax, leafMax);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == -1)
+	{
+		root = newParent;
+	}
+	else if (nodes[oldParent].left == sibling)
+	{
+		nodes[oldParent].left = newParent;
+	}
+	else
+	{
+		nodes[oldParent].right = newParent;
+	}
+
+	refit(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+	if (grandParent == -1)
+	{
+		root = sibling;
+		nodes[sibling].parent = -1;
+		freeNode(parent);
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+	else nodes[grandParent].right = sibling;
+
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	refit(grandParent);
+}
+
+// Balance and recompute boxes and heights from a node up to the root
+void AABBTree::refit(int node)
+{
+	int index = node;
+
+	while (index != -1)
+	{
+		index = balance(index);
+
+		AABBTreeNode& current = nodes[index];
+		const AABBTreeNode& left = nodes[current.left];
+		const AABBTreeNode& right = nodes[current.right];
+
+		current.height = 1 + glm::max(left.height, right.height);
+		current.boxMin = min(left.boxMin, right.boxMin);
+		current.boxMax = max(left.boxMax, right.boxMax);
+
+		index = current.parent;
+	}
+}
+
+// Rotates the higher child up when the subtree heights differ by more than one, returns the new subtree root
+int AABBTree::balance(int iA)
+{
+	AABBTreeNode* A = &nodes[iA];
+	if (A->isLeaf() || A->height < 2) return iA;
+
+	int iB = A->left;
+	int iC = A->right;
+	AABBTreeNode* B = &nodes[iB];
+	AABBTreeNode* C = &nodes[iC];
+
+	int heightDifference = C->height - B->height;
+
+	// Rotate C up
+	if (heightDifference > 1)
+	{
+		int iF = C->left;
+		int iG = C->right;
+		AABBTreeNode* F = &nodes[iF];
+		AABBTreeNode* G = &nodes[iG];
+
+		C->left = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+
+		if (C->parent == -1) root = iC;
+		else if (nodes[C->parent].left == iA) nodes[C->parent].left = iC;
+		else nodes[C->parent].right = iC;
+
+		// The higher grandchild stays with C, the other one moves to A
+		AABBTreeNode* keep = (F->height > G->height) ? F : G;
+		AABBTreeNode* move = (F->height > G->height) ? G : F;
+		C->right = (F->height > G->height) ? iF : iG;
+		A->right = (F->height > G->height) ? iG : iF;
+		move->parent = iA;
+
+		A->boxMin = min(B->boxMin, move->boxMin);
+		A->boxMax = max(B->boxMax, move->boxMax);
+		C->boxMin = min(A->boxMin, keep->boxMin);
+		C->boxMax = max(A->boxMax, keep->boxMax);
+		A->height = 1 + glm::max(B->height, move->height);
+		C->height = 1 + glm::max(A->height, keep->height);
+
+		return iC;
+	}
+
+	// Rotate B up
+	if (heightDifference < -1)
+	{
+		int iD = B->left;
+		int iE = B->right;
+		AABBTreeNode* D = &nodes[iD];
+		AABBTreeNode* E = &nodes[iE];
+
+		B->left = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+
+		if (B->parent == -1) root = iB;
+		else if (nodes[B->parent].left == iA) nodes[B->parent].left = iB;
+		else nodes[B->parent].right = iB;
+
+		AABBTreeNode* keep = (D->height > E->height) ? D : E;
+		AABBTreeNode* move = (D->height > E->height) ? E : D;
+		B->right = (D->height > E->height) ? iD : iE;
+		A->left = (D->height > E->height) ? iE : iD;
+		move->parent = iA;
+
+		A->boxMin = min(C->boxMin, move->boxMin);
+		A->boxMax = max(C->boxMax, move->boxMax);
+		B->boxMin = min(A->boxMin, keep->boxMin);
+		B->boxMax = max(A->boxMax, keep->boxMax);
+		A->height = 1 + glm::max(C->height, move->height);
+		B->height = 1 + glm::max(A->height, keep->height);
+
+		return iB;
+	}
+
+	return iA;
+}
+
+// User data of all proxies touching the frustum, subtrees fully inside are collected without further tests
+void AABBTree::query(const Frustum& frustum, vector<int>& userData) const
+{
+	if (root == -1) return;
+
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = root;
+
+	while (stackSize > 0)
+	{
+		int index = stack[--stackSize];
+		const AABBTreeNode& node = nodes[index];
+
+		FrustumTest result = frustum.testBox(node.boxMin, node.boxMax);
+		if (result == FRUSTUM_OUTSIDE) continue;
+
+		if (result == FRUSTUM_INSIDE)
+		{
+			appendLeaves(index, userData);
+		}
+		else if (node.isLeaf())
+		{
+			userData.push_back(node.userData);
+		}
+		else
+		{
+			stack[stackSize++] = node.left;
+			stack[stackSize++] = node.right;
+		}
+	}
+}
+
+void AABBTree::appendLeaves(int node, vector<int>& userData) const
+{
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = node;
+
+	while (stackSize > 0)
+	{
+		const AABBTreeNode& current = nodes[stack[--stackSize]];
+
+		if (current.isLeaf())
+		{
+			userData.push_back(current.userData);
+		}
+		else
+		{
+			stack[stackSize++] = current.left;
+			stack[stackSize++] = current.right;
+		}
+	}
+}
+
+int AABBTree::getProxyCount() const
+{
+	return proxyCount;
+}
+
+int AABBTree::getHeight() const
+{
+	return (root == -1) ? 0 : nodes[root].height;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "global.h"
+#include <xmmintrin.h>
+
+enum FrustumTest
+{
+	FRUSTUM_OUTSIDE = 0,
+	FRUSTUM_INTERSECT,
+	FRUSTUM_INSIDE
+};
+
+// Planes of a view projection matrix in structure of arrays form, so SSE tests four planes at once.
+// The six planes are padded to eight with planes that never cull.
+struct Frustum
+{
+	alignas(16) float planeX[8];
+	alignas(16) float planeY[8];
+	alignas(16) float planeZ[8];
+	alignas(16) float planeW[8];
+
+	void extract(const glm::mat4& viewProjection);
+	FrustumTest testBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
+
+struct AABBTreeNode
+{
+	glm::vec3 boxMin, boxMax; // Leaves store the fattened box of their proxy
+	int parent; // Next free node while on the free list
+	int left, right;
+	int height; // Leaves are 0, free nodes -1
+	int userData;
+
+	bool isLeaf() const { return left == -1; }
+};
+
+// Dynamic AABB tree (as in Box2D's b2DynamicTree). Leaves are proxies with a box enlarged by a margin,
+// objects that move within their fat box cost nothing, others are removed and reinserted with rotations
+// keeping the tree balanced. Frustum queries skip the tests below nodes that are fully inside.
+class AABBTree
+{
+
+private:
+
+	std::vector<AABBTreeNode> nodes;
+	int root = -1;
+	int freeList = -1;
+	int proxyCount = 0;
+	float margin;
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+	void refit(int node);
+	void appendLeaves(int node, std::vector<int>& userData) const;
+
+public:
+
+	AABBTree(float margin = 0.05f);
+	~AABBTree();
+
+	int createProxy(const glm::vec3& boxMin, const glm::vec3& boxMax, int userData);
+	void destroyProxy(int proxy);
+	bool moveProxy(int proxy, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	void query(const Frustum& frustum, std::vector<int>& userData) const;
+
+	int getProxyCount() const;
+	int getHeight() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "BlueNoise.h"
+
+using namespace std;
+using namespace glm;
+
+BlueNoise::BlueNoise(string filepath)
+{
+	int width, height, channels;
+	GLubyte* data = stbi_load(filepath.c_str(), &width, &height, &channels, 4);
+
+	if (data == 0 || width == 0 || width != height)
+	{
+		cout << "Error loading blue noise: " << filepath << endl;
+		stbi_image_free(data);
+		return;
+	}
+
+	textureSize = width;
+
+	// Nearest and unfiltered, every texel is one sample
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_2D, texId);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	stbi_image_free(data);
+
+	cout << "Blue noise loaded: " << filepath << endl;
+}
+
+BlueNoise::~BlueNoise()
+{
+	if (texId != 0) glDeleteTextures(1, &texId);
+}
+
+void BlueNoise::nextFrame()
+{
+	frameIndex++;
+
+	// Additive recurrence with the golden ratio, independent step per channel
+	frameOffset = fract(vec4((float)frameIndex) * vec4(0.61803398f, 0.75487766f, 0.56984029f, 0.43015971f));
+}
+
+// Bind the noise to a texture unit and upload the sampler and frame offset of the given shader
+void BlueNoise::bind(GLuint shaderId, int unit, bool animated) const
+{
+	vec4 offset = animated ? frameOffset : vec4(0);
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texId);
+
+	glUniform1i(Shader::getUniformLocation(shaderId, "blueNoise"), unit);
+	glUniform4fv(Shader::getUniformLocation(shaderId, "blueNoiseOffset"), 1, value_ptr(offset));
+	glUniform1i(Shader::getUniformLocation(shaderId, "useBlueNoise"), texId != 0);
+}
+
+GLuint BlueNoise::getTextureId() const
+{
+	return texId;
+}
+
+int BlueNoise::getTextureSize() const
+{
+	return textureSize;
+}
+
+int BlueNoise::getFrameIndex() const
+{
+	return frameIndex;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "global.h"
+#include "Shader.h"
+#include <stb_image.h>
+
+// Tileable blue noise shared by every stochastic pass, generated offline by tools/bluenoise.
+// Each frame shifts the values along the golden ratio sequence so the noise is also blue over time,
+// passes without temporal accumulation bind it unshifted to keep a still pattern.
+class BlueNoise
+{
+
+private:
+
+	GLuint texId = 0;
+	int textureSize = 0;
+	int frameIndex = 0;
+	glm::vec4 frameOffset = glm::vec4(0);
+
+public:
+
+	BlueNoise(std::string filepath);
+	~BlueNoise();
+
+	void nextFrame();
+	void bind(GLuint shaderId, int unit, bool animated) const;
+
+	GLuint getTextureId() const;
+	int getTextureSize() const;
+	int getFrameIndex() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "ClusteredLights.h"
+
+using namespace std;
+using namespace glm;
+
+ClusteredLights::ClusteredLights()
+{
+	assignShader = new Shader("lightClusters");
+	initializeShaders();
+
+	glGenBuffers(1, &lightBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxLights * sizeof(PointLight), NULL, GL_DYNAMIC_DRAW);
+
+	// Every cluster holds its light count followed by a fixed number of light indices
+	glGenBuffers(1, &clusterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, clustersX * clustersY * clustersZ * (maxLightsPerCluster + 1) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	delete assignShader;
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+}
+
+void ClusteredLights::initializeShaders()
+{
+	assignShader->apply();
+	glUniform3i(assignShader->getUniformLocation("clusterCount"), clustersX, clustersY, clustersZ);
+	assignShader->setUniform("maxLightsPerCluster", maxLightsPerCluster);
+	assignShader->setUniform("clusterNear", clusterNear);
+	assignShader->setUniform("clusterFar", clusterFar);
+}
+
+void ClusteredLights::recompileShaders()
+{
+	assignShader->recompile();
+	initializeShaders();
+}
+
+// Rebuild the cluster lists for the current camera, needs the MatCam uniform buffer of this frame
+void ClusteredLights::assign()
+{
+	if (lights.empty()) return;
+
+	if (lightsChanged)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lights.size() * sizeof(PointLight), &lights[0]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		lightsChanged = false;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, clusterBuffer);
+
+	assignShader->apply();
+	assignShader->setUniform("lightCount", (int)lights.size());
+
+	int clusterCount = clustersX * clustersY * clustersZ;
+	glDispatchCompute((clusterCount + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Without lights the lighting pass skips the cluster lookup entirely
+void ClusteredLights::bind(GLuint shaderId) const
+{
+	glUniform1i(Shader::getUniformLocation(shaderId, "useClusteredLights"), !lights.empty());
+	if (lights.empty()) return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, clusterBuffer);
+
+	glUniform3i(Shader::getUniformLocation(shaderId, "clusterCount"), clustersX, clustersY, clustersZ);
+	glUniform1i(Shader::getUniformLocation(shaderId, "maxLightsPerCluster"), maxLightsPerCluster);
+	glUniform1f(Shader::getUniformLocation(shaderId, "clusterNear"), clusterNear);
+	glUniform1f(Shader::getUniformLocation(shaderId, "clusterFar"), clusterFar);
+}
+
+void ClusteredLights::addLight(vec3 position, float radius, vec3 color)
+{
+	if ((int)lights.size() >= maxLights)
+	{
+		cout << "Too many lights, at most " << maxLights << endl;
+		return;
+	}
+
+	PointLight light;
+	light.positionRadius = vec4(position, radius);
+	light.color = vec4(color, 1.0f);
+	lights.push_back(light);
+	lightsChanged = true;
+}
+
+void ClusteredLights::clearLights()
+{
+	lights.clear();
+	lightsChanged = true;
+}
+
+int ClusteredLights::getLightCount() const
+{
+	return (int)lights.size();
+}
+
+int ClusteredLights::getMaxLights() const
+{
+	return maxLights;
+}
+
+const std::vector<PointLight>& ClusteredLights::getLights() const
+{
+	return lights;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "global.h"
+#include "Shader.h"
+
+// std430 layout of one light in the LightData buffer
+struct PointLight
+{
+	glm::vec4 positionRadius; // World position, distance at which the light has faded out
+	glm::vec4 color; // Linear color times intensity
+};
+
+// Clustered light assignment (Olsson et al. 2012). A compute pass bins the virtual point lights into
+// view space froxels every frame, the lighting pass only loops over the lights of its own cluster.
+class ClusteredLights
+{
+
+private:
+
+	const int clustersX = 16;
+	const int clustersY = 9;
+	const int clustersZ = 24;
+	const int maxLights = 1024;
+	const int maxLightsPerCluster = 63;
+
+	// Depth slices are exponential between these view distances
+	float clusterNear = 0.05f;
+	float clusterFar = 20.0f;
+
+	Shader* assignShader;
+	GLuint lightBuffer, clusterBuffer;
+	std::vector<PointLight> lights;
+	bool lightsChanged = true;
+
+public:
+
+	ClusteredLights();
+	~ClusteredLights();
+
+	void initializeShaders();
+	void recompileShaders();
+	void assign();
+	void bind(GLuint shaderId) const;
+
+	void addLight(glm::vec3 position, float radius, glm::vec3 color);
+	void clearLights();
+
+	int getLightCount() const;
+	int getMaxLights() const;
+	const std::vector<PointLight>& getLights() const;
+
+};
\ No newline at end of file
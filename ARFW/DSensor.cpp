@@ -16,32 +16,24 @@ DSensor::~DSensor()
 		device.close();
 		openni::OpenNI::shutdown();
 	}
+
+	if (sensorBlock != nullptr) delete sensorBlock;
 }
 
 void DSensor::initializeShaders()
 {
-	temporalMedianShader->apply();
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "dsColor"), 0);
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "dsDepth"), 1);
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "kernelRadius"), tmfKernelRadius);
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "frameLayers"), tmfFrameLayers);
+	temporalMedianShader->setUniform("dsColor", 0);
+	temporalMedianShader->setUniform("dsDepth", 1);
 
-	medianShader->apply();
-	glUniform1i(glGetUniformLocation(medianShader->getShaderId(), "dsColor"), 0);
-	glUniform1i(glGetUniformLocation(medianShader->getShaderId(), "dsDepth"), 1);
-	glUniform1i(glGetUniformLocation(medianShader->getShaderId(), "kernelRadius"), fillKernelRadius);
+	medianShader->setUniform("dsColor", 0);
+	medianShader->setUniform("dsDepth", 1);
 
 	setBlurKernelRadius(blurKernelRadius);
-	blurShader->apply();
-	glUniform1i(glGetUniformLocation(blurShader->getShaderId(), "dsColor"), 0);
-	glUniform1i(glGetUniformLocation(blurShader->getShaderId(), "dsDepth"), 1);
-	glUniform1i(glGetUniformLocation(blurShader->getShaderId(), "kernelRadius"), blurKernelRadius);
-	glUniform1fv(glGetUniformLocation(blurShader->getShaderId(), "kernel"), blurKernelRadius * 2 + 1, &blurKernel[0]);
-	glUniform1f(glGetUniformLocation(blurShader->getShaderId(), "bsigma"), blurBSigma);
+	blurShader->setUniform("dsColor", 0);
+	blurShader->setUniform("dsDepth", 1);
 
-	positionShader->apply();
-	glUniform1i(glGetUniformLocation(positionShader->getShaderId(), "dsColor"), 0);
-	glUniform1i(glGetUniformLocation(positionShader->getShaderId(), "dsDepth"), 1);
+	positionShader->setUniform("dsColor", 0);
+	positionShader->setUniform("dsDepth", 1);
 }
 
 void DSensor::recompileShaders()
@@ -56,7 +48,7 @@ void DSensor::recompileShaders()
 	initializeShaders();
 }
 
-void DSensor::initialize(int windowWidth, int windowHeight)
+void DSensor::initialize(int windowWidth, int windowHeight, std::string recordingPath)
 {
 	printf("Initializing OpenNI:\n");
 
@@ -68,7 +60,8 @@ void DSensor::initialize(int windowWidth, int windowHeight)
 		return;
 	}
 
-	rc = device.open(openni::ANY_DEVICE);
+	// An .oni recording stands in for the device
+	rc = (recordingPath != "") ? device.open(recordingPath.c_str()) : device.open(openni::ANY_DEVICE);
 
 	if (rc != openni::STATUS_OK)
 	{
@@ -78,6 +71,13 @@ void DSensor::initialize(int windowWidth, int windowHeight)
 		return;
 	}
 
+	// Manual playback hands out the next frame on every read instead of following the recorded timing
+	if (device.isFile())
+	{
+		device.getPlaybackControl()->setSpeed(-1.0f);
+		device.getPlaybackControl()->setRepeatEnabled(true);
+	}
+
 	rc = depthStream.create(device, openni::SENSOR_DEPTH);
 	if (rc == openni::STATUS_OK)
 	{
@@ -172,6 +172,27 @@ void DSensor::initialize(int windowWidth, int windowHeight)
 	// Create projection matrix (depth)
 	float fovX = glm::degrees(depthStream.getHorizontalFieldOfView());
 	float fovY = glm::degrees(depthStream.getVerticalFieldOfView());
+
+	device.setImageRegistrationMode(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
+
+	if (!hasError)
+	{
+		printf("\tOK\n");
+		initOk = true;
+	}
+
+	createTargets(windowWidth, windowHeight, videoWidth, videoHeight, fovY);
+}
+
+// Stands the filter chain up without OpenNI at a given video resolution, frames come from uploadFrame.
+// The projection uses the vertical field of view of a Kinect.
+void DSensor::initializeSynthetic(int windowWidth, int windowHeight, int videoWidth, int videoHeight)
+{
+	createTargets(windowWidth, windowHeight, videoWidth, videoHeight, 45.6f);
+}
+
+void DSensor::createTargets(int windowWidth, int windowHeight, GLuint videoWidth, GLuint videoHeight, float fovY)
+{
 	float w = (float)windowWidth / videoWidth;
 	float h = (float)windowHeight / videoHeight;
 	matProjection = glm::perspective(glm::radians(fovY), w / h, 0.0001f, 10.0f);
@@ -190,14 +211,6 @@ void DSensor::initialize(int windowWidth, int windowHeight)
 	bufferWidth = texWidth;
 	bufferHeight = texHeight;
 
-	device.setImageRegistrationMode(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
-
-	if (!hasError)
-	{
-		printf("\tOK\n");
-		initOk = true;
-	}
-
 	glGenTextures(1, &dsColorMap);
 	glBindTexture(GL_TEXTURE_2D, dsColorMap);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, texWidth, texHeight, 0, GL_RGB, GL_FLOAT, NULL);
@@ -221,6 +234,7 @@ void DSensor::initialize(int windowWidth, int windowHeight)
 	medianShader = new Shader("dsMedian");
 	positionShader = new Shader("dsPosition");
 	blurShader = new Shader("dsBlur");
+	sensorBlock = new UniformBlock<SensorParameters>(15);
 	initializeShaders();
 	
 	glGenFramebuffers(1, &fbo);
@@ -338,6 +352,8 @@ void DSensor::update()
 	}
 
 	// Copy color data from kinect into color buffer
+	GpuProfileScope uploadScope(profiler, "sensorUpload");
+
 	if (colorFrame.isValid())
 	{
 		const openni::RGB888Pixel* imageBuffer = (const openni::RGB888Pixel*)colorFrame.getData();
@@ -393,92 +409,135 @@ void DSensor::update()
 		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, texWidth, texHeight, 1, GL_RED, GL_UNSIGNED_SHORT, texDepthMap);
 	}
 
+	uploadScope.end();
+
 	if (depthFrame.isValid())
 	{
-		// Filp kinect y textures
-		// Temporal median filter pass
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-		glViewport(0, 0, bufferWidth, bufferHeight);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		filterFrame();
+	}
+}
 
-		temporalMedianShader->apply();
+// Feeds a frame that did not come from OpenNI, the depth already mapped to 16 bit as update does it
+void DSensor::uploadFrame(const uint16_t* depth, const uint8_t* color)
+{
+	glBindTexture(GL_TEXTURE_2D, dsColorMap);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, color);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, dsColorMap);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, dsDepthMap);
+	// Same layer rotation as update, the previous frame moves into the history
+	if (dsDepthMapLayerCounter == tmfFrameLayers) dsDepthMapLayerCounter = 1;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, dsDepthMap);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, dsDepthMapLayerCounter++, texWidth, texHeight, 1, GL_RED, GL_UNSIGNED_SHORT, texDepthMap);
 
-		quad->draw();
+	memcpy(texDepthMap, depth, texWidth * texHeight * sizeof(uint16_t));
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, texWidth, texHeight, 1, GL_RED, GL_UNSIGNED_SHORT, texDepthMap);
+}
 
-		// Fill holes passes
-		GLuint currFbo = fbo2;
-		GLuint currColorMap = outColorMap;
-		GLuint currDepthMap = outDepthMap;
-		for (int i = 0; i < fillPasses; i++)
-		{
-			glBindFramebuffer(GL_FRAMEBUFFER, currFbo);
-			glViewport(0, 0, bufferWidth, bufferHeight);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// Temporal median, hole filling, bilateral blur and the position and normal reconstruction of the latest frame
+void DSensor::filterFrame()
+{
+	// Filter settings of all passes, uploaded only after the GUI changed them
+	SensorParameters parameters = {};
+	parameters.temporalKernelRadius = tmfKernelRadius;
+	parameters.temporalFrameLayers = tmfFrameLayers;
+	parameters.fillKernelRadius = fillKernelRadius;
+	parameters.blurKernelRadius = blurKernelRadius;
+	parameters.blurBSigma = blurBSigma;
+	sensorBlock->set(parameters);
+	sensorBlock->bind();
 
-			medianShader->apply();
+	// Filp kinect y textures
+	// Temporal median filter pass
+	GpuProfileScope temporalMedianScope(profiler, "temporalMedian");
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, bufferWidth, bufferHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, currColorMap);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, currDepthMap);
+	temporalMedianShader->apply();
 
-			quad->draw();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, dsColorMap);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, dsDepthMap);
 
-			currFbo = currFbo == fbo2 ? fbo : fbo2;
-			currColorMap = currColorMap == outColorMap ? outColorMap2 : outColorMap;
-			currDepthMap = currDepthMap == outDepthMap ? outDepthMap2 : outDepthMap;
-		}
+	quad->draw();
 
-		// Gaussian filter pass (seperated passes)
-		currFbo = fbo2;
-		currColorMap = outColorMap;
-		currDepthMap = outDepthMap;
-		int isVertical = 0;
-		for (int i = 0; i < 2; i++)
-		{
-			glBindFramebuffer(GL_FRAMEBUFFER, currFbo);
-			glViewport(0, 0, bufferWidth, bufferHeight);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	temporalMedianScope.end();
+
+	// Fill holes passes
+	GpuProfileScope fillScope(profiler, "fillHoles");
+	GLuint currFbo = fbo2;
+	GLuint currColorMap = outColorMap;
+	GLuint currDepthMap = outDepthMap;
+	for (int i = 0; i < fillPasses; i++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, currFbo);
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			blurShader->apply();
-			glUniform1i(glGetUniformLocation(blurShader->getShaderId(), "isVertical"), isVertical);
+		medianShader->apply();
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, currColorMap);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, currDepthMap);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, currColorMap);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, currDepthMap);
 
-			quad->draw();
+		quad->draw();
 
-			isVertical++;
-			currFbo = currFbo == fbo2 ? fbo : fbo2;
-			currColorMap = currColorMap == outColorMap ? outColorMap2 : outColorMap;
-			currDepthMap = currDepthMap == outDepthMap ? outDepthMap2 : outDepthMap;
-		}
+		currFbo = currFbo == fbo2 ? fbo : fbo2;
+		currColorMap = currColorMap == outColorMap ? outColorMap2 : outColorMap;
+		currDepthMap = currDepthMap == outDepthMap ? outDepthMap2 : outDepthMap;
+	}
+
+	fillScope.end();
 
-		// Generate position and normal pass
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo2);
+	// Gaussian filter pass (seperated passes)
+	GpuProfileScope blurScope(profiler, "bilateral");
+	currFbo = fbo2;
+	currColorMap = outColorMap;
+	currDepthMap = outDepthMap;
+	int isVertical = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, currFbo);
 		glViewport(0, 0, bufferWidth, bufferHeight);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		positionShader->apply();
+		blurShader->apply();
+		blurShader->setUniform("isVertical", isVertical);
 
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, outColorMap);
+		glBindTexture(GL_TEXTURE_2D, currColorMap);
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, outDepthMap);
+		glBindTexture(GL_TEXTURE_2D, currDepthMap);
 
 		quad->draw();
 
-		
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		isVertical++;
+		currFbo = currFbo == fbo2 ? fbo : fbo2;
+		currColorMap = currColorMap == outColorMap ? outColorMap2 : outColorMap;
+		currDepthMap = currDepthMap == outDepthMap ? outDepthMap2 : outDepthMap;
 	}
+
+	blurScope.end();
+
+	// Generate position and normal pass
+	GpuProfileScope positionScope(profiler, "position");
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo2);
+	glViewport(0, 0, bufferWidth, bufferHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	positionShader->apply();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, outColorMap);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, outDepthMap);
+
+	quad->draw();
+
+	frameRevision++;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void DSensor::updateThread(std::atomic<bool>& isRunning, unsigned int updateInterval)
@@ -573,6 +632,11 @@ glm::mat4 DSensor::getMatProjectionInverse() const
 	return matProjectionInverse;
 }
 
+int DSensor::getFrameRevision() const
+{
+	return frameRevision;
+}
+
 int DSensor::getTMFKernelRadius() const
 {
 	return tmfKernelRadius;
@@ -611,26 +675,17 @@ float DSensor::getBlurBSigma() const
 void DSensor::setTMFKernelRadius(int value)
 {
 	tmfKernelRadius = value;
-
-	temporalMedianShader->apply();
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "kernelRadius"), tmfKernelRadius);
 }
 
 void DSensor::setTMFFrameLayers(int value)
 {
 	tmfFrameLayers = min(value, tmfMaxFrameLayers);
 	dsDepthMapLayerCounter = 1;
-
-	temporalMedianShader->apply();
-	glUniform1i(glGetUniformLocation(temporalMedianShader->getShaderId(), "frameLayers"), tmfFrameLayers);
 }
 
 void DSensor::setFillKernelRaidus(int value)
 {
 	fillKernelRadius = value;
-
-	medianShader->apply();
-	glUniform1i(glGetUniformLocation(medianShader->getShaderId(), "kernelRadius"), fillKernelRadius);
 }
 
 void DSensor::setFillPasses(int value)
@@ -653,9 +708,7 @@ void DSensor::computeBlurKernel()
 		blurKernel.at(blurKernelRadius + i) = blurKernel.at(blurKernelRadius - i) = value;
 	}
 
-	blurShader->apply();
-	glUniform1i(glGetUniformLocation(blurShader->getShaderId(), "kernelRadius"), blurKernelRadius);
-	glUniform1fv(glGetUniformLocation(blurShader->getShaderId(), "kernel"), blurKernelRadius * 2 + 1, &blurKernel[0]);
+	blurShader->setUniformArray("kernel", blurKernelRadius * 2 + 1, &blurKernel[0]);
 }
 
 void DSensor::setBlurKernelRadius(int value)
@@ -673,8 +726,11 @@ void DSensor::setBlurSigma(float value)
 void DSensor::setBlurBSigma(float value)
 {
 	blurBSigma = value;
-	blurShader->apply();
-	glUniform1f(glGetUniformLocation(blurShader->getShaderId(), "bsigma"), blurBSigma);
+}
+
+void DSensor::setProfiler(GpuProfiler* profiler)
+{
+	this->profiler = profiler;
 }
 
 
@@ -3,6 +3,8 @@
 #include "global.h"
 #include "Quad.h"
 #include "Shader.h"
+#include "UniformBlock.h"
+#include "GpuProfiler.h"
 #include <OpenNI2\OpenNI.h>
 #include <chrono>
 #include <thread>
@@ -10,6 +12,17 @@
 
 const GLuint maxDepth = 10000;
 
+// Depth filter settings shared by the sensor passes, std140 block at binding 15
+struct SensorParameters
+{
+	int temporalKernelRadius;
+	int temporalFrameLayers;
+	int fillKernelRadius;
+	int blurKernelRadius;
+	float blurBSigma;
+	float padding[3];
+};
+
 class DSensor
 {
 
@@ -26,6 +39,7 @@ private:
 
 	GLuint dsColorMap, dsDepthMap;
 	int dsDepthMapLayerCounter = 1;
+	int frameRevision = 0; // Counts the filtered frames, the output maps only change with it
 
 	GLuint minNumChunks(GLuint dataSize, GLuint chunkSize);
 	GLuint minChunkSize(GLuint dataSize, GLuint chunkSize);
@@ -41,6 +55,8 @@ private:
 	Shader* medianShader;
 	Shader* positionShader;
 	Shader* blurShader;
+	UniformBlock<SensorParameters>* sensorBlock = nullptr;
+	GpuProfiler* profiler = nullptr;
 
 	int tmfKernelRadius = 1;
 	int tmfFrameLayers = 10;
@@ -58,6 +74,7 @@ private:
 
 	float normpdf(float x, float s);
 	void computeBlurKernel();
+	void createTargets(int windowWidth, int windowHeight, GLuint videoWidth, GLuint videoHeight, float fovY);
 
 	std::vector<glm::vec3> customPositions;
 	std::vector<glm::vec3> customNormals;
@@ -71,8 +88,11 @@ public:
 	void initializeShaders();
 	void recompileShaders();
 
-	void initialize(int windowWidth, int windowHeight);
+	void initialize(int windowWidth, int windowHeight, std::string recordingPath = "");
+	void initializeSynthetic(int windowWidth, int windowHeight, int videoWidth, int videoHeight);
 	void update();
+	void uploadFrame(const uint16_t* depth, const uint8_t* color);
+	void filterFrame();
 
 	void launchUpdateThread();
 	void updateThread(std::atomic<bool>& isRunning, unsigned int updateInterval);
@@ -86,6 +106,7 @@ public:
 	GLuint getNormalMapId() const;
 	glm::mat4 getMatProjection() const;
 	glm::mat4 getMatProjectionInverse() const;
+	int getFrameRevision() const;
 	
 	int getTMFKernelRadius() const;
 	int getTMFFrameLayers() const;
@@ -102,5 +123,6 @@ public:
 	void setBlurKernelRadius(int value);
 	void setBlurSigma(float value);
 	void setBlurBSigma(float value);
+	void setProfiler(GpuProfiler* profiler);
 
 };
\ No newline at end of file
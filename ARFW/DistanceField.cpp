@@ -0,0 +1,196 @@
+#include "DistanceField.h"
+#include <cfloat>
+#include <thread>
+
+using namespace std;
+using namespace glm;
+
+DistanceField::DistanceField(const Model* model, int resolution)
+{
+	this->resolution = resolution;
+
+	vector<vec3> corners = model->getTriangleCorners();
+	triangleCount = (int)corners.size() / 3;
+
+	if (triangleCount == 0)
+	{
+		cout << "No triangles to bake a distance field from: " << model->getFilepath() << endl;
+		return;
+	}
+
+	boundsMin = vec3(FLT_MAX);
+	boundsMax = vec3(-FLT_MAX);
+
+	for (const vec3& corner : corners)
+	{
+		boundsMin = min(boundsMin, corner);
+		boundsMax = max(boundsMax, corner);
+	}
+
+	// Pad the bounds so shadows and occlusion still fade out around the surface
+	vec3 padding = vec3(compMax(boundsMax - boundsMin) * 0.15f);
+	boundsMin -= padding;
+	boundsMax += padding;
+	distanceRange = length(boundsMax - boundsMin) * 0.25f;
+
+	string filepath = model->getFilepath();
+	filepath = filepath.substr(0, filepath.find_last_of('.')) + ".sdf";
+
+	// Without a cached file the bake blocks startup, later launches load the saved result
+	if (!load(filepath))
+	{
+		cout << "No cached distance field, baking " << filepath << " once during startup" << endl;
+		double bakeStart = glfwGetTime();
+		bake(corners);
+		save(filepath);
+		cout << "Distance field baked in " << glfwGetTime() - bakeStart << " s" << endl;
+	}
+
+	upload();
+}
+
+DistanceField::~DistanceField()
+{
+	glDeleteTextures(1, &texId);
+}
+
+void DistanceField::bake(const vector<vec3>& corners)
+{
+	cout << "Baking " << resolution << "^3 distance field over " << triangleCount << " triangles..." << endl;
+
+	TriangleBVH bvh(corners);
+	voxels.assign(resolution * resolution * resolution, 0);
+
+	// Ray directions are slightly skewed so they never run along mesh edges
+	const vec3 parityDirections[3] = { normalize(vec3(1.0f, 0.0013f, 0.0007f)),
+		normalize(vec3(0.0011f, 1.0f, 0.0017f)), normalize(vec3(0.0019f, 0.0005f, 1.0f)) };
+
+	// Slices are interleaved over the threads
+	unsigned int threadCount = std::max(thread::hardware_concurrency(), 1u);
+	vector<thread> threads;
+
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(thread([&, t]()
+		{
+			for (int z = t; z < resolution; z += threadCount)
+			{
+				for (int y = 0; y < resolution; y++)
+				{
+					for (int x = 0; x < resolution; x++)
+					{
+						vec3 position = boundsMin + (vec3(x, y, z) + 0.5f) / (float)resolution * (boundsMax - boundsMin);
+						float distance = bvh.closestDistance(position);
+
+						// Inside if most parity rays cross the surface an odd number of times, tolerates small holes
+						int insideVotes = 0;
+						for (int i = 0; i < 3; i++) insideVotes += bvh.countHits(position, parityDirections[i]) % 2;
+						if (insideVotes >= 2) distance = -distance;
+
+						float value = glm::clamp(distance / distanceRange, -1.0f, 1.0f);
+						voxels[(z * resolution + y) * resolution + x] = (signed char)round(value * 127.0f);
+					}
+				}
+			}
+		}));
+	}
+
+	for (thread& t : threads) t.join();
+}
+
+// File layout: "SDF1", int32 resolution, int32 triangle count, voxels
+bool DistanceField::load(string filepath)
+{
+	ifstream file(filepath, ios::in | ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int header[2];
+
+	if (!file.read(magic, 4) || !file.read((char*)header, sizeof(header)) || string(magic, 4) != "SDF1")
+	{
+		cout << "Invalid distance field: " << filepath << endl;
+		return false;
+	}
+
+	// A different triangle count means the model changed since the bake
+	if (header[0] != resolution || header[1] != triangleCount) return false;
+
+	voxels.resize(resolution * resolution * resolution);
+
+	if (!file.read((char*)&voxels[0], voxels.size()))
+	{
+		cout << "Truncated distance field: " << filepath << endl;
+		return false;
+	}
+
+	return true;
+}
+
+void DistanceField::save(string filepath) const
+{
+	ofstream file(filepath, ios::out | ios::binary | ios::trunc);
+
+	if (!file.is_open())
+	{
+		cout << "Cannot write distance field: " << filepath << endl;
+		return;
+	}
+
+	int header[2] = { resolution, triangleCount };
+	file.write("SDF1", 4);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)&voxels[0], voxels.size());
+}
+
+void DistanceField::upload()
+{
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_3D, texId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8_SNORM, resolution, resolution, resolution, 0, GL_RED, GL_BYTE, &voxels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	// Only the texture is needed from here on
+	voxels.clear();
+	voxels.shrink_to_fit();
+}
+
+void DistanceField::bind(GLuint shaderId, int unit, int index) const
+{
+	string field = "distanceFields[" + to_string(index) + "]";
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_3D, texId);
+
+	glUniform1i(Shader::getUniformLocation(shaderId, field + ".volume"), unit);
+	glUniform3fv(Shader::getUniformLocation(shaderId, field + ".boundsMin"), 1, value_ptr(boundsMin));
+	glUniform3fv(Shader::getUniformLocation(shaderId, field + ".boundsMax"), 1, value_ptr(boundsMax));
+	glUniform1f(Shader::getUniformLocation(shaderId, field + ".distanceRange"), distanceRange);
+}
+
+GLuint DistanceField::getTextureId() const
+{
+	return texId;
+}
+
+vec3 DistanceField::getBoundsMin() const
+{
+	return boundsMin;
+}
+
+vec3 DistanceField::getBoundsMax() const
+{
+	return boundsMax;
+}
+
+float DistanceField::getDistanceRange() const
+{
+	return distanceRange;
+}
\ No newline at end of file
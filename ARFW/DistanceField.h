@@ -0,0 +1,40 @@
+#pragma once
+
+#include "global.h"
+#include "Model.h"
+#include "Shader.h"
+#include "TriangleBVH.h"
+
+// Signed distance field of a model, baked on all CPU threads against a triangle BVH
+// and stored as an 8 bit snorm 3D texture. The bake is cached next to the model as .sdf.
+class DistanceField
+{
+
+private:
+
+	GLuint texId = 0;
+	int resolution = 64;
+	int triangleCount = 0;
+	glm::vec3 boundsMin = glm::vec3(0);
+	glm::vec3 boundsMax = glm::vec3(0);
+	float distanceRange = 1.0f; // Distance of a stored 1.0, in model units
+	std::vector<signed char> voxels;
+
+	void bake(const std::vector<glm::vec3>& corners);
+	bool load(std::string filepath);
+	void save(std::string filepath) const;
+	void upload();
+
+public:
+
+	DistanceField(const Model* model, int resolution = 64);
+	~DistanceField();
+
+	void bind(GLuint shaderId, int unit, int index) const;
+
+	GLuint getTextureId() const;
+	glm::vec3 getBoundsMin() const;
+	glm::vec3 getBoundsMax() const;
+	float getDistanceRange() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "DistanceFieldShadows.h"
+
+using namespace std;
+using namespace glm;
+
+DistanceFieldShadows::DistanceFieldShadows()
+{
+}
+
+DistanceFieldShadows::~DistanceFieldShadows()
+{
+	for (DistanceField* field : fields) delete field;
+}
+
+// Takes ownership of the field, returns its index for addInstance or -1 when full
+int DistanceFieldShadows::addField(DistanceField* field)
+{
+	if ((int)fields.size() >= maxFields)
+	{
+		cout << "Too many distance fields, at most " << maxFields << endl;
+		delete field;
+		return -1;
+	}
+
+	fields.push_back(field);
+	return (int)fields.size() - 1;
+}
+
+void DistanceFieldShadows::clearInstances()
+{
+	instanceWorldToLocal.clear();
+	instanceScale.clear();
+	instanceField.clear();
+}
+
+// Instances beyond the limit are dropped and their shadows disappear, reported once
+void DistanceFieldShadows::addInstance(int field, const mat4& model)
+{
+	if (field < 0 || field >= (int)fields.size()) return;
+
+	if ((int)instanceField.size() >= maxInstances)
+	{
+		if (!warnedInstanceLimit) cout << "More than " << maxInstances << " distance field instances, the rest cast no shadows" << endl;
+		warnedInstanceLimit = true;
+		return;
+	}
+
+	if (fields[field]->getTextureId() == 0) return;
+
+	// Distances are traced in model space, the largest axis scale brings them back conservatively
+	float scale = std::max(std::max(length(vec3(model[0])), length(vec3(model[1]))), length(vec3(model[2])));
+
+	instanceWorldToLocal.push_back(inverse(model));
+	instanceScale.push_back(scale);
+	instanceField.push_back(field);
+}
+
+void DistanceFieldShadows::bind(GLuint shaderId, int firstUnit) const
+{
+	int instanceCount = enabled ? (int)instanceField.size() : 0;
+	glUniform1i(Shader::getUniformLocation(shaderId, "distanceFieldInstanceCount"), instanceCount);
+	if (instanceCount == 0) return;
+
+	for (int i = 0; i < (int)fields.size(); i++)
+	{
+		fields[i]->bind(shaderId, firstUnit + i, i);
+	}
+
+	glUniformMatrix4fv(Shader::getUniformLocation(shaderId, "instanceWorldToLocal"), instanceCount, GL_FALSE, value_ptr(instanceWorldToLocal[0]));
+	glUniform1fv(Shader::getUniformLocation(shaderId, "instanceScale"), instanceCount, &instanceScale[0]);
+	glUniform1iv(Shader::getUniformLocation(shaderId, "instanceField"), instanceCount, &instanceField[0]);
+
+	glUniform1f(Shader::getUniformLocation(shaderId, "distanceFieldShadowStrength"), shadowStrength);
+	glUniform1f(Shader::getUniformLocation(shaderId, "distanceFieldShadowSoftness"), shadowSoftness);
+	glUniform1f(Shader::getUniformLocation(shaderId, "distanceFieldOcclusionStrength"), occlusionStrength);
+	glUniform1f(Shader::getUniformLocation(shaderId, "distanceFieldInfluence"), influenceRadius);
+}
+
+void DistanceFieldShadows::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+void DistanceFieldShadows::setShadowStrength(float value)
+{
+	shadowStrength = glm::clamp(value, 0.0f, 1.0f);
+}
+
+void DistanceFieldShadows::setShadowSoftness(float value)
+{
+	shadowSoftness = std::max(value, 1.0f);
+}
+
+void DistanceFieldShadows::setOcclusionStrength(float value)
+{
+	occlusionStrength = std::max(value, 0.0f);
+}
+
+void DistanceFieldShadows::setInfluenceRadius(float value)
+{
+	influenceRadius = std::max(value, 0.0f);
+}
+
+bool DistanceFieldShadows::getEnabled() const
+{
+	return enabled;
+}
+
+float DistanceFieldShadows::getShadowStrength() const
+{
+	return shadowStrength;
+}
+
+float DistanceFieldShadows::getShadowSoftness() const
+{
+	return shadowSoftness;
+}
+
+float DistanceFieldShadows::getOcclusionStrength() const
+{
+	return occlusionStrength;
+}
+
+float DistanceFieldShadows::getInfluenceRadius() const
+{
+	return influenceRadius;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "global.h"
+#include "DistanceField.h"
+
+// Soft shadows and occlusion of virtual objects onto sensor pixels, sphere traced through
+// the baked distance fields of their models. Instances are collected while the gPass draws.
+class DistanceFieldShadows
+{
+
+private:
+
+	const int maxFields = 4;
+	const int maxInstances = 32; // Matches maxDistanceFieldInstances of lightingPass.fs
+	bool warnedInstanceLimit = false;
+
+	std::vector<DistanceField*> fields;
+	std::vector<glm::mat4> instanceWorldToLocal;
+	std::vector<float> instanceScale;
+	std::vector<int> instanceField;
+
+	bool enabled = true;
+	float shadowStrength = 0.6f;
+	float shadowSoftness = 8.0f;
+	float occlusionStrength = 1.0f;
+	float influenceRadius = 0.3f; // World units around the bounds where sensor pixels are traced
+
+public:
+
+	DistanceFieldShadows();
+	~DistanceFieldShadows();
+
+	int addField(DistanceField* field);
+	void clearInstances();
+	void addInstance(int field, const glm::mat4& model);
+	void bind(GLuint shaderId, int firstUnit) const;
+
+	void setEnabled(bool value);
+	void setShadowStrength(float value);
+	void setShadowSoftness(float value);
+	void setOcclusionStrength(float value);
+	void setInfluenceRadius(float value);
+
+	bool getEnabled() const;
+	float getShadowStrength() const;
+	float getShadowSoftness() const;
+	float getOcclusionStrength() const;
+	float getInfluenceRadius() const;
+
+};
\ No newline at end of file
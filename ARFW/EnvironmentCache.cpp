@@ -0,0 +1,148 @@
+#include "EnvironmentCache.h"
+
+#define NOMINMAX
+#include <windows.h>
+
+using namespace std;
+
+// 64 bit FNV-1a, chained through the seed so several blocks can form one key
+uint64_t EnvironmentCache::hash(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t value = seed;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		value ^= bytes[i];
+		value *= 1099511628211ull;
+	}
+
+	return value;
+}
+
+// Returns 0 if the file cannot be read
+uint64_t EnvironmentCache::hashFile(string filepath)
+{
+	ifstream file(filepath, ios::in | ios::binary);
+
+	if (!file.is_open())
+	{
+		cout << "Cannot open file for hashing: " << filepath << endl;
+		return 0;
+	}
+
+	vector<char> chunk(1 << 20);
+	uint64_t value = hashSeed;
+
+	while (file)
+	{
+		file.read(&chunk[0], chunk.size());
+		value = hash(&chunk[0], (size_t)file.gcount(), value);
+	}
+
+	return value;
+}
+
+EnvironmentCache::EnvironmentCache(string directory)
+{
+	this->directory = directory;
+	CreateDirectoryA(directory.c_str(), NULL);
+}
+
+EnvironmentCache::~EnvironmentCache()
+{
+	unmap();
+	if (writerThread.joinable()) writerThread.join();
+}
+
+string EnvironmentCache::getFilepath(uint64_t key) const
+{
+	stringstream name;
+	name << directory << hex << key << ".env";
+	return name.str();
+}
+
+// Returns nullptr on a miss, the pointer stays valid until unmap() or the next map()
+const char* EnvironmentCache::map(uint64_t key, size_t& size)
+{
+	unmap();
+	size = 0;
+
+	HANDLE file = CreateFileA(getFilepath(key).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = NULL;
+
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == nullptr)
+	{
+		unmap();
+		return nullptr;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+	return (const char*)view;
+}
+
+void EnvironmentCache::unmap()
+{
+	if (view != nullptr) UnmapViewOfFile(view);
+	if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+	if (fileHandle != nullptr) CloseHandle(fileHandle);
+
+	view = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+}
+
+// Takes ownership of the data, a previous write is finished first
+void EnvironmentCache::store(uint64_t key, vector<char> data)
+{
+	if (writerThread.joinable()) writerThread.join();
+
+	writerThread = thread(&EnvironmentCache::writeFile, this, getFilepath(key), std::move(data));
+}
+
+// Written under a temporary name and renamed when complete, so a crash never leaves a truncated entry
+void EnvironmentCache::writeFile(string filepath, vector<char> data)
+{
+	string tempFilepath = filepath + ".tmp";
+
+	{
+		ofstream file(tempFilepath, ios::out | ios::binary | ios::trunc);
+		file.write(&data[0], data.size());
+
+		if (!file.good())
+		{
+			cout << "Error writing environment cache: " << tempFilepath << endl;
+			file.close();
+			remove(tempFilepath.c_str());
+			return;
+		}
+	}
+
+	if (!MoveFileExA(tempFilepath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		cout << "Error renaming environment cache: " << tempFilepath << endl;
+		remove(tempFilepath.c_str());
+	}
+	else
+	{
+		cout << "Environment cache written: " << filepath << endl;
+	}
+}
\ No newline at end of file
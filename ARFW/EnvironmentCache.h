@@ -0,0 +1,43 @@
+#pragma once
+
+#include "global.h"
+#include <fstream>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+
+// Content addressed store for preprocessed environments, one binary file per key.
+// Hits are memory mapped so the data can be uploaded without an intermediate copy,
+// misses are written by a background thread so the render loop never waits on the disk.
+class EnvironmentCache
+{
+
+private:
+
+	std::string directory;
+
+	// Only one mapping is open at a time
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+	const void* view = nullptr;
+
+	std::thread writerThread;
+
+	std::string getFilepath(uint64_t key) const;
+	void writeFile(std::string filepath, std::vector<char> data);
+
+public:
+
+	static const uint64_t hashSeed = 14695981039346656037ull;
+
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = hashSeed);
+	static uint64_t hashFile(std::string filepath);
+
+	EnvironmentCache(std::string directory);
+	~EnvironmentCache();
+
+	const char* map(uint64_t key, size_t& size);
+	void unmap();
+	void store(uint64_t key, std::vector<char> data);
+
+};
\ No newline at end of file
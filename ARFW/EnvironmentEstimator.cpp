@@ -0,0 +1,283 @@
+#include "EnvironmentEstimator.h"
+
+using namespace std;
+using namespace glm;
+
+EnvironmentEstimator::EnvironmentEstimator(int sourceWidth, int sourceHeight)
+{
+	sampleWidth = glm::max(sourceWidth / downsampleFactor, 1);
+	sampleHeight = glm::max(sourceHeight / downsampleFactor, 1);
+
+	glGenFramebuffers(1, &readFBO);
+	glGenFramebuffers(1, &sampleFBO);
+
+	glGenTextures(1, &sampleTexture);
+	glBindTexture(GL_TEXTURE_2D, sampleTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, sampleWidth, sampleHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, sampleFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sampleTexture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, sampleWidth * sampleHeight * 4 * sizeof(float), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Panorama in the layout of hdrToCube, sampled by PBR like a loaded .hdr file
+	glGenTextures(1, &estimateMap);
+	glBindTexture(GL_TEXTURE_2D, estimateMap);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, estimateWidth, estimateHeight, 0, GL_RGB, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	estimate.resize(estimateWidth * estimateHeight * 3);
+	shCoefficients.resize(9, vec4(0));
+
+	workerThread = thread(&EnvironmentEstimator::workerLoop, this);
+}
+
+EnvironmentEstimator::~EnvironmentEstimator()
+{
+	{
+		lock_guard<mutex> lock(workerMutex);
+		isRunning = false;
+	}
+	workerCondition.notify_one();
+	workerThread.join();
+
+	if (fence != 0) glDeleteSync(fence);
+	glDeleteBuffers(1, &pbo);
+	glDeleteFramebuffers(1, &readFBO);
+	glDeleteFramebuffers(1, &sampleFBO);
+	glDeleteTextures(1, &sampleTexture);
+	glDeleteTextures(1, &estimateMap);
+}
+
+// Called once per frame on the render thread, returns true when a new estimate has been uploaded
+bool EnvironmentEstimator::update(GLuint colorMap)
+{
+	// Collect a finished readback without waiting on the GPU
+	if (fence != 0)
+	{
+		GLenum status = glClientWaitSync(fence, 0, 0);
+
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			glDeleteSync(fence);
+			fence = 0;
+			readbackFrame();
+		}
+	}
+
+	// Downsample and start the next readback
+	if (++frameCounter >= frameInterval && fence == 0)
+	{
+		frameCounter = 0;
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorMap, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sampleFBO);
+		glBlitFramebuffer(0, 0, sampleWidth * downsampleFactor, sampleHeight * downsampleFactor, 0, 0, sampleWidth, sampleHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sampleFBO);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glReadPixels(0, 0, sampleWidth, sampleHeight, GL_RGBA, GL_FLOAT, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// Swap in the worker's latest result
+	vector<float> data;
+	{
+		lock_guard<mutex> lock(workerMutex);
+		if (!hasPublishedEstimate) return false;
+
+		data.swap(publishedEstimate);
+		shCoefficients = publishedSH;
+		hasPublishedEstimate = false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, estimateMap);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, estimateWidth, estimateHeight, GL_RGB, GL_FLOAT, &data[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+// Frames arriving while the worker is busy are dropped, the estimate converges anyway
+void EnvironmentEstimator::readbackFrame()
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	const float* data = (const float*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+	if (data != nullptr)
+	{
+		lock_guard<mutex> lock(workerMutex);
+
+		if (!hasPendingFrame)
+		{
+			pendingFrame.assign(data, data + sampleWidth * sampleHeight * 4);
+			pendingBlendFactor = blendFactor;
+			hasPendingFrame = true;
+			workerCondition.notify_one();
+		}
+	}
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void EnvironmentEstimator::workerLoop()
+{
+	vector<float> frame;
+	vector<vec4> coefficients(9);
+
+	while (true)
+	{
+		float blend;
+		{
+			unique_lock<mutex> lock(workerMutex);
+			workerCondition.wait(lock, [this]() { return hasPendingFrame || !isRunning; });
+			if (!isRunning) return;
+
+			frame.swap(pendingFrame);
+			blend = pendingBlendFactor;
+			hasPendingFrame = false;
+
+			if (resetRequested)
+			{
+				hasEstimate = false;
+				resetRequested = false;
+			}
+		}
+
+		// The first frame initializes the estimate, later ones are blended in exponentially
+		integrateFrame(frame, hasEstimate ? blend : 1.0f);
+		hasEstimate = true;
+		projectSH(coefficients);
+
+		lock_guard<mutex> lock(workerMutex);
+		publishedEstimate = estimate;
+		publishedSH = coefficients;
+		hasPublishedEstimate = true;
+	}
+}
+
+// Projects the frame onto the sphere with the mapping of 2dToCube, sampled bilinearly
+void EnvironmentEstimator::integrateFrame(const vector<float>& frame, float blend)
+{
+	float aspect = (float)sampleHeight / (float)sampleWidth;
+
+	for (int y = 0; y < estimateHeight; y++)
+	{
+		float latitude = (0.5f - (y + 0.5f) / estimateHeight) * pi<float>();
+
+		for (int x = 0; x < estimateWidth; x++)
+		{
+			float longitude = ((x + 0.5f) / estimateWidth - 0.5f) * two_pi<float>();
+			vec3 dir = vec3(cos(latitude) * cos(longitude), sin(latitude), cos(latitude) * sin(longitude));
+
+			vec2 uv = vec2(dir.x * aspect, dir.y) * 0.5f + 0.5f;
+			vec2 coord = clamp(uv * vec2(sampleWidth, sampleHeight) - 0.5f, vec2(0), vec2(sampleWidth - 1, sampleHeight - 1));
+			ivec2 c0 = ivec2(coord);
+			ivec2 c1 = min(c0 + 1, ivec2(sampleWidth - 1, sampleHeight - 1));
+			vec2 f = coord - vec2(c0);
+
+			float* texel = &estimate[(y * estimateWidth + x) * 3];
+
+			for (int channel = 0; channel < 3; channel++)
+			{
+				float v00 = frame[(c0.y * sampleWidth + c0.x) * 4 + channel];
+				float v10 = frame[(c0.y * sampleWidth + c1.x) * 4 + channel];
+				float v01 = frame[(c1.y * sampleWidth + c0.x) * 4 + channel];
+				float v11 = frame[(c1.y * sampleWidth + c1.x) * 4 + channel];
+				float value = mix(mix(v00, v10, f.x), mix(v01, v11, f.x), f.y);
+
+				texel[channel] += (value - texel[channel]) * blend;
+			}
+		}
+	}
+}
+
+// Same basis and cosine lobe convolution as shIrradiance.cs, weighted by the solid angle of each texel
+void EnvironmentEstimator::projectSH(vector<vec4>& coefficients) const
+{
+	vec3 sums[9];
+	for (int c = 0; c < 9; c++) sums[c] = vec3(0);
+
+	float texelArea = (two_pi<float>() / estimateWidth) * (pi<float>() / estimateHeight);
+
+	for (int y = 0; y < estimateHeight; y++)
+	{
+		float latitude = (0.5f - (y + 0.5f) / estimateHeight) * pi<float>();
+		float solidAngle = texelArea * cos(latitude);
+
+		for (int x = 0; x < estimateWidth; x++)
+		{
+			float longitude = ((x + 0.5f) / estimateWidth - 0.5f) * two_pi<float>();
+			vec3 dir = vec3(cos(latitude) * cos(longitude), sin(latitude), cos(latitude) * sin(longitude));
+			vec3 radiance = make_vec3(&estimate[(y * estimateWidth + x) * 3]) * solidAngle;
+
+			sums[0] += radiance * 0.282095f;
+			sums[1] += radiance * 0.488603f * dir.y;
+			sums[2] += radiance * 0.488603f * dir.z;
+			sums[3] += radiance * 0.488603f * dir.x;
+			sums[4] += radiance * 1.092548f * dir.x * dir.y;
+			sums[5] += radiance * 1.092548f * dir.y * dir.z;
+			sums[6] += radiance * 0.315392f * (3.0f * dir.z * dir.z - 1.0f);
+			sums[7] += radiance * 1.092548f * dir.x * dir.z;
+			sums[8] += radiance * 0.546274f * (dir.x * dir.x - dir.y * dir.y);
+		}
+	}
+
+	for (int c = 0; c < 9; c++)
+	{
+		int band = (c == 0) ? 0 : ((c < 4) ? 1 : 2);
+		float cosineLobe = (band == 0) ? 1.0f : ((band == 1) ? 2.0f / 3.0f : 0.25f);
+		coefficients[c] = vec4(sums[c] * cosineLobe, 0.0f);
+	}
+}
+
+// The next frame that reaches the worker replaces the estimate instead of blending into it
+void EnvironmentEstimator::reset()
+{
+	lock_guard<mutex> lock(workerMutex);
+	resetRequested = true;
+}
+
+void EnvironmentEstimator::setFrameInterval(int value)
+{
+	frameInterval = glm::max(value, 1);
+}
+
+void EnvironmentEstimator::setBlendFactor(float value)
+{
+	blendFactor = clamp(value, 0.0f, 1.0f);
+}
+
+GLuint EnvironmentEstimator::getEstimateMapId() const
+{
+	return estimateMap;
+}
+
+const vector<vec4>& EnvironmentEstimator::getSHCoefficients() const
+{
+	return shCoefficients;
+}
+
+int EnvironmentEstimator::getFrameInterval() const
+{
+	return frameInterval;
+}
+
+float EnvironmentEstimator::getBlendFactor() const
+{
+	return blendFactor;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "global.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Continuously estimates an equirectangular environment from the live sensor color.
+// Every few frames a downsampled copy of the frame is read back asynchronously through a PBO,
+// a worker thread projects it onto the sphere, blends it into the running estimate and projects
+// the result onto spherical harmonics. Finished estimates are picked up double buffered.
+class EnvironmentEstimator
+{
+
+private:
+
+	int frameInterval = 30;
+	float blendFactor = 0.25f;
+	const int downsampleFactor = 8;
+	const int estimateWidth = 256;
+	const int estimateHeight = 128;
+
+	int sampleWidth, sampleHeight;
+	int frameCounter = 0;
+
+	GLuint readFBO, sampleFBO;
+	GLuint sampleTexture;
+	GLuint pbo;
+	GLsync fence = 0;
+	GLuint estimateMap;
+
+	// Shared with the worker, guarded by the mutex
+	std::thread workerThread;
+	std::mutex workerMutex;
+	std::condition_variable workerCondition;
+	bool isRunning = true;
+	bool hasPendingFrame = false;
+	bool hasPublishedEstimate = false;
+	bool resetRequested = false;
+	float pendingBlendFactor;
+	std::vector<float> pendingFrame;
+	std::vector<float> publishedEstimate;
+	std::vector<glm::vec4> publishedSH;
+
+	// Owned by the worker
+	std::vector<float> estimate;
+	bool hasEstimate = false;
+
+	// Owned by the render thread
+	std::vector<glm::vec4> shCoefficients;
+
+	void workerLoop();
+	void integrateFrame(const std::vector<float>& frame, float blend);
+	void projectSH(std::vector<glm::vec4>& coefficients) const;
+	void readbackFrame();
+
+public:
+
+	EnvironmentEstimator(int sourceWidth, int sourceHeight);
+	~EnvironmentEstimator();
+
+	bool update(GLuint colorMap);
+	void reset();
+
+	void setFrameInterval(int value);
+	void setBlendFactor(float value);
+
+	GLuint getEstimateMapId() const;
+	const std::vector<glm::vec4>& getSHCoefficients() const;
+	int getFrameInterval() const;
+	float getBlendFactor() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "FrameGraph.h"
+
+using namespace std;
+using namespace glm;
+
+bool FrameGraphTextureDesc::operator==(const FrameGraphTextureDesc& other) const
+{
+	return internalFormat == other.internalFormat && format == other.format && type == other.type && width == other.width && height == other.height;
+}
+
+FrameGraph::FrameGraph()
+{
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (PooledTexture& pooled : pool) glDeleteTextures(1, &pooled.texture);
+}
+
+int FrameGraph::createTexture(string name, const FrameGraphTextureDesc& desc)
+{
+	Resource resource = { name, desc, false, 0, -1, -1 };
+	resources.push_back(resource);
+	return (int)resources.size() - 1;
+}
+
+int FrameGraph::importTexture(string name, GLuint texture)
+{
+	Resource resource = { name, FrameGraphTextureDesc(), true, texture, -1, -1 };
+	resources.push_back(resource);
+	return (int)resources.size() - 1;
+}
+
+int FrameGraph::createToken(string name)
+{
+	return importTexture(name, 0);
+}
+
+// Passes execute in declaration order, a pass with side effects is never culled
+void FrameGraph::addPass(string name, vector<int> reads, vector<int> writes, function<void()> execute, bool sideEffect)
+{
+	Pass pass = { name, reads, writes, execute, sideEffect, false };
+	passes.push_back(pass);
+	compiled = false;
+}
+
+// Forget this frame's declarations, the pooled textures stay allocated for the next frame
+void FrameGraph::reset()
+{
+	resources.clear();
+	passes.clear();
+	compiled = false;
+}
+
+void FrameGraph::compile()
+{
+	// Walk backwards and keep the passes whose writes are still read later on. A read only keeps the
+	// last writer before it alive, so reading last frame's contents doesn't drag in this frame's writer.
+	vector<bool> resourceNeeded(resources.size(), false);
+
+	for (int i = (int)passes.size() - 1; i >= 0; i--)
+	{
+		Pass& pass = passes[i];
+		pass.culled = !pass.sideEffect;
+
+		for (int resource : pass.writes)
+		{
+			if (resourceNeeded[resource]) pass.culled = false;
+		}
+
+		if (pass.culled) continue;
+
+		for (int resource : pass.writes) resourceNeeded[resource] = false;
+		for (int resource : pass.reads) resourceNeeded[resource] = true;
+	}
+
+	// Lifetimes of the transient targets over the remaining passes
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		if (passes[i].culled) continue;
+
+		auto touch = [&](int resource)
+		{
+			Resource& r = resources[resource];
+			if (r.firstPass < 0) r.firstPass = i;
+			r.lastPass = i;
+		};
+
+		for (int resource : passes[i].reads) touch(resource);
+		for (int resource : passes[i].writes) touch(resource);
+	}
+
+	// Hand out pooled textures in pass order and return them after their last use. The order is the
+	// same every frame as long as the declarations are, so targets keep their textures between frames.
+	for (PooledTexture& pooled : pool) pooled.inUse = false;
+
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		for (Resource& resource : resources)
+		{
+			if (!resource.imported && resource.firstPass == i) resource.texture = acquireTexture(resource.desc);
+		}
+
+		for (Resource& resource : resources)
+		{
+			if (!resource.imported && resource.lastPass == i) releaseTexture(resource.texture);
+		}
+	}
+
+	compiled = true;
+}
+
+void FrameGraph::execute()
+{
+	if (!compiled) compile();
+
+	for (Pass& pass : passes)
+	{
+		if (pass.culled) continue;
+
+		GpuProfileScope scope(profiler, pass.name);
+		pass.execute();
+	}
+}
+
+// Every pass that runs is timed as a scope named after it
+void FrameGraph::setProfiler(GpuProfiler* profiler)
+{
+	this->profiler = profiler;
+}
+
+GLuint FrameGraph::acquireTexture(const FrameGraphTextureDesc& desc)
+{
+	for (PooledTexture& pooled : pool)
+	{
+		if (!pooled.inUse && pooled.desc == desc)
+		{
+			pooled.inUse = true;
+			return pooled.texture;
+		}
+	}
+
+	PooledTexture pooled;
+	pooled.desc = desc;
+	pooled.inUse = true;
+
+	glGenTextures(1, &pooled.texture);
+	glBindTexture(GL_TEXTURE_2D, pooled.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	pool.push_back(pooled);
+
+	// Resizes grow the pool every time, release builds report it on demand through printPasses
+#ifdef _DEBUG
+	cout << "Frame graph pool grown to " << pool.size() << " textures (" << getPoolMemory() / (1024 * 1024) << " MB)" << endl;
+#endif
+
+	return pooled.texture;
+}
+
+void FrameGraph::releaseTexture(GLuint texture)
+{
+	for (PooledTexture& pooled : pool)
+	{
+		if (pooled.texture == texture) pooled.inUse = false;
+	}
+}
+
+int FrameGraph::bytesPerPixel(GLint internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_RGBA32F: return 16;
+	case GL_RGBA16F: return 8;
+	case GL_RG16F: return 4;
+	case GL_R32F: return 4;
+	case GL_RG16: return 4;
+	case GL_RGBA8: return 4;
+	case GL_SRGB8_ALPHA8: return 4;
+	case GL_DEPTH_COMPONENT24: return 4;
+	case GL_DEPTH_COMPONENT32F: return 4;
+	default: return 4;
+	}
+}
+
+// Returns the texture assigned for this frame, valid once the graph is compiled
+GLuint FrameGraph::getTexture(int resource) const
+{
+	if (resource < 0 || resource >= (int)resources.size()) return 0;
+	return resources[resource].texture;
+}
+
+int FrameGraph::getPassCount() const
+{
+	return (int)passes.size();
+}
+
+int FrameGraph::getCulledPassCount() const
+{
+	int count = 0;
+	for (const Pass& pass : passes)
+	{
+		if (pass.culled) count++;
+	}
+	return count;
+}
+
+int FrameGraph::getPoolSize() const
+{
+	return (int)pool.size();
+}
+
+size_t FrameGraph::getPoolMemory() const
+{
+	size_t bytes = 0;
+	for (const PooledTexture& pooled : pool)
+	{
+		bytes += (size_t)pooled.desc.width * pooled.desc.height * bytesPerPixel(pooled.desc.internalFormat);
+	}
+	return bytes;
+}
+
+void FrameGraph::printPasses() const
+{
+	for (const Pass& pass : passes)
+	{
+		cout << (pass.culled ? "  (culled) " : "  ") << pass.name << endl;
+	}
+
+	cout << getCulledPassCount() << " of " << getPassCount() << " passes culled, " << getPoolSize() << " pooled textures (" << getPoolMemory() / (1024 * 1024) << " MB)" << endl;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "global.h"
+#include "GpuProfiler.h"
+#include <functional>
+
+// Format of a transient render target, targets with the same description can share one texture
+struct FrameGraphTextureDesc
+{
+	GLint internalFormat;
+	GLenum format;
+	GLenum type;
+	int width, height;
+
+	bool operator==(const FrameGraphTextureDesc& other) const;
+};
+
+// Passes are declared every frame together with the resources they read and write. Compiling culls
+// the passes whose outputs nothing consumes and maps the transient targets onto a pool of textures,
+// so targets with disjoint lifetimes alias the same memory. Imported resources are owned elsewhere
+// and keep their contents across frames, tokens order passes through state that is not a texture.
+class FrameGraph
+{
+
+private:
+
+	struct Resource
+	{
+		std::string name;
+		FrameGraphTextureDesc desc;
+		bool imported;
+		GLuint texture;
+		int firstPass, lastPass;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<int> reads, writes;
+		std::function<void()> execute;
+		bool sideEffect;
+		bool culled;
+	};
+
+	struct PooledTexture
+	{
+		FrameGraphTextureDesc desc;
+		GLuint texture;
+		bool inUse;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PooledTexture> pool;
+	bool compiled = false;
+	GpuProfiler* profiler = nullptr;
+
+	GLuint acquireTexture(const FrameGraphTextureDesc& desc);
+	void releaseTexture(GLuint texture);
+	static int bytesPerPixel(GLint internalFormat);
+
+public:
+
+	FrameGraph();
+	~FrameGraph();
+
+	int createTexture(std::string name, const FrameGraphTextureDesc& desc);
+	int importTexture(std::string name, GLuint texture);
+	int createToken(std::string name);
+	void addPass(std::string name, std::vector<int> reads, std::vector<int> writes, std::function<void()> execute, bool sideEffect = false);
+
+	void reset();
+	void compile();
+	void execute();
+
+	void setProfiler(GpuProfiler* profiler);
+
+	GLuint getTexture(int resource) const;
+	int getPassCount() const;
+	int getCulledPassCount() const;
+	int getPoolSize() const;
+	size_t getPoolMemory() const;
+	void printPasses() const;
+
+};
\ No newline at end of file
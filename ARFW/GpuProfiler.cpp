@@ -0,0 +1,434 @@
+#include "GpuProfiler.h"
+
+using namespace std;
+
+extern string g_ExePath;
+
+GpuProfiler::GpuProfiler()
+{
+	cpuEpoch = chrono::high_resolution_clock::now();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (FrameQueries& queries : frames)
+	{
+		if (!queries.queries.empty()) glDeleteQueries((GLsizei)queries.queries.size(), queries.queries.data());
+	}
+}
+
+// Reads the frame that used this set of queries three frames ago, then starts recording into it
+void GpuProfiler::beginFrame()
+{
+	if (frameOpen) endFrame(false);
+
+	FrameQueries& queries = frames[frameCounter % bufferedFrames];
+	if (queries.frame >= 0) resolve(queries);
+
+	queries.frame = frameCounter;
+	queries.scopes.clear();
+	queries.usedQueries = 0;
+	scopeStack.clear();
+	frameOpen = true;
+}
+
+// The overlay is only refreshed while it is shown, results keep being collected either way
+void GpuProfiler::endFrame(bool refreshOverlay)
+{
+	if (!frameOpen) return;
+
+	while (!scopeStack.empty()) endScope(scopeStack.back());
+
+	frameOpen = false;
+	frameCounter++;
+
+	if (refreshOverlay) updateOverlay();
+}
+
+// Scopes are named by their path, so the same pass called from different parents is kept apart
+int GpuProfiler::beginScope(const string& name)
+{
+	if (!enabled || !frameOpen) return -1;
+
+	FrameQueries& queries = frames[frameCounter % bufferedFrames];
+
+	Scope scope;
+	scope.path = scopeStack.empty() ? name : queries.scopes[scopeStack.back()].path + "/" + name;
+	scope.depth = (int)scopeStack.size();
+	scope.beginQuery = nextQuery(queries);
+	scope.endQuery = 0;
+	scope.cpuBegin = getCpuTime();
+	scope.cpuEnd = scope.cpuBegin;
+
+	glQueryCounter(scope.beginQuery, GL_TIMESTAMP);
+
+	queries.scopes.push_back(scope);
+	scopeStack.push_back((int)queries.scopes.size() - 1);
+
+	return scopeStack.back();
+}
+
+void GpuProfiler::endScope(int scope)
+{
+	if (scope < 0 || scopeStack.empty()) return;
+
+	FrameQueries& queries = frames[frameCounter % bufferedFrames];
+
+	// Closing an outer scope also closes the ones still open inside it
+	while (!scopeStack.empty())
+	{
+		int top = scopeStack.back();
+		scopeStack.pop_back();
+
+		queries.scopes[top].endQuery = nextQuery(queries);
+		queries.scopes[top].cpuEnd = getCpuTime();
+		glQueryCounter(queries.scopes[top].endQuery, GL_TIMESTAMP);
+
+		if (top == scope) break;
+	}
+}
+
+GLuint GpuProfiler::nextQuery(FrameQueries& queries)
+{
+	if (queries.usedQueries == (int)queries.queries.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		queries.queries.push_back(query);
+	}
+
+	return queries.queries[queries.usedQueries++];
+}
+
+void GpuProfiler::resolve(FrameQueries& queries)
+{
+	if (queries.scopes.empty()) return;
+
+	// Timestamps complete in order, the last query issued stands for the whole frame
+	GLint available = 0;
+	glGetQueryObjectiv(queries.queries[queries.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if (!available)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	ResolvedFrame resolved;
+	resolved.frame = queries.frame;
+	map<string, size_t> scopeIndex;
+
+	for (const Scope& scope : queries.scopes)
+	{
+		if (scope.endQuery == 0) continue;
+
+		GLuint64 beginTime = 0, endTime = 0;
+		glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &beginTime);
+		glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &endTime);
+
+		float gpuTime = (endTime > beginTime) ? (endTime - beginTime) / 1000000.0f : 0.0f;
+		float cpuTime = (float)(scope.cpuEnd - scope.cpuBegin);
+
+		// Scopes entered more than once per frame are summed
+		auto it = scopeIndex.find(scope.path);
+
+		if (it != scopeIndex.end())
+		{
+			resolved.scopes[it->second].gpuTime += gpuTime;
+			resolved.scopes[it->second].cpuTime += cpuTime;
+		}
+		else
+		{
+			ScopeTime time = { scope.path, scope.depth, gpuTime, cpuTime };
+			scopeIndex[scope.path] = resolved.scopes.size();
+			resolved.scopes.push_back(time);
+		}
+	}
+
+	history.push_back(resolved);
+	while ((int)history.size() > historyLength) history.pop_front();
+
+	// Every series gets a slot for this frame, written over the oldest one
+	int slot = resolvedFrames % historyLength;
+	for (auto& entry : series) entry.second.gpuTimes[slot] = 0.0f;
+
+	for (const ScopeTime& time : resolved.scopes)
+	{
+		auto it = series.find(time.path);
+
+		if (it == series.end())
+		{
+			ScopeSeries timeSeries = { time.depth, vector<float>(historyLength, 0.0f) };
+			it = series.insert(make_pair(time.path, timeSeries)).first;
+		}
+
+		it->second.gpuTimes[slot] = time.gpuTime;
+	}
+
+	resolvedFrames++;
+}
+
+double GpuProfiler::getCpuTime() const
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - cpuEpoch).count();
+}
+
+void GpuProfiler::initializeOverlay(nanogui::Screen* screen)
+{
+	overlayScreen = screen;
+
+	overlayWindow = new nanogui::Window(screen, "GPU profiler");
+	overlayWindow->setPosition(Eigen::Vector2i(screen->width() - 260, 10));
+	overlayWindow->setLayout(new nanogui::GroupLayout());
+
+	overlayLabel = new nanogui::Label(overlayWindow, "Waiting for results");
+
+	nanogui::Widget* buttons = new nanogui::Widget(overlayWindow);
+	buttons->setLayout(new nanogui::BoxLayout(nanogui::Orientation::Horizontal, nanogui::Alignment::Middle, 0, 6));
+
+	nanogui::Button* exportCSVButton = new nanogui::Button(buttons, "Export CSV");
+	exportCSVButton->setCallback([&]()
+	{
+		if (exportCSV(g_ExePath + "profile.csv")) cout << "Profile written to " << g_ExePath << "profile.csv" << endl;
+	});
+
+	nanogui::Button* exportJSONButton = new nanogui::Button(buttons, "Export JSON");
+	exportJSONButton->setCallback([&]()
+	{
+		if (exportJSON(g_ExePath + "profile.json")) cout << "Profile written to " << g_ExePath << "profile.json" << endl;
+	});
+
+	screen->performLayout();
+}
+
+// Every graph is scaled to its own peak, the header shows the average and the footer the peak
+void GpuProfiler::updateOverlay()
+{
+	if (overlayWindow == nullptr || history.empty()) return;
+
+	int frameCount = std::min(resolvedFrames, historyLength);
+	int oldestFrame = resolvedFrames - frameCount;
+	bool layoutChanged = false;
+
+	for (const auto& entry : series)
+	{
+		const string& path = entry.first;
+		bool visible = entry.second.depth < overlayDepth;
+		auto it = overlayGraphs.find(path);
+
+		// Graphs below a lowered overlay depth are hidden, not destroyed
+		if (!visible)
+		{
+			if (it != overlayGraphs.end() && it->second->visible())
+			{
+				it->second->setVisible(false);
+				layoutChanged = true;
+			}
+			continue;
+		}
+
+		nanogui::Graph* graph = nullptr;
+
+		if (it == overlayGraphs.end())
+		{
+			graph = new nanogui::Graph(overlayWindow, string(entry.second.depth * 2, ' ') + path.substr(path.find_last_of('/') + 1));
+			graph->setFixedSize(Eigen::Vector2i(230, 36));
+			overlayGraphs[path] = graph;
+			layoutChanged = true;
+		}
+		else
+		{
+			graph = it->second;
+
+			if (!graph->visible())
+			{
+				graph->setVisible(true);
+				layoutChanged = true;
+			}
+		}
+
+		Eigen::VectorXf values(frameCount);
+		float sum = 0.0f, peak = 0.0f;
+
+		for (int i = 0; i < frameCount; i++)
+		{
+			float gpuTime = entry.second.gpuTimes[(oldestFrame + i) % historyLength];
+			values[i] = gpuTime;
+			sum += gpuTime;
+			peak = max(peak, gpuTime);
+		}
+
+		if (peak > 0.0f) values /= peak;
+		graph->setValues(values);
+
+		ostringstream header, footer;
+		header.precision(2);
+		footer.precision(2);
+		header << fixed << sum / frameCount << " ms";
+		footer << fixed << "peak " << peak << " ms";
+		graph->setHeader(header.str());
+		graph->setFooter(footer.str());
+	}
+
+	ostringstream label;
+	label << "Frame " << history.back().frame << ", " << droppedFrames << " dropped";
+	overlayLabel->setCaption(label.str());
+
+	if (layoutChanged) overlayScreen->performLayout();
+}
+
+// One row per scope and frame of the history
+bool GpuProfiler::exportCSV(string filepath) const
+{
+	FILE* file = fopen(filepath.c_str(), "w");
+	if (file == nullptr)
+	{
+		cout << "Profiler Error: Cannot write " << filepath << endl;
+		return false;
+	}
+
+	fprintf(file, "frame,scope,depth,gpu_ms,cpu_ms\n");
+
+	for (const ResolvedFrame& frame : history)
+	{
+		for (const ScopeTime& time : frame.scopes)
+		{
+			fprintf(file, "%d,%s,%d,%.4f,%.4f\n", frame.frame, time.path.c_str(), time.depth, time.gpuTime, time.cpuTime);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+// The averages of every scope over the history, followed by the frames themselves
+bool GpuProfiler::exportJSON(string filepath) const
+{
+	FILE* file = fopen(filepath.c_str(), "w");
+	if (file == nullptr)
+	{
+		cout << "Profiler Error: Cannot write " << filepath << endl;
+		return false;
+	}
+
+	vector<string> paths;
+	for (const ResolvedFrame& frame : history)
+	{
+		for (const ScopeTime& time : frame.scopes)
+		{
+			if (find(paths.begin(), paths.end(), time.path) == paths.end()) paths.push_back(time.path);
+		}
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+	fprintf(file, "\t\"frames\": %d,\n", (int)history.size());
+	fprintf(file, "\t\"droppedFrames\": %d,\n", droppedFrames);
+	fprintf(file, "\t\"summary\": [\n");
+
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		float gpuSum = 0.0f, gpuPeak = 0.0f, cpuSum = 0.0f;
+		int count = 0;
+
+		for (const ResolvedFrame& frame : history)
+		{
+			for (const ScopeTime& time : frame.scopes)
+			{
+				if (time.path != paths[i]) continue;
+
+				gpuSum += time.gpuTime;
+				gpuPeak = max(gpuPeak, time.gpuTime);
+				cpuSum += time.cpuTime;
+				count++;
+			}
+		}
+
+		fprintf(file, "\t\t{ \"scope\": \"%s\", \"samples\": %d, \"gpuMean\": %.4f, \"gpuPeak\": %.4f, \"cpuMean\": %.4f }%s\n",
+			paths[i].c_str(), count, gpuSum / max(count, 1), gpuPeak, cpuSum / max(count, 1), (i + 1 < paths.size()) ? "," : "");
+	}
+
+	fprintf(file, "\t],\n");
+	fprintf(file, "\t\"history\": [\n");
+
+	for (size_t i = 0; i < history.size(); i++)
+	{
+		fprintf(file, "\t\t{ \"frame\": %d, \"scopes\": [", history[i].frame);
+
+		for (size_t j = 0; j < history[i].scopes.size(); j++)
+		{
+			const ScopeTime& time = history[i].scopes[j];
+			fprintf(file, "%s{ \"scope\": \"%s\", \"depth\": %d, \"gpu\": %.4f, \"cpu\": %.4f }", (j > 0) ? ", " : " ", time.path.c_str(), time.depth, time.gpuTime, time.cpuTime);
+		}
+
+		fprintf(file, " ] }%s\n", (i + 1 < history.size()) ? "," : "");
+	}
+
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
+
+void GpuProfiler::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+void GpuProfiler::setOverlayDepth(int value)
+{
+	overlayDepth = value;
+}
+
+bool GpuProfiler::getEnabled() const
+{
+	return enabled;
+}
+
+int GpuProfiler::getOverlayDepth() const
+{
+	return overlayDepth;
+}
+
+int GpuProfiler::getDroppedFrames() const
+{
+	return droppedFrames;
+}
+
+float GpuProfiler::getAverageGpuTime(const string& path) const
+{
+	float sum = 0.0f;
+	int count = 0;
+
+	for (const ResolvedFrame& frame : history)
+	{
+		for (const ScopeTime& time : frame.scopes)
+		{
+			if (time.path == path)
+			{
+				sum += time.gpuTime;
+				count++;
+			}
+		}
+	}
+
+	return (count > 0) ? sum / count : 0.0f;
+}
+
+GpuProfileScope::GpuProfileScope(GpuProfiler* profiler, const string& name)
+{
+	this->profiler = profiler;
+	scope = (profiler != nullptr) ? profiler->beginScope(name) : -1;
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+	end();
+}
+
+void GpuProfileScope::end()
+{
+	if (profiler != nullptr) profiler->endScope(scope);
+	profiler = nullptr;
+}
\ No newline at end of file
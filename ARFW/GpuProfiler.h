@@ -0,0 +1,119 @@
+#pragma once
+
+#include "global.h"
+#include <nanogui\nanogui.h>
+#include <chrono>
+#include <deque>
+#include <map>
+
+// GPU and CPU time of named, nested scopes. Every scope brackets its commands with two GL_TIMESTAMP queries.
+// The queries of a frame go through four sets and are read back three frames later, and only when they are available,
+// so the profiler never stalls the pipeline. Frames whose results are not back by then are dropped.
+class GpuProfiler
+{
+
+private:
+
+	struct Scope
+	{
+		std::string path;
+		int depth;
+		GLuint beginQuery, endQuery;
+		double cpuBegin, cpuEnd;
+	};
+
+	struct FrameQueries
+	{
+		int frame = -1;
+		std::vector<Scope> scopes;
+		std::vector<GLuint> queries;
+		int usedQueries = 0;
+	};
+
+	struct ScopeTime
+	{
+		std::string path;
+		int depth;
+		float gpuTime, cpuTime; // milliseconds
+	};
+
+	struct ResolvedFrame
+	{
+		int frame;
+		std::vector<ScopeTime> scopes;
+	};
+
+	// GPU times of one scope over the history for the overlay, zero in frames without the scope
+	struct ScopeSeries
+	{
+		int depth;
+		std::vector<float> gpuTimes;
+	};
+
+	static const int bufferedFrames = 4;
+	const int historyLength = 240;
+
+	bool enabled = true;
+	bool frameOpen = false;
+	int frameCounter = 0;
+	int droppedFrames = 0;
+	FrameQueries frames[bufferedFrames];
+	std::vector<int> scopeStack;
+	std::deque<ResolvedFrame> history;
+	std::map<std::string, ScopeSeries> series;
+	int resolvedFrames = 0;
+	std::chrono::high_resolution_clock::time_point cpuEpoch;
+
+	// Overlay with one rolling graph per scope down to overlayDepth
+	nanogui::Screen* overlayScreen = nullptr;
+	nanogui::Window* overlayWindow = nullptr;
+	nanogui::Label* overlayLabel = nullptr;
+	std::map<std::string, nanogui::Graph*> overlayGraphs;
+	int overlayDepth = 2;
+
+	GLuint nextQuery(FrameQueries& queries);
+	void resolve(FrameQueries& queries);
+	void updateOverlay();
+	double getCpuTime() const;
+
+public:
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	void beginFrame();
+	void endFrame(bool refreshOverlay);
+	int beginScope(const std::string& name);
+	void endScope(int scope);
+
+	void initializeOverlay(nanogui::Screen* screen);
+	bool exportCSV(std::string filepath) const;
+	bool exportJSON(std::string filepath) const;
+
+	void setEnabled(bool value);
+	void setOverlayDepth(int value);
+
+	bool getEnabled() const;
+	int getOverlayDepth() const;
+	int getDroppedFrames() const;
+	float getAverageGpuTime(const std::string& path) const;
+
+};
+
+// Times the enclosing block or until end(), without a profiler it does nothing so components also run unprofiled
+class GpuProfileScope
+{
+
+private:
+
+	GpuProfiler* profiler;
+	int scope;
+
+public:
+
+	GpuProfileScope(GpuProfiler* profiler, const std::string& name);
+	~GpuProfileScope();
+
+	void end();
+
+};
\ No newline at end of file
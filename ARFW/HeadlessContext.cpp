@@ -0,0 +1,139 @@
+#include "HeadlessContext.h"
+
+using namespace std;
+
+HeadlessContext::HeadlessContext()
+{
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	destroy();
+}
+
+// The surface matches the buffer size, so the default framebuffer the output pass draws to exists
+bool HeadlessContext::create(int width, int height)
+{
+#ifdef ARFW_EGL
+	if (createEGL(width, height)) return true;
+
+	destroy();
+	cout << "EGL context failed, falling back to an invisible window" << endl;
+#endif
+	return createWindow(width, height);
+}
+
+#ifdef ARFW_EGL
+bool HeadlessContext::createEGL(int width, int height)
+{
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay != nullptr) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		cout << "EGL Error: Cannot initialize a display" << endl;
+		display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	cout << "EGL " << major << "." << minor << ": " << eglQueryString(display, EGL_VENDOR) << endl;
+
+	const EGLint configAttributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		cout << "EGL Error: No pbuffer config with desktop OpenGL" << endl;
+		return false;
+	}
+
+	const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+	if (surface == EGL_NO_SURFACE)
+	{
+		cout << "EGL Error: Cannot create a " << width << "x" << height << " pbuffer" << endl;
+		return false;
+	}
+
+	// The shaders are GLSL 4.50 and every draw binds a vertex array, so a core profile is enough
+	const EGLint contextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	eglBindAPI(EGL_OPENGL_API);
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		cout << "EGL Error: Cannot create an OpenGL 4.5 core context" << endl;
+		return false;
+	}
+
+	return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+#endif
+
+bool HeadlessContext::createWindow(int width, int height)
+{
+	if (!glfwInit()) return false;
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_DEPTH_BITS, 24);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef ARFW_EGL
+	// GLEW built with EGL loads its entry points through EGL, the window context has to come from it as well
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+	window = glfwCreateWindow(width, height, "ARFW", NULL, NULL);
+	if (window == nullptr)
+	{
+		cout << "GLFW Error: Cannot create an invisible window" << endl;
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(window);
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+#ifdef ARFW_EGL
+	if (display != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+		if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+		eglTerminate(display);
+
+		display = EGL_NO_DISPLAY;
+		surface = EGL_NO_SURFACE;
+		context = EGL_NO_CONTEXT;
+	}
+#endif
+	if (window == nullptr) return;
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	window = nullptr;
+}
\ No newline at end of file
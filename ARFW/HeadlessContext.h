@@ -0,0 +1,37 @@
+#pragma once
+
+#include "global.h"
+
+#ifdef ARFW_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// Offscreen OpenGL 4.5 core context for runs without GUI and input. Built with ARFW_EGL it is an EGL pbuffer
+// context, on Mesa's surfaceless platform when available so it needs neither a display server nor a GPU (llvmpipe).
+// GLEW then has to be built with GLEW_EGL. When EGL fails, or without ARFW_EGL, it falls back to an invisible GLFW window.
+class HeadlessContext
+{
+
+private:
+
+#ifdef ARFW_EGL
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLSurface surface = EGL_NO_SURFACE;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	bool createEGL(int width, int height);
+#endif
+	GLFWwindow* window = nullptr;
+
+	bool createWindow(int width, int height);
+
+public:
+
+	HeadlessContext();
+	~HeadlessContext();
+
+	bool create(int width, int height);
+	void destroy();
+
+};
\ No newline at end of file
@@ -96,4 +96,32 @@ GLuint Image::loadHDRI(std::string filepath)
 	{
 		return it->first;
 	}
+}
+
+// Binary PPM of the first mip level, values are clamped to [0, 1] and the rows flipped to top down
+bool Image::saveTexturePPM(GLuint texture, int width, int height, std::string filepath)
+{
+	ofstream file(filepath, ios::out | ios::binary | ios::trunc);
+
+	if (!file.is_open())
+	{
+		cout << "Cannot write image: " << filepath << endl;
+		return false;
+	}
+
+	vector<GLubyte> data(width * height * 3);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, &data[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	for (int y = height - 1; y >= 0; y--)
+	{
+		file.write((const char*)&data[y * width * 3], width * 3);
+	}
+
+	return true;
 }
\ No newline at end of file
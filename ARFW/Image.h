@@ -13,4 +13,5 @@ namespace Image
 
 	GLuint loadTexture(std::string filepath);
 	GLuint loadHDRI(std::string filepath);
+	bool saveTexturePPM(GLuint texture, int width, int height, std::string filepath);
 }
\ No newline at end of file
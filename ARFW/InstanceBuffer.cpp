@@ -0,0 +1,103 @@
+#include "InstanceBuffer.h"
+
+using namespace std;
+using namespace glm;
+
+InstanceBuffer::InstanceBuffer()
+{
+	glGenBuffers(1, &buffer);
+	glGenBuffers(1, &visibleBuffer);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	glDeleteBuffers(1, &buffer);
+	glDeleteBuffers(1, &visibleBuffer);
+}
+
+// Upload the lists if they changed since the last bind, the buffers only grow.
+// The visible indices go to the binding after the instances.
+void InstanceBuffer::bind(GLuint binding)
+{
+	if (instancesChanged && !instances.empty())
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+		if ((int)instances.size() > capacity)
+		{
+			capacity = (int)instances.size();
+			glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+		}
+		else
+		{
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		instancesChanged = false;
+	}
+
+	if (visibleChanged && !visibleInstances.empty())
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+
+		if ((int)visibleInstances.size() > visibleCapacity)
+		{
+			visibleCapacity = (int)instances.size(); // At most all instances, sized once per placement
+			glBufferData(GL_SHADER_STORAGE_BUFFER, visibleCapacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+		}
+
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, visibleInstances.size() * sizeof(GLuint), &visibleInstances[0]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		visibleChanged = false;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding + 1, visibleBuffer);
+}
+
+void InstanceBuffer::addInstance(const InstanceData& instance)
+{
+	instances.push_back(instance);
+	instancesChanged = true;
+	revision++;
+}
+
+void InstanceBuffer::clearInstances()
+{
+	instances.clear();
+	visibleInstances.clear();
+	instancesChanged = true;
+	visibleChanged = true;
+	revision++;
+}
+
+// Indices into the instance list, only uploaded when the visible set changed
+void InstanceBuffer::setVisibleInstances(const vector<GLuint>& indices)
+{
+	if (indices == visibleInstances) return;
+
+	visibleInstances = indices;
+	visibleChanged = true;
+}
+
+int InstanceBuffer::getInstanceCount() const
+{
+	return (int)instances.size();
+}
+
+int InstanceBuffer::getVisibleCount() const
+{
+	return (int)visibleInstances.size();
+}
+
+const vector<InstanceData>& InstanceBuffer::getInstances() const
+{
+	return instances;
+}
+
+// Changes whenever the list was rebuilt, casters compare it to skip matrix comparisons
+unsigned int InstanceBuffer::getRevision() const
+{
+	return revision;
+}
\ No newline at end of file
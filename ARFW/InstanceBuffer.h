@@ -0,0 +1,47 @@
+#pragma once
+
+#include "global.h"
+
+// std430 layout of one instance in the InstanceList buffer
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::mat4 modelInverse;
+	glm::vec4 albedo; // Multiplied with the diffuse texture
+	glm::vec4 material; // Roughness, metallic
+	glm::mat4 shRotationBand1; // Upper 3x3 is the band 1 rotation of the baked transfer
+	float shRotationBand2[28]; // Row major 5x5, padded to 16 bytes
+};
+
+// Transforms and materials of objects that share one model, drawn with one instanced call per mesh.
+// The list is only uploaded after it changed, static placements cost nothing per frame. A second list
+// holds the indices of the instances that survived culling, gl_InstanceID runs over that one.
+class InstanceBuffer
+{
+
+private:
+
+	GLuint buffer, visibleBuffer;
+	int capacity = 0, visibleCapacity = 0;
+	std::vector<InstanceData> instances;
+	std::vector<GLuint> visibleInstances;
+	bool instancesChanged = true;
+	bool visibleChanged = true;
+	unsigned int revision = 0;
+
+public:
+
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	void bind(GLuint binding);
+	void addInstance(const InstanceData& instance);
+	void clearInstances();
+	void setVisibleInstances(const std::vector<GLuint>& indices);
+
+	int getInstanceCount() const;
+	int getVisibleCount() const;
+	const std::vector<InstanceData>& getInstances() const;
+	unsigned int getRevision() const;
+
+};
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Mesh.h"
+#include "Shader.h"
 
 using namespace glm;
 using namespace std;
@@ -10,6 +11,21 @@ Mesh::Mesh(const vector<Vertex>& vertices, const vector<GLuint>& indices, const
 	this->indices = indices;
 	this->textures = textures;
 
+	// Sampler names (diffuse1, normal1, ...) are built once instead of on every draw
+	GLuint diffuseIndex = 1, normalIndex = 1, specularIndex = 1;
+	for (GLuint i = 0; i < textures.size(); i++)
+	{
+		stringstream ss;
+		string type = textures[i].type;
+		if (type == "diffuse")
+			ss << diffuseIndex++;
+		else if (type == "normal")
+			ss << normalIndex++;
+		else if (type == "specular")
+			ss << specularIndex++;
+		textureUniforms.push_back(type + ss.str());
+	}
+
 	// Make buffers and setup data formats
 	glGenVertexArrays(1, &vao);
 	glGenBuffers(1, &vbo);
@@ -36,6 +52,32 @@ Mesh::~Mesh()
 
 }
 
+// Attach baked transfer vectors from tools/prtbake, only the PRT variant of the gPass reads them
+bool Mesh::setTransfer(const vector<float>& transfer)
+{
+	if (transfer.size() != vertices.size() * 9)
+	{
+		cout << "Transfer data does not match the mesh (" << transfer.size() / 9 << " of " << vertices.size() << " vertices)" << endl;
+		return false;
+	}
+
+	if (transferVbo == 0) glGenBuffers(1, &transferVbo);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, transferVbo);
+	glBufferData(GL_ARRAY_BUFFER, transfer.size() * sizeof(float), &transfer[0], GL_STATIC_DRAW);
+
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribPointer(3 + i, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (GLvoid*)(i * 3 * sizeof(float)));
+	}
+
+	glBindVertexArray(0);
+	hasTransfer = true;
+	return true;
+}
+
 void Mesh::draw(GLuint program)
 {
 	if (!textures.empty() && program != NULL)
@@ -61,24 +103,40 @@ void Mesh::drawMeshOnly()
 	glBindVertexArray(0);
 }
 
+// One draw for all instances, the vertex shader fetches its transform by gl_InstanceID
+void Mesh::drawInstanced(int instanceCount)
+{
+	glBindVertexArray(vao);
+	glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+	glBindVertexArray(0);
+}
+
 void Mesh::bindTexture(GLuint program)
 {
-	GLuint diffuseIndex = 1, normalIndex = 1, specularIndex = 1;
 	for (GLuint i = 0; i < textures.size(); i++)
 	{
-		stringstream ss;
-		string number;
-		string type = textures[i].type;
-		if (type == "diffuse")
-			ss << diffuseIndex++;
-		else if (type == "normal")
-			ss << normalIndex++;
-		else if (type == "specular")
-			ss << specularIndex++;
-		number = ss.str();
-
 		glActiveTexture(GL_TEXTURE0 + i);
-		glUniform1i(glGetUniformLocation(program, (type + number).c_str()), i);
+		glUniform1i(Shader::getUniformLocation(program, textureUniforms[i]), i);
 		glBindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
+}
+
+size_t Mesh::getVertexCount() const
+{
+	return vertices.size();
+}
+
+const vector<Vertex>& Mesh::getVertices() const
+{
+	return vertices;
+}
+
+const vector<GLuint>& Mesh::getIndices() const
+{
+	return indices;
+}
+
+bool Mesh::getHasTransfer() const
+{
+	return hasTransfer;
 }
\ No newline at end of file
@@ -26,12 +26,17 @@ private:
 	std::vector<Vertex> vertices;
 	std::vector<GLuint> indices;
 	std::vector<Texture> textures;
+	std::vector<std::string> textureUniforms;
 	std::vector<float> posVertices;
 
 	GLuint vbo;
 	GLuint vao;
 	GLuint ebo;
 
+	// Precomputed radiance transfer, 9 SH coefficients per vertex in attributes 3 to 5
+	GLuint transferVbo = 0;
+	bool hasTransfer = false;
+
 	void bindTexture(GLuint program);
 
 public:
@@ -41,7 +46,14 @@ public:
 		const std::vector<Texture>& textures);
 	~Mesh();
 
+	bool setTransfer(const std::vector<float>& transfer);
 	void draw(GLuint program);
 	void drawMeshOnly();
+	void drawInstanced(int instanceCount);
+
+	size_t getVertexCount() const;
+	const std::vector<Vertex>& getVertices() const;
+	const std::vector<GLuint>& getIndices() const;
+	bool getHasTransfer() const;
 
 };
\ No newline at end of file
@@ -30,6 +30,14 @@ void Model::drawMeshOnly()
 	}
 }
 
+void Model::drawInstanced(int instanceCount)
+{
+	for (Mesh& mesh : meshes)
+	{
+		mesh.drawInstanced(instanceCount);
+	}
+}
+
 void Model::loadModel(string path)
 {
 	Importer import;
@@ -43,7 +51,58 @@ void Model::loadModel(string path)
 	}
 
 	directory = path.substr(0, path.find_last_of('/'));
+	filepath = path;
 	processNode(scene->mRootNode, scene);
+	loadTransfer(path.substr(0, path.find_last_of('.')) + ".prt");
+}
+
+// Per vertex SH transfer baked by tools/prtbake, optional and only used by the PRT gPass variant
+void Model::loadTransfer(string path)
+{
+	ifstream file(path, ios::in | ios::binary);
+	if (!file.is_open()) return;
+
+	char magic[4];
+	int meshCount = 0;
+	file.read(magic, 4);
+	file.read((char*)&meshCount, sizeof(int));
+
+	if (!file || string(magic, 4) != "PRT9" || meshCount != (int)meshes.size())
+	{
+		cout << "Invalid transfer file: " << path << endl;
+		return;
+	}
+
+	vector<vector<float>> transfers(meshCount);
+
+	for (int i = 0; i < meshCount; i++)
+	{
+		int vertexCount = 0;
+		file.read((char*)&vertexCount, sizeof(int));
+
+		if (!file || vertexCount != (int)meshes[i].getVertexCount())
+		{
+			cout << "Transfer file does not match the model, rebake it: " << path << endl;
+			return;
+		}
+
+		transfers[i].resize(vertexCount * 9);
+		file.read((char*)&transfers[i][0], transfers[i].size() * sizeof(float));
+	}
+
+	if (!file)
+	{
+		cout << "Truncated transfer file: " << path << endl;
+		return;
+	}
+
+	hasTransfer = true;
+	for (int i = 0; i < meshCount; i++)
+	{
+		hasTransfer = meshes[i].setTransfer(transfers[i]) && hasTransfer;
+	}
+
+	cout << "Loaded transfer: " << path << endl;
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene)
@@ -168,7 +227,38 @@ GLint Model::TextureFromFile(const char* path)
 	return Image::loadTexture(filepath);
 }
 
-BoundingBox Model::getBoundingBox() const
+const BoundingBox& Model::getBoundingBox() const
 {
 	return bbox;
+}
+
+// Three corners per triangle over all meshes, in model space like the vertex data
+vector<vec3> Model::getTriangleCorners() const
+{
+	vector<vec3> corners;
+
+	for (const Mesh& mesh : meshes)
+	{
+		const vector<Vertex>& vertices = mesh.getVertices();
+		const vector<GLuint>& indices = mesh.getIndices();
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			corners.push_back(vertices[indices[i]].Position);
+			corners.push_back(vertices[indices[i + 1]].Position);
+			corners.push_back(vertices[indices[i + 2]].Position);
+		}
+	}
+
+	return corners;
+}
+
+string Model::getFilepath() const
+{
+	return filepath;
+}
+
+bool Model::getHasTransfer() const
+{
+	return hasTransfer;
 }
\ No newline at end of file
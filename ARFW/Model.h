@@ -34,8 +34,11 @@ private:
 	BoundingBox bbox;
 	std::vector<Mesh> meshes;
 	std::string directory;
+	std::string filepath;
+	bool hasTransfer = false;
 
 	void loadModel(std::string path);
+	void loadTransfer(std::string path);
 	void processNode(aiNode* node, const aiScene* scene);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
 	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string name);
@@ -48,7 +51,11 @@ public:
 
 	void draw(GLuint program);
 	void drawMeshOnly();
+	void drawInstanced(int instanceCount);
 
-	BoundingBox getBoundingBox() const;
+	const BoundingBox& getBoundingBox() const;
+	std::vector<glm::vec3> getTriangleCorners() const;
+	std::string getFilepath() const;
+	bool getHasTransfer() const;
 
 };
\ No newline at end of file
@@ -21,6 +21,7 @@ Object::Object(vec3 position)
 	matScale = mat4(1);
 
 	updateModelMatrix();
+	matModelPrevious = matModel;
 	
 	boundingBoxVisible = false;
 	visible = true;
@@ -29,7 +30,7 @@ Object::Object(vec3 position)
 
 Object::~Object()
 {
-
+	if (cullingTree != nullptr) cullingTree->destroyProxy(cullingProxy);
 }
 
 void Object::load(string filepath)
@@ -49,6 +50,7 @@ void Object::load(string filepath)
 	glBindVertexArray(0);
 
 	updateBoundingBoxData();
+	if (getHasTransfer()) updateSHRotation();
 }
 
 void Object::update(float dt)
@@ -66,8 +68,10 @@ void Object::draw()
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		}
 
-		glUniformMatrix4fv(glGetUniformLocation(gPassShaderId, "model"), 1, GL_FALSE, value_ptr(matModel));
-		glUniformMatrix4fv(glGetUniformLocation(gPassShaderId, "modelInverse"), 1, GL_FALSE, value_ptr(matModelInverse));
+		glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "model"), 1, GL_FALSE, value_ptr(matModel));
+		glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "modelInverse"), 1, GL_FALSE, value_ptr(matModelInverse));
+		glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "modelPrevious"), 1, GL_FALSE, value_ptr(matModelPrevious));
+		setTransferUniforms();
 		model->draw(gPassShaderId);
 
 		glEnable(GL_CULL_FACE);
@@ -76,6 +80,13 @@ void Object::draw()
 
 	if (!lineVertices.empty() && boundingBoxVisible)
 	{
+		if (lineVerticesChanged)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, lineVbo);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, lineVertices.size() * sizeof(vec3), &lineVertices[0]);
+			lineVerticesChanged = false;
+		}
+
 		glBindVertexArray(lineVao);
 		glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)lineVertices.size());
 	}
@@ -83,8 +94,10 @@ void Object::draw()
 
 void Object::drawMeshOnly()
 {
-	glUniformMatrix4fv(glGetUniformLocation(gPassShaderId, "model"), 1, GL_FALSE, value_ptr(matModel));
-	glUniformMatrix4fv(glGetUniformLocation(gPassShaderId, "modelInverse"), 1, GL_FALSE, value_ptr(matModelInverse));
+	glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "model"), 1, GL_FALSE, value_ptr(matModel));
+	glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "modelInverse"), 1, GL_FALSE, value_ptr(matModelInverse));
+	glUniformMatrix4fv(Shader::getUniformLocation(gPassShaderId, "modelPrevious"), 1, GL_FALSE, value_ptr(matModelPrevious));
+	setTransferUniforms();
 	model->drawMeshOnly();
 
 	/*if (!lineVertices.empty() && boundingBoxVisible) // TODO: crash??
@@ -94,11 +107,90 @@ void Object::drawMeshOnly()
 	}*/
 }
 
+// Remember the current transform, the next draw derives its motion vectors from it
+void Object::commitPreviousModelMatrix()
+{
+	matModelPrevious = matModel;
+}
+
 void Object::updateModelMatrix()
 {
-	matModel = matTranslate * matRotation * matScale;
+	mat4 matModelNew = matTranslate * matRotation * matScale;
+	if (matModelNew != matModel) transformRevision++;
+
+	matModel = matModelNew;
 	matModelInverse = inverse(matModel);
 	updateBoundingBoxData();
+
+	// Only baked transfer needs the rotated SH bands
+	if (getHasTransfer()) updateSHRotation();
+
+	if (cullingTree != nullptr) cullingTree->moveProxy(cullingProxy, worldMin, worldMax);
+}
+
+// Band 0 is invariant and band 1 rotates like a vector, band 2 is solved from five fixed directions
+// (Sloan, Stupid Spherical Harmonics Tricks): a world space function at a direction equals the
+// object space function at the direction rotated back, A * world = B * object
+void Object::updateSHRotation()
+{
+	mat3 rotation = mat3(matRotation);
+	shRotationBand1 = rotation;
+
+	const float k = 0.70710678f;
+	const vec3 directions[5] = { vec3(1, 0, 0), vec3(0, 0, 1), vec3(k, k, 0), vec3(k, 0, k), vec3(0, k, k) };
+
+	auto band2 = [](vec3 n, float* sh)
+	{
+		sh[0] = 1.092548f * n.x * n.y;
+		sh[1] = 1.092548f * n.y * n.z;
+		sh[2] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+		sh[3] = 1.092548f * n.x * n.z;
+		sh[4] = 0.546274f * (n.x * n.x - n.y * n.y);
+	};
+
+	// Augmented [A | B], Gauss-Jordan leaves A^-1 * B on the right
+	float system[5][10];
+	for (int i = 0; i < 5; i++)
+	{
+		band2(directions[i], &system[i][0]);
+		band2(transpose(rotation) * directions[i], &system[i][5]);
+	}
+
+	for (int column = 0; column < 5; column++)
+	{
+		int pivot = column;
+		for (int row = column + 1; row < 5; row++)
+		{
+			if (abs(system[row][column]) > abs(system[pivot][column])) pivot = row;
+		}
+		for (int i = 0; i < 10; i++) std::swap(system[column][i], system[pivot][i]);
+
+		float scale = 1.0f / system[column][column];
+		for (int i = 0; i < 10; i++) system[column][i] *= scale;
+
+		for (int row = 0; row < 5; row++)
+		{
+			if (row == column) continue;
+			float factor = system[row][column];
+			for (int i = 0; i < 10; i++) system[row][i] -= factor * system[column][i];
+		}
+	}
+
+	for (int row = 0; row < 5; row++)
+	{
+		for (int column = 0; column < 5; column++)
+		{
+			shRotationBand2[row * 5 + column] = system[row][5 + column];
+		}
+	}
+}
+
+void Object::setTransferUniforms()
+{
+	if (model == nullptr || !model->getHasTransfer()) return;
+
+	glUniformMatrix3fv(Shader::getUniformLocation(gPassShaderId, "shRotationBand1"), 1, GL_FALSE, value_ptr(shRotationBand1));
+	glUniform1fv(Shader::getUniformLocation(gPassShaderId, "shRotationBand2"), 25, shRotationBand2);
 }
 
 // Update bounding box VBO
@@ -161,6 +253,13 @@ void Object::updateBoundingBoxData()
 	bb->SATNormals.push_back(normalize(v8 - v4)); // Y
 	bb->SATNormals.push_back(normalize(v1 - v4)); // Z
 
+	worldMin = worldMax = v1;
+	for (const vec3& vertex : bb->Vertices)
+	{
+		worldMin = min(worldMin, vertex);
+		worldMax = max(worldMax, vertex);
+	}
+
 	// Remove duplicate normals
 	/*sort(boundingBoxSATNormals.begin(), boundingBoxSATNormals.end(), 
 		[](const vec3& v1, const vec3& v2){ return v1.x < v2.x; });
@@ -168,11 +267,8 @@ void Object::updateBoundingBoxData()
 		unique(boundingBoxSATNormals.begin(), boundingBoxSATNormals.end()), 
 		boundingBoxSATNormals.end());*/
 
-	if (!lineVertices.empty())
-	{
-		glBindBuffer(GL_ARRAY_BUFFER, lineVbo);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, lineVertices.size() * sizeof(vec3), &lineVertices[0]);
-	}
+	// Uploaded on the next draw that shows the box, objects re-posed every frame skip the transfer
+	lineVerticesChanged = true;
 }
 
 void Object::setPosition(vec3 position)
@@ -227,6 +323,15 @@ void Object::setGPassShaderId(GLuint id)
 	this->gPassShaderId = id;
 }
 
+// Register the loaded object in a culling tree, queries report it by userData
+void Object::setCullingTree(AABBTree* tree, int userData)
+{
+	if (cullingTree != nullptr) cullingTree->destroyProxy(cullingProxy);
+
+	cullingTree = tree;
+	cullingProxy = (tree != nullptr) ? tree->createProxy(worldMin, worldMax, userData) : -1;
+}
+
 vec3 Object::getPosition() const
 {
 	return position;
@@ -247,11 +352,51 @@ mat4 Object::getRotationMatrix() const
 	return matRotation;
 }
 
-BoundingBox Object::getBoundingBox() const
+mat4 Object::getModelMatrix() const
+{
+	return matModel;
+}
+
+Model* Object::getModel() const
+{
+	return model;
+}
+
+const BoundingBox& Object::getBoundingBox() const
 {
 	return boundingBox;
 }
 
+vec3 Object::getWorldMin() const
+{
+	return worldMin;
+}
+
+vec3 Object::getWorldMax() const
+{
+	return worldMax;
+}
+
+bool Object::getHasTransfer() const
+{
+	return model != nullptr && model->getHasTransfer();
+}
+
+mat3 Object::getSHRotationBand1() const
+{
+	return shRotationBand1;
+}
+
+const float* Object::getSHRotationBand2() const
+{
+	return shRotationBand2;
+}
+
+unsigned int Object::getTransformRevision() const
+{
+	return transformRevision;
+}
+
 bool Object::isBoundingBoxVisible() const
 {
 	return boundingBoxVisible;
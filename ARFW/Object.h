@@ -4,6 +4,7 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Shader.h"
+#include "AABBTree.h"
 
 class Object
 {
@@ -13,21 +14,35 @@ protected:
 	glm::vec3 position, rotation, scale, up;
 	glm::mat4 matTranslate, matRotation, matScale;
 	glm::mat4 matModel, matModelInverse;
+	glm::mat4 matModelPrevious;
+	unsigned int transformRevision = 0; // Bumped whenever the model matrix actually changes
 	static GLuint defaultTexID;
 
+	// Rotates baked SH transfer vectors from object to world space, row major for band 2
+	glm::mat3 shRotationBand1 = glm::mat3(1);
+	float shRotationBand2[25];
+
 	Model* model;
 	BoundingBox boundingBox;
+	glm::vec3 worldMin = glm::vec3(0), worldMax = glm::vec3(0); // World space bounds of the transformed box
+
+	// Proxy in the scene's culling tree, refitted whenever the model matrix changes
+	AABBTree* cullingTree = nullptr;
+	int cullingProxy = -1;
 	GLuint gPassShaderId;
 
 	GLuint lineVbo;
 	GLuint lineVao;
 	std::vector<glm::vec3> lineVertices;
+	bool lineVerticesChanged = false;
 	bool boundingBoxVisible;
 	bool visible;
 	bool wireframe;
 
 	virtual void updateModelMatrix();
 	void updateBoundingBoxData();
+	void updateSHRotation();
+	void setTransferUniforms();
 
 public:
 
@@ -38,6 +53,7 @@ public:
 	virtual void update(float dt);
 	virtual void draw();
 	void drawMeshOnly();
+	void commitPreviousModelMatrix();
 
 	// === Accessors ===
 
@@ -50,12 +66,21 @@ public:
 	void setVisible(bool isVisible);
 	void setWireframeMode(bool isWireframe);
 	void setGPassShaderId(GLuint id);
+	void setCullingTree(AABBTree* tree, int userData);
 
 	glm::vec3 getPosition() const;
 	glm::vec3 getRotationEulerAngle() const;
 	glm::vec3 getScale() const;
 	glm::mat4 getRotationMatrix() const;
-	BoundingBox getBoundingBox() const;
+	glm::mat4 getModelMatrix() const;
+	Model* getModel() const;
+	const BoundingBox& getBoundingBox() const;
+	glm::vec3 getWorldMin() const;
+	glm::vec3 getWorldMax() const;
+	bool getHasTransfer() const;
+	glm::mat3 getSHRotationBand1() const;
+	const float* getSHRotationBand2() const;
+	unsigned int getTransformRevision() const;
 	bool isBoundingBoxVisible() const;
 	bool isVisible() const;
 	bool isWireframe() const;
@@ -17,53 +17,31 @@ PBR::PBR(int windowWidth, int windowHeight)
 	hdrToCubemapShader = new Shader("hdrToCube");
 	hdrIrradianceShader = new Shader("hdrIrradianceCube");
 	prefilterShader = new Shader("hdrPrefilterCube");
+	prefilterOctShader = new Shader("hdrPrefilterOct");
 	brdfShader = new Shader("brdf");
 	reflectanceShader = new Shader("reflectance");
+	shIrradianceShader = new Shader("shIrradiance");
 
 	//hdrRadiance = Image::loadHDRI(g_ExePath + "../../media/hdr/Wooden_Door/WoodenDoor_Ref.hdr");
 	//hdrRadiance = Image::loadTexture(g_ExePath + "../../media/hdr/bg.png"); // remember to use imgToCubemapShader
 
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+	environmentCache = new EnvironmentCache(g_ExePath + "../../media/cache/");
+
 	glGenFramebuffers(1, &captureFBO);
 	glGenRenderbuffers(1, &captureRBO);
 
-	glGenTextures(1, &environmentMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, captureWidth, captureHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glGenTextures(1, &irradianceMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, irrdianceWidth, irrdianceHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+	captureViews[0] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	captureViews[1] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	captureViews[2] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	captureViews[3] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+	captureViews[4] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	captureViews[5] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
 
-	glGenTextures(1, &prefilterMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, prefilterWidth, prefilterHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	irradianceMap = createCubemap(irrdianceWidth, irrdianceHeight, false);
+	allocateEnvironmentMaps();
 
 	glGenTextures(1, &brdfLUT);
 	glBindTexture(GL_TEXTURE_2D, brdfLUT);
@@ -73,6 +51,9 @@ PBR::PBR(int windowWidth, int windowHeight)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+	// The LUT does not depend on the environment, it is generated offline by tools/brdflut and rendered only as a fallback
+	if (!loadBRDFLut(g_ExePath + "../../media/brdfLUT.bin")) computeBRDFLut();
+
 	glGenTextures(1, &reflectanceMap);
 	glBindTexture(GL_TEXTURE_2D, reflectanceMap);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
@@ -80,11 +61,22 @@ PBR::PBR(int windowWidth, int windowHeight)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// 9 coefficients followed by the enable flag, written as SSBO and read as UBO (std140 compatible)
+	glGenBuffers(1, &shIrradianceBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, shIrradianceBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, 10 * sizeof(glm::vec4), NULL, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 11, shIrradianceBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	setUseSHIrradiance(useSHIrradiance);
 }
 
 PBR::~PBR()
 {
 	delete cube;
+	delete environmentCache;
+	releaseEnvironmentMaps();
+	if (loadedPanorama != 0) glDeleteTextures(1, &loadedPanorama);
 }
 
 void PBR::recompileShaders()
@@ -96,21 +88,102 @@ void PBR::recompileShaders()
 	brdfShader->recompile();*/
 
 	reflectanceShader->recompile();
+	shIrradianceShader->recompile();
 }
 
 void PBR::recomputeEnvMaps(GLuint colorMap)
 {
 	hdrRadiance = colorMap;
+	isEquirectangular = false;
+	pendingSHCoefficients.clear();
+	hasQueuedEstimate = false;
 	imgToCubemapShader->apply();
 	glUniform1i(glGetUniformLocation(imgToCubemapShader->getShaderId(), "recapture"), 0);
 
+	// The first capture has nothing to show meanwhile, so it is always done in one go
+	if (useProgressiveUpdate && environmentReady)
+	{
+		progressiveStep = 0;
+		return;
+	}
+
 	computeEnvMaps();
 }
 
+// The BRDF half of the split sum is constant and was set up once in the constructor
 void PBR::recomputeBothSums(GLuint colorMap)
 {
 	recomputeEnvMaps(colorMap);
-	computeBRDFLut();
+}
+
+// Loads an equirectangular .hdr panorama, the converted and convolved maps are cached by file content
+void PBR::loadEnvironment(string filepath)
+{
+	uint64_t key = EnvironmentCache::hashFile(filepath);
+	if (key == 0) return;
+
+	// Anything that changes the stored layout must change the key as well
+	int layout[] = { environmentCacheVersion, environmentSize, irrdianceWidth, irrdianceHeight, prefilterWidth, prefilterHeight, prefilterMipLevels, shSampleCount, useOctahedralPrefilter, prefilterOctahedralSize };
+	key = EnvironmentCache::hash(layout, sizeof(layout), key);
+
+	size_t size;
+	const char* data = environmentCache->map(key, size);
+
+	if (data != nullptr && size == getEnvironmentCacheSize())
+	{
+		uploadEnvironment(data);
+		environmentCache->unmap();
+		cout << "Environment loaded from cache: " << filepath << endl;
+		return;
+	}
+
+	environmentCache->unmap();
+
+	GLuint texId = Image::loadHDRI(filepath);
+	if (texId == (GLuint)-1) return;
+
+	// The previous panorama is no longer referenced, the maps below are computed in one go
+	if (loadedPanorama != 0) glDeleteTextures(1, &loadedPanorama);
+	loadedPanorama = texId;
+
+	hdrRadiance = texId;
+	isEquirectangular = true;
+	isLinearSource = false;
+	pendingSHCoefficients.clear();
+	hasQueuedEstimate = false;
+	computeEnvMaps();
+
+	// Both diffuse representations are stored so either mode can use the entry
+	if (useSHIrradiance) computeIrradianceCubemap();
+	else computeSHIrradiance(hdrRadiance, true);
+
+	environmentCache->store(key, readbackEnvironment());
+}
+
+// Live estimate from the sensor, linear radiance with precomputed SH coefficients
+void PBR::setEnvironmentEstimate(GLuint equirectangularMap, const vector<glm::vec4>& shCoefficients)
+{
+	// Restarting a running refresh would never let it swap when estimates arrive faster than it completes
+	if (progressiveStep >= 0)
+	{
+		queuedEstimateMap = equirectangularMap;
+		queuedSHCoefficients = shCoefficients;
+		hasQueuedEstimate = true;
+		return;
+	}
+
+	hdrRadiance = equirectangularMap;
+	isEquirectangular = true;
+	isLinearSource = true;
+	pendingSHCoefficients = shCoefficients;
+
+	if (useProgressiveUpdate && environmentReady)
+	{
+		progressiveStep = 0;
+		return;
+	}
+
+	computeEnvMaps();
 }
 
 void PBR::computeEnvMaps()
@@ -119,52 +192,200 @@ void PBR::computeEnvMaps()
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_BLEND);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	// pbr: convert HDR equirectangular environment map to cubemap equivalent
+	captureEnvironment(environmentMap);
+
+	// pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+	computeIrradiance();
 
-	// Load and convert HDR equirectangular map to cubemap texture
-	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	glm::mat4 captureViews[] =
+	// pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
+	for (int mip = 0; mip < prefilterMipLevels; ++mip)
 	{
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-	};
+		prefilterSlices(false, mip, 0, 6);
+	}
 
+	progressiveStep = -1;
+	environmentReady = true;
+}
 
-	// pbr: convert HDR equirectangular environment map to cubemap equivalent
-	imgToCubemapShader->apply();
-	glUniform1i(glGetUniformLocation(imgToCubemapShader->getShaderId(), "colorMap"), 0);
-	glUniformMatrix4fv(glGetUniformLocation(imgToCubemapShader->getShaderId(), "projection"), 1, GL_FALSE, value_ptr(captureProjection));
-	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hdrRadiance);
+// Renders one slice of a pending refresh per frame: the capture first, then as many prefilter faces as the texel budget allows
+void PBR::updateProgressive()
+{
+	if (progressiveStep < 0) return;
 
-	glViewport(0, 0, captureWidth, captureHeight);
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	if (progressiveStep == 0)
+	{
+		captureEnvironment(environmentMapBack);
+		progressiveStep++;
+		return;
+	}
+
+	int stepCount = prefilterMipLevels * 6;
+	int texelCount = 0;
+
+	while (progressiveStep <= stepCount && texelCount < progressiveTexelBudget)
+	{
+		int mip = (progressiveStep - 1) / 6;
+		int firstFace = (progressiveStep - 1) % 6;
+		int faceTexels = useOctahedralPrefilter ? (prefilterOctahedralSize >> mip) * (prefilterOctahedralSize >> mip) / 6 : (prefilterWidth >> mip) * (prefilterHeight >> mip);
+		int faceCount = glm::clamp((progressiveTexelBudget - texelCount) / glm::max(faceTexels, 1), 1, 6 - firstFace);
+
+		prefilterSlices(true, mip, firstFace, faceCount);
+
+		texelCount += faceCount * faceTexels;
+		progressiveStep += faceCount;
+	}
+
+	if (progressiveStep <= stepCount) return;
+
+	// Every face of every mip is done, make the new maps visible at once
+	std::swap(environmentMap, environmentMapBack);
+	std::swap(prefilterMap, prefilterMapBack);
+	std::swap(prefilterOctMap, prefilterOctMapBack);
+	computeIrradiance();
+
+	progressiveStep = -1;
+
+	if (hasQueuedEstimate)
+	{
+		hasQueuedEstimate = false;
+		setEnvironmentEstimate(queuedEstimateMap, queuedSHCoefficients);
+	}
+}
+
+// Front and back buffers of the environment and the prefiltered maps in the layout of the current mode
+void PBR::allocateEnvironmentMaps()
+{
+	environmentSize = useOctahedralPrefilter ? captureWidth / 2 : captureWidth;
+	environmentMap = createCubemap(environmentSize, environmentSize, true);
+	environmentMapBack = createCubemap(environmentSize, environmentSize, true);
+
+	prefilterMap = prefilterMapBack = 0;
+	prefilterOctMap = prefilterOctMapBack = 0;
+	octahedralEncodeTexture = octahedralEncodePBO = 0;
+
+	if (!useOctahedralPrefilter)
+	{
+		prefilterMap = createCubemap(prefilterWidth, prefilterHeight, true);
+		prefilterMapBack = createCubemap(prefilterWidth, prefilterHeight, true);
+		return;
+	}
+
+	prefilterOctMap = createOctahedralMap(prefilterOctahedralSize);
+	prefilterOctMapBack = createOctahedralMap(prefilterOctahedralSize);
+
+	// RGB9_E5 is not renderable, the prefilter writes the packed bits here and they are copied over through a PBO
+	glGenTextures(1, &octahedralEncodeTexture);
+	glBindTexture(GL_TEXTURE_2D, octahedralEncodeTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, prefilterOctahedralSize, prefilterOctahedralSize, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &octahedralEncodePBO);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, octahedralEncodePBO);
+	glBufferData(GL_PIXEL_PACK_BUFFER, prefilterOctahedralSize * prefilterOctahedralSize * sizeof(GLuint), NULL, GL_STREAM_COPY);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void PBR::releaseEnvironmentMaps()
+{
+	GLuint textures[] = { environmentMap, environmentMapBack, prefilterMap, prefilterMapBack, prefilterOctMap, prefilterOctMapBack, octahedralEncodeTexture };
+	glDeleteTextures(7, textures);
+	glDeleteBuffers(1, &octahedralEncodePBO);
+}
+
+GLuint PBR::createCubemap(int width, int height, bool mipmapped)
+{
+	GLuint texId;
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texId);
 	for (unsigned int i = 0; i < 6; ++i)
 	{
-		glUniformMatrix4fv(glGetUniformLocation(imgToCubemapShader->getShaderId(), "view"), 1, GL_FALSE, value_ptr(captureViews[i]));
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, environmentMap, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (mipmapped) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-		cube->drawMeshOnly();
+	return texId;
+}
+
+GLuint PBR::createOctahedralMap(int size)
+{
+	GLuint texId;
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_2D, texId);
+	for (int mip = 0; mip < prefilterMipLevels; ++mip)
+	{
+		glTexImage2D(GL_TEXTURE_2D, mip, GL_RGB9_E5, size >> mip, size >> mip, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, nullptr);
 	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, prefilterMipLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return texId;
+}
+
+// All six faces are rendered with one layered draw
+void PBR::captureEnvironment(GLuint targetMap)
+{
+	Shader* shader = isEquirectangular ? hdrToCubemapShader : imgToCubemapShader;
+
+	shader->apply();
+	glUniform1i(glGetUniformLocation(shader->getShaderId(), "colorMap"), 0);
+	glUniformMatrix4fv(glGetUniformLocation(shader->getShaderId(), "projection"), 1, GL_FALSE, value_ptr(captureProjection));
+	glUniformMatrix4fv(glGetUniformLocation(shader->getShaderId(), "captureViews"), 6, GL_FALSE, value_ptr(captureViews[0]));
+	if (isEquirectangular) glUniform1i(glGetUniformLocation(shader->getShaderId(), "decodeGamma"), !isLinearSource);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, hdrRadiance);
+
+	glViewport(0, 0, environmentSize, environmentSize);
+	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, targetMap, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	cube->drawMeshOnly();
+
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, targetMap);
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+}
 
-	// pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-	
-	
+// The spherical harmonics path projects the frame directly and skips the cubemap passes
+void PBR::computeIrradiance()
+{
+	if (useSHIrradiance && pendingSHCoefficients.size() == 9)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, shIrradianceBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, 9 * sizeof(glm::vec4), &pendingSHCoefficients[0]);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		pendingSHCoefficients.clear();
+		return;
+	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	if (useSHIrradiance)
+	{
+		computeSHIrradiance(hdrRadiance, isEquirectangular);
+		return;
+	}
 
-	// pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+	computeIrradianceCubemap();
+}
 
+void PBR::computeIrradianceCubemap()
+{
 	hdrIrradianceShader->apply();
 	glUniform1i(glGetUniformLocation(hdrIrradianceShader->getShaderId(), "environmentMap"), 0);
 	glUniformMatrix4fv(glGetUniformLocation(hdrIrradianceShader->getShaderId(), "projection"), 1, GL_FALSE, value_ptr(captureProjection));
@@ -182,36 +403,214 @@ void PBR::computeEnvMaps()
 		cube->drawMeshOnly();
 	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-	// pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
+// A slice is a cubemap face, or a sixth of the rows of the octahedral map
+void PBR::prefilterSlices(bool backBuffer, int mip, int firstSlice, int sliceCount)
+{
+	GLuint sourceMap = backBuffer ? environmentMapBack : environmentMap;
+
+	if (useOctahedralPrefilter)
+	{
+		prefilterBands(backBuffer ? prefilterOctMapBack : prefilterOctMap, sourceMap, mip, firstSlice, sliceCount);
+	}
+	else
+	{
+		prefilterFaces(backBuffer ? prefilterMapBack : prefilterMap, sourceMap, mip, firstSlice, sliceCount);
+	}
+}
 
+// Filters a range of faces of one mip level, the layered attachment is never cleared so untouched faces keep their content
+void PBR::prefilterFaces(GLuint targetMap, GLuint sourceMap, int mip, int firstFace, int faceCount)
+{
 	prefilterShader->apply();
 	glUniform1i(glGetUniformLocation(prefilterShader->getShaderId(), "environmentMap"), 0);
 	glUniformMatrix4fv(glGetUniformLocation(prefilterShader->getShaderId(), "projection"), 1, GL_FALSE, value_ptr(captureProjection));
+	glUniformMatrix4fv(glGetUniformLocation(prefilterShader->getShaderId(), "captureViews"), 6, GL_FALSE, value_ptr(captureViews[0]));
+	glUniform1i(glGetUniformLocation(prefilterShader->getShaderId(), "firstFace"), firstFace);
+	glUniform1i(glGetUniformLocation(prefilterShader->getShaderId(), "faceCount"), faceCount);
+
+	float roughness = (float)mip / (float)(prefilterMipLevels - 1);
+	glUniform1f(glGetUniformLocation(prefilterShader->getShaderId(), "roughness"), roughness);
+
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, sourceMap);
 
+	glViewport(0, 0, prefilterWidth >> mip, prefilterHeight >> mip);
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	unsigned int maxMipLevels = 5;
-	for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, targetMap, mip);
+
+	cube->drawMeshOnly();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PBR::prefilterBands(GLuint targetMap, GLuint sourceMap, int mip, int firstBand, int bandCount)
+{
+	int mipSize = prefilterOctahedralSize >> mip;
+	int firstRow = mipSize * firstBand / 6;
+	int rowCount = mipSize * (firstBand + bandCount) / 6 - firstRow;
+	if (rowCount <= 0) return;
+
+	prefilterOctShader->apply();
+	glUniform1i(glGetUniformLocation(prefilterOctShader->getShaderId(), "environmentMap"), 0);
+
+	float roughness = (float)mip / (float)(prefilterMipLevels - 1);
+	glUniform1f(glGetUniformLocation(prefilterOctShader->getShaderId(), "roughness"), roughness);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, sourceMap);
+
+	glViewport(0, 0, mipSize, mipSize);
+	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, octahedralEncodeTexture, 0);
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, firstRow, mipSize, rowCount);
+	quad->draw();
+	glDisable(GL_SCISSOR_TEST);
+
+	// The packed bits never leave the GPU
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, octahedralEncodePBO);
+	glReadPixels(0, firstRow, mipSize, rowCount, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, octahedralEncodePBO);
+	glBindTexture(GL_TEXTURE_2D, targetMap);
+	glTexSubImage2D(GL_TEXTURE_2D, mip, 0, firstRow, mipSize, rowCount, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Cache entry layout: SH coefficients, environment level 0, irradiance, then every prefilter mip.
+// Cubemaps are stored as RGB half floats in face order, the octahedral map in its packed RGB9_E5 bits.
+size_t PBR::getEnvironmentCacheSize() const
+{
+	size_t size = 9 * sizeof(glm::vec4) + 6 * (environmentSize * environmentSize + irrdianceWidth * irrdianceHeight) * 3 * sizeof(GLushort);
+
+	for (int mip = 0; mip < prefilterMipLevels; ++mip)
 	{
-		// reisze framebuffer according to mip-level size.
-		unsigned int mipWidth = (unsigned int)(prefilterWidth * std::pow(0.5f, mip));
-		unsigned int mipHeight = (unsigned int)(prefilterHeight * std::pow(0.5f, mip));
-		glViewport(0, 0, mipWidth, mipHeight);
+		if (useOctahedralPrefilter) size += (prefilterOctahedralSize >> mip) * (prefilterOctahedralSize >> mip) * sizeof(GLuint);
+		else size += 6 * (prefilterWidth >> mip) * (prefilterHeight >> mip) * 3 * sizeof(GLushort);
+	}
+
+	return size;
+}
+
+vector<char> PBR::readbackEnvironment()
+{
+	vector<char> data(getEnvironmentCacheSize());
+	char* ptr = &data[0];
 
-		float roughness = (float)mip / (float)(maxMipLevels - 1);
-		glUniform1f(glGetUniformLocation(prefilterShader->getShaderId(), "roughness"), roughness);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_UNIFORM_BUFFER, shIrradianceBuffer);
+	glGetBufferSubData(GL_UNIFORM_BUFFER, 0, 9 * sizeof(glm::vec4), ptr);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	ptr += 9 * sizeof(glm::vec4);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	GLuint maps[] = { environmentMap, irradianceMap };
+	int sizes[] = { environmentSize * environmentSize, irrdianceWidth * irrdianceHeight };
+
+	for (int m = 0; m < 2; ++m)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, maps[m]);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glUniformMatrix4fv(glGetUniformLocation(prefilterShader->getShaderId(), "view"), 1, GL_FALSE, value_ptr(captureViews[i]));
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, GL_HALF_FLOAT, ptr);
+			ptr += sizes[m] * 3 * sizeof(GLushort);
+		}
+	}
 
-			cube->drawMeshOnly();
+	if (useOctahedralPrefilter)
+	{
+		glBindTexture(GL_TEXTURE_2D, prefilterOctMap);
+		for (int mip = 0; mip < prefilterMipLevels; ++mip)
+		{
+			glGetTexImage(GL_TEXTURE_2D, mip, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, ptr);
+			ptr += (prefilterOctahedralSize >> mip) * (prefilterOctahedralSize >> mip) * sizeof(GLuint);
 		}
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	else
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+		for (int mip = 0; mip < prefilterMipLevels; ++mip)
+		{
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB, GL_HALF_FLOAT, ptr);
+				ptr += (prefilterWidth >> mip) * (prefilterHeight >> mip) * 3 * sizeof(GLushort);
+			}
+		}
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	return data;
+}
+
+// Uploads straight from the mapped cache file, the environment mips are regenerated instead of stored
+void PBR::uploadEnvironment(const char* data)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, shIrradianceBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, 9 * sizeof(glm::vec4), data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	data += 9 * sizeof(glm::vec4);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMap);
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, environmentSize, environmentSize, GL_RGB, GL_HALF_FLOAT, data);
+		data += environmentSize * environmentSize * 3 * sizeof(GLushort);
+	}
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, irrdianceWidth, irrdianceHeight, GL_RGB, GL_HALF_FLOAT, data);
+		data += irrdianceWidth * irrdianceHeight * 3 * sizeof(GLushort);
+	}
+
+	if (useOctahedralPrefilter)
+	{
+		glBindTexture(GL_TEXTURE_2D, prefilterOctMap);
+		for (int mip = 0; mip < prefilterMipLevels; ++mip)
+		{
+			int mipSize = prefilterOctahedralSize >> mip;
+			glTexSubImage2D(GL_TEXTURE_2D, mip, 0, 0, mipSize, mipSize, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, data);
+			data += mipSize * mipSize * sizeof(GLuint);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+		for (int mip = 0; mip < prefilterMipLevels; ++mip)
+		{
+			int mipWidth = prefilterWidth >> mip;
+			int mipHeight = prefilterHeight >> mip;
+
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, 0, 0, mipWidth, mipHeight, GL_RGB, GL_HALF_FLOAT, data);
+				data += mipWidth * mipHeight * 3 * sizeof(GLushort);
+			}
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	progressiveStep = -1;
+	environmentReady = true;
 }
 
 void PBR::computeBRDFLut()
@@ -229,6 +628,41 @@ void PBR::computeBRDFLut()
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+bool PBR::loadBRDFLut(string filepath)
+{
+	ifstream file(filepath, ios::in | ios::binary);
+	char magic[4];
+	int size[2];
+
+	if (!file.read(magic, 4) || !file.read((char*)size, sizeof(size)) || string(magic, 4) != "BRDF")
+	{
+		cout << "Error loading BRDF LUT: " << filepath << endl;
+		return false;
+	}
+
+	if (size[0] != brdfLUTWidth || size[1] != brdfLUTHeight)
+	{
+		cout << "BRDF LUT has size " << size[0] << "x" << size[1] << ", expected " << brdfLUTWidth << "x" << brdfLUTHeight << endl;
+		return false;
+	}
+
+	// Scale and bias as half floats
+	vector<GLushort> data(brdfLUTWidth * brdfLUTHeight * 2);
+
+	if (!file.read((char*)&data[0], data.size() * sizeof(GLushort)))
+	{
+		cout << "BRDF LUT is truncated: " << filepath << endl;
+		return false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, brdfLUT);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, brdfLUTWidth, brdfLUTHeight, GL_RG, GL_HALF_FLOAT, &data[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	cout << "BRDF LUT loaded: " << filepath << endl;
+	return true;
+}
+
 void PBR::computeReflectanceMap(GLuint normalMap, GLuint colorMap)
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
@@ -255,6 +689,73 @@ void PBR::computeReflectanceMap(GLuint normalMap, GLuint colorMap)
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// Single work group reduction of the frame into irradiance coefficients, cheap enough to run every frame
+void PBR::computeSHIrradiance(GLuint colorMap, bool equirectangular)
+{
+	shIrradianceShader->apply();
+	glUniform1i(glGetUniformLocation(shIrradianceShader->getShaderId(), "colorMap"), 0);
+	glUniform1i(glGetUniformLocation(shIrradianceShader->getShaderId(), "sampleCount"), shSampleCount);
+	glUniform1i(glGetUniformLocation(shIrradianceShader->getShaderId(), "equirectangular"), equirectangular);
+	// Same orientation as the cubemap conversion of recomputeEnvMaps
+	glUniform1i(glGetUniformLocation(shIrradianceShader->getShaderId(), "recapture"), 0);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, colorMap);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, shIrradianceBuffer);
+
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_UNIFORM_BARRIER_BIT);
+}
+
+void PBR::setUseSHIrradiance(bool value)
+{
+	useSHIrradiance = value;
+
+	GLint flag = useSHIrradiance;
+	glBindBuffer(GL_UNIFORM_BUFFER, shIrradianceBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 9 * sizeof(glm::vec4), sizeof(GLint), &flag);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void PBR::setUseProgressiveUpdate(bool value)
+{
+	useProgressiveUpdate = value;
+
+	// A pending refresh only touched the back buffers, dropping it leaves the visible maps intact
+	if (!useProgressiveUpdate)
+	{
+		progressiveStep = -1;
+		hasQueuedEstimate = false;
+	}
+}
+
+// Switching layouts reallocates the maps and refilters the current source
+void PBR::setUseOctahedralPrefilter(bool value)
+{
+	if (useOctahedralPrefilter == value) return;
+
+	useOctahedralPrefilter = value;
+	progressiveStep = -1;
+
+	releaseEnvironmentMaps();
+	allocateEnvironmentMaps();
+
+	if (environmentReady) computeEnvMaps();
+}
+
+// Binds the prefiltered environment of the current layout, the unused sampler gets an empty texture
+void PBR::bindPrefilter(GLuint shaderId, int cubeUnit, int octahedralUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + cubeUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+	glActiveTexture(GL_TEXTURE0 + octahedralUnit);
+	glBindTexture(GL_TEXTURE_2D, prefilterOctMap);
+
+	glUniform1i(Shader::getUniformLocation(shaderId, "prefilterMap"), cubeUnit);
+	glUniform1i(Shader::getUniformLocation(shaderId, "prefilterOctMap"), octahedralUnit);
+	glUniform1i(Shader::getUniformLocation(shaderId, "useOctahedralPrefilter"), useOctahedralPrefilter);
+}
+
 GLuint PBR::getEnvironmentMapId() const
 {
 	return environmentMap;
@@ -278,4 +779,24 @@ GLuint PBR::getBrdfLUTId() const
 GLuint PBR::getReflectanceMapId() const
 {
 	return reflectanceMap;
+}
+
+bool PBR::getUseSHIrradiance() const
+{
+	return useSHIrradiance;
+}
+
+GLuint PBR::getPrefilterOctMapId() const
+{
+	return prefilterOctMap;
+}
+
+bool PBR::getUseOctahedralPrefilter() const
+{
+	return useOctahedralPrefilter;
+}
+
+bool PBR::getUseProgressiveUpdate() const
+{
+	return useProgressiveUpdate;
 }
\ No newline at end of file
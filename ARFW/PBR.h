@@ -2,6 +2,7 @@
 
 #include "global.h"
 #include "Quad.h"
+#include "EnvironmentCache.h"
 
 class PBR
 {
@@ -19,25 +20,83 @@ private:
 	const int prefilterHeight = 1024;
 	const int brdfLUTWidth = 512;
 	const int brdfLUTHeight = 512;
+	const int prefilterMipLevels = 5;
+	const int prefilterOctahedralSize = 1024;
 
 	int windowWidth, windowHeight;
 
+	// Diffuse environment as 9 spherical harmonics coefficients instead of the irradiance cubemap
+	bool useSHIrradiance = true;
+	const int shSampleCount = 16384;
+
+	// Prefiltered environment as one octahedral RGB9_E5 texture instead of RGB16F cubemaps,
+	// the capture it is filtered from shrinks to the resolution the prefilter shader assumes
+	bool useOctahedralPrefilter = false;
+	int environmentSize;
+
+	// Refresh the specular maps in slices over several frames and swap them in once complete
+	bool useProgressiveUpdate = true;
+	const int progressiveTexelBudget = 1024 * 1024;
+	int progressiveStep = -1;
+	bool environmentReady = false;
+
+	// Panorama files are cached on disk with all their convolutions
+	EnvironmentCache* environmentCache;
+	bool isEquirectangular = false;
+	bool isLinearSource = false;
+	const int environmentCacheVersion = 1;
+
+	// Coefficients estimated on the CPU, applied together with the maps they belong to
+	std::vector<glm::vec4> pendingSHCoefficients;
+
+	// Newest estimate that arrived during a refresh, started once that refresh has swapped
+	bool hasQueuedEstimate = false;
+	GLuint queuedEstimateMap = 0;
+	std::vector<glm::vec4> queuedSHCoefficients;
+
+	glm::mat4 captureProjection;
+	glm::mat4 captureViews[6];
+
 	Shader* imgToCubemapShader;
 	Shader* hdrToCubemapShader;
 	Shader* hdrIrradianceShader;
 	Shader* prefilterShader;
+	Shader* prefilterOctShader;
 	Shader* brdfShader;
 	Shader* reflectanceShader;
+	Shader* shIrradianceShader;
 
 	GLuint captureFBO;
 	GLuint captureRBO;
 
 	GLuint hdrRadiance;
+	GLuint loadedPanorama = 0;
 	GLuint environmentMap;
+	GLuint environmentMapBack;
 	GLuint irradianceMap;
 	GLuint prefilterMap;
+	GLuint prefilterMapBack;
+	GLuint prefilterOctMap;
+	GLuint prefilterOctMapBack;
+	GLuint octahedralEncodeTexture;
+	GLuint octahedralEncodePBO;
 	GLuint brdfLUT;
 	GLuint reflectanceMap;
+	GLuint shIrradianceBuffer;
+
+	void allocateEnvironmentMaps();
+	void releaseEnvironmentMaps();
+	GLuint createCubemap(int width, int height, bool mipmapped);
+	GLuint createOctahedralMap(int size);
+	void captureEnvironment(GLuint targetMap);
+	void computeIrradiance();
+	void computeIrradianceCubemap();
+	void prefilterSlices(bool backBuffer, int mip, int firstSlice, int sliceCount);
+	void prefilterFaces(GLuint targetMap, GLuint sourceMap, int mip, int firstFace, int faceCount);
+	void prefilterBands(GLuint targetMap, GLuint sourceMap, int mip, int firstBand, int bandCount);
+	size_t getEnvironmentCacheSize() const;
+	std::vector<char> readbackEnvironment();
+	void uploadEnvironment(const char* data);
 
 public:
 
@@ -47,14 +106,28 @@ public:
 	void recompileShaders();
 	void computeEnvMaps();
 	void computeBRDFLut();
+	bool loadBRDFLut(std::string filepath);
 	void recomputeEnvMaps(GLuint colorMap);
+	void loadEnvironment(std::string filepath);
+	void setEnvironmentEstimate(GLuint equirectangularMap, const std::vector<glm::vec4>& shCoefficients);
 	void recomputeBothSums(GLuint colorMap);
 	void computeReflectanceMap(GLuint normalMap, GLuint colorMap);
+	void computeSHIrradiance(GLuint colorMap, bool equirectangular = false);
+	void updateProgressive();
+	void bindPrefilter(GLuint shaderId, int cubeUnit, int octahedralUnit) const;
+
+	void setUseSHIrradiance(bool value);
+	void setUseProgressiveUpdate(bool value);
+	void setUseOctahedralPrefilter(bool value);
 
 	GLuint getEnvironmentMapId() const;
 	GLuint getIrradianceMapId() const;
 	GLuint getPrefilterMapId() const;
+	GLuint getPrefilterOctMapId() const;
 	GLuint getBrdfLUTId() const;
 	GLuint getReflectanceMapId() const;
+	bool getUseSHIrradiance() const;
+	bool getUseProgressiveUpdate() const;
+	bool getUseOctahedralPrefilter() const;
 
 };
\ No newline at end of file
@@ -26,29 +26,11 @@ SSAO::SSAO(int width, int height)
 		kernel.push_back(sample);
 	}
 
-	// Generate noise texture
-	vector<vec3> ssaoNoise;
-
-	for (int i = 0; i < (int)(texWidthSmall * texHeightSmall); i++)
-	{
-		//vec3 noise(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, 0.0f);
-		vec3 noise(randomFloats(generator), randomFloats(generator), 0.0f);
-		ssaoNoise.push_back(noise);
-	}
-
-	glGenTextures(1, &noiseTexId);
-	glBindTexture(GL_TEXTURE_2D, noiseTexId);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidthSmall, texHeightSmall, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	quad = new Quad();
 	shader = new Shader("ssao");
 	upsampleShader = new Shader("ssaoUpsample");
 	mixLayerShader = new Shader("ssaoMixLayer");
+	parametersBlock = new UniformBlock<SSAOParameters>(13);
 	initializeShaders();
 
 	glGenFramebuffers(1, &fbo);
@@ -105,35 +87,28 @@ SSAO::~SSAO()
 	delete quad;
 	delete shader;
 	delete mixLayerShader;
+	delete parametersBlock;
+	if (temporalLayer1 != nullptr) delete temporalLayer1;
+	if (temporalLayer2 != nullptr) delete temporalLayer2;
 }
 
 void SSAO::initializeShaders()
 {
-	shader->apply();
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "inNoise"), 2);
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "gColor"), 3);
-	glUniform3fv(glGetUniformLocation(shader->getShaderId(), "inSamples"), 64, value_ptr(kernel[0]));
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "kernelSize"), kernelSize);
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "kernelRadius"), kernelRadius);
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "samples"), samples);
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "bias"), bias);
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "intensity"), intensity);
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "power"), power);
+	shader->setUniform("gDepth", 0);
+	shader->setUniform("gNormal", 1);
+	shader->setUniform("gColor", 3);
+	shader->setUniformArray("inSamples", 64, &kernel[0]);
 
 	computeBlurKernel();
-	upsampleShader->apply();
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "inColor"), 0);
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "inPosition"), 1);
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "inNormal"), 2);
-	glUniform1f(glGetUniformLocation(upsampleShader->getShaderId(), "zsigma"), blurZSigma);
-	glUniform1f(glGetUniformLocation(upsampleShader->getShaderId(), "nsigma"), blurNSigma);
-
-	mixLayerShader->apply();
-	glUniform1i(glGetUniformLocation(mixLayerShader->getShaderId(), "layer1"), 0);
-	glUniform1i(glGetUniformLocation(mixLayerShader->getShaderId(), "layer2"), 1);
-	glUniform1i(glGetUniformLocation(mixLayerShader->getShaderId(), "gColor"), 2);
+	upsampleShader->setUniform("inColor", 0);
+	upsampleShader->setUniform("inDepth", 1);
+	upsampleShader->setUniform("inNormal", 2);
+	upsampleShader->setUniform("zsigma", blurZSigma);
+	upsampleShader->setUniform("nsigma", blurNSigma);
+
+	mixLayerShader->setUniform("layer1", 0);
+	mixLayerShader->setUniform("layer2", 1);
+	mixLayerShader->setUniform("gColor", 2);
 }
 
 void SSAO::recompileShaders()
@@ -141,45 +116,66 @@ void SSAO::recompileShaders()
 	shader->recompile();
 	upsampleShader->recompile();
 	mixLayerShader->recompile();
+	if (temporalLayer1 != nullptr) temporalLayer1->recompileShaders();
+	if (temporalLayer2 != nullptr) temporalLayer2->recompileShaders();
 	
 	initializeShaders();
 }
 
-void SSAO::drawLayer(int layer, GLuint positionMapId, GLuint normalMapId, GLuint colorMapId)
+void SSAO::drawLayer(int layer, GLuint depthMapId, GLuint normalMapId, GLuint colorMapId, GLuint motionMapId)
 {
 	// Compute ssao for each layer
+	GpuProfileScope sampleScope(profiler, "ssaoSample");
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texSSAO, 0);
 
 	glViewport(0, 0, texWidthSmall, texHeightSmall);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	// All sampling settings go up in one buffer write, skipped while nothing changed
+	SSAOParameters parameters = {};
+	parameters.kernelSize = kernelSize;
+	parameters.samples = getFrameSamples();
+	parameters.frameIndex = useTemporalFilter ? frameIndex : 0;
+	parameters.kernelRadius = kernelRadius;
+	parameters.bias = bias;
+	parameters.intensity = intensity;
+	parameters.power = power;
+	parametersBlock->set(parameters);
+	parametersBlock->bind();
+
 	shader->apply();
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, positionMapId);
+	glBindTexture(GL_TEXTURE_2D, depthMapId);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, normalMapId);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, noiseTexId);
 	glActiveTexture(GL_TEXTURE3);
 	glBindTexture(GL_TEXTURE_2D, colorMapId);
 
+	if (blueNoise != nullptr)
+	{
+		blueNoise->bind(shader->getShaderId(), 2, useTemporalFilter);
+	}
+
 	quad->draw();
 
+	sampleScope.end();
+
 	// Upsample to full resolution (horizontal pass)
+	GpuProfileScope upsampleScope(profiler, "ssaoUpsample");
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texFilterH, 0);
 
 	glViewport(0, 0, texWidth, texHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	upsampleShader->apply();
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "isVertical"), 0);
+	upsampleShader->setUniform("isVertical", 0);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texSSAO);
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, positionMapId);
+	glBindTexture(GL_TEXTURE_2D, depthMapId);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, normalMapId);
 
@@ -195,20 +191,32 @@ void SSAO::drawLayer(int layer, GLuint positionMapId, GLuint normalMapId, GLuint
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	upsampleShader->apply();
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "isVertical"), 1);
+	upsampleShader->setUniform("isVertical", 1);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texFilterH);
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, positionMapId);
+	glBindTexture(GL_TEXTURE_2D, depthMapId);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, normalMapId);
 
 	quad->draw();
+
+	upsampleScope.end();
+
+	// Accumulate with the reprojected history of this layer
+	if (useTemporalFilter)
+	{
+		GpuProfileScope temporalScope(profiler, "ssaoTemporal");
+		TemporalFilter* temporalFilter = (layer == 1) ? temporalLayer1 : temporalLayer2;
+		temporalFilter->resolve(texLayer, depthMapId, normalMapId, motionMapId);
+	}
 }
 
 void SSAO::drawCombined(GLuint colorMapId)
 {
+	GpuProfileScope combineScope(profiler, "ssaoCombine");
+
 	// Combine the 2 ssao layer results
 	glBindFramebuffer(GL_FRAMEBUFFER, fboCombined);
 	glViewport(0, 0, texWidth, texHeight);
@@ -217,15 +225,18 @@ void SSAO::drawCombined(GLuint colorMapId)
 	mixLayerShader->apply();
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texFilterV1);
+	glBindTexture(GL_TEXTURE_2D, getTextureLayer(1));
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texFilterV2);
+	glBindTexture(GL_TEXTURE_2D, getTextureLayer(2));
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, colorMapId);
 
 	quad->draw();
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Rotate the sample pattern every frame so the history sees new samples, a still pattern without it
+	if (useTemporalFilter) frameIndex++;
 }
 
 float SSAO::normpdf(float x, float s)
@@ -243,17 +254,23 @@ void SSAO::computeBlurKernel()
 		blurKernel.at(blurKernelRadius + i) = blurKernel.at(blurKernelRadius - i) = value;
 	}
 
-	upsampleShader->apply();
-	glUniform1fv(glGetUniformLocation(upsampleShader->getShaderId(), "kernel"), blurKernelRadius * 2 + 1, &blurKernel[0]);
-	glUniform1i(glGetUniformLocation(upsampleShader->getShaderId(), "kernelRadius"), blurKernelRadius);
-	glUniform1f(glGetUniformLocation(upsampleShader->getShaderId(), "sigma"), blurSigma);
+	upsampleShader->setUniformArray("kernel", blurKernelRadius * 2 + 1, &blurKernel[0]);
+	upsampleShader->setUniform("kernelRadius", blurKernelRadius);
+	upsampleShader->setUniform("sigma", blurSigma);
+}
+
+// Samples taken per frame, temporal accumulation makes up for the rest
+int SSAO::getFrameSamples() const
+{
+	if (!useTemporalFilter) return samples;
+	return glm::max(1, samples / temporalSampleDivisor);
 }
 
 GLuint SSAO::getTextureLayer(int layer) const
 {
 	if (layer == 0) return texCombined;
-	else if (layer == 1) return texFilterV1;
-	else return texFilterV2;
+	else if (layer == 1) return useTemporalFilter ? temporalLayer1->getOutputTexture() : texFilterV1;
+	else return useTemporalFilter ? temporalLayer2->getOutputTexture() : texFilterV2;
 }
 
 int SSAO::getKernelSize() const
@@ -306,46 +323,44 @@ float SSAO::getBlurNSigma() const
 	return blurNSigma;
 }
 
+bool SSAO::getUseTemporalFilter() const
+{
+	return useTemporalFilter;
+}
+
+int SSAO::getTemporalSampleDivisor() const
+{
+	return temporalSampleDivisor;
+}
+
 void SSAO::setKernelSize(int value)
 {
 	kernelSize = value;
-	shader->apply();
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "kernelSize"), kernelSize);
 }
 
 void SSAO::setKernelRadius(float value)
 {
 	kernelRadius = value;
-	shader->apply();
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "kernelRadius"), kernelRadius);
 }
 
 void SSAO::setSamples(int value)
 {
 	samples = value;
-	shader->apply();
-	glUniform1i(glGetUniformLocation(shader->getShaderId(), "samples"), samples);
 }
 
 void SSAO::setBias(float value)
 {
 	bias = value;
-	shader->apply();
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "bias"), bias);
 }
 
 void SSAO::setIntensity(float value)
 {
 	intensity = value;
-	shader->apply();
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "intensity"), intensity);
 }
 
 void SSAO::setPower(float value)
 {
 	power = value;
-	shader->apply();
-	glUniform1f(glGetUniformLocation(shader->getShaderId(), "power"), power);
 }
 
 void SSAO::setBlurKernelRadius(int value)
@@ -363,13 +378,47 @@ void SSAO::setBlurSigma(float value)
 void SSAO::setBlurZSigma(float value)
 {
 	blurZSigma = value;
-	upsampleShader->apply();
-	glUniform1f(glGetUniformLocation(upsampleShader->getShaderId(), "zsigma"), blurZSigma);
+	upsampleShader->setUniform("zsigma", blurZSigma);
 }
 
 void SSAO::setBlurNSigma(float value)
 {
 	blurNSigma = value;
-	upsampleShader->apply();
-	glUniform1f(glGetUniformLocation(upsampleShader->getShaderId(), "nsigma"), blurNSigma);
+	upsampleShader->setUniform("nsigma", blurNSigma);
+}
+
+void SSAO::setUseTemporalFilter(bool value)
+{
+	useTemporalFilter = value;
+
+	// History buffers are only allocated once somebody opts in
+	if (useTemporalFilter && temporalLayer1 == nullptr)
+	{
+		temporalLayer1 = new TemporalFilter(texWidth, texHeight);
+		temporalLayer2 = new TemporalFilter(texWidth, texHeight);
+	}
+
+	if (useTemporalFilter)
+	{
+		temporalLayer1->reset();
+		temporalLayer2->reset();
+	}
+}
+
+void SSAO::setTemporalSampleDivisor(int value)
+{
+	temporalSampleDivisor = glm::max(1, value);
+}
+
+// Shared blue noise for the sample rotation, nullptr falls back to a per pixel hash
+void SSAO::setBlueNoise(BlueNoise* noise)
+{
+	blueNoise = noise;
+	shader->setUniform("useBlueNoise", blueNoise != nullptr ? 1 : 0);
+}
+
+// Times the sample, upsample and temporal steps of every layer, nullptr disables it
+void SSAO::setProfiler(GpuProfiler* profiler)
+{
+	this->profiler = profiler;
 }
\ No newline at end of file
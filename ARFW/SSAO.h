@@ -3,8 +3,25 @@
 #include "global.h"
 #include "Quad.h"
 #include "Shader.h"
+#include "TemporalFilter.h"
+#include "BlueNoise.h"
+#include "UniformBlock.h"
+#include "GpuProfiler.h"
 #include <random>
 
+// Sampling settings of the ssao pass, std140 block at binding 13
+struct SSAOParameters
+{
+	int kernelSize;
+	int samples;
+	int frameIndex;
+	float kernelRadius;
+	float bias;
+	float intensity;
+	float power;
+	float padding;
+};
+
 class SSAO
 {
 
@@ -25,18 +42,28 @@ private:
 	float blurZSigma = 0.01f;
 	float blurNSigma = 0.1f;
 
+	// Temporal accumulation lets each frame take a fraction of the samples
+	bool useTemporalFilter = false;
+	int temporalSampleDivisor = 4;
+	int frameIndex = 0;
+	TemporalFilter* temporalLayer1 = nullptr;
+	TemporalFilter* temporalLayer2 = nullptr;
+
 	std::vector<glm::vec3> kernel;
-	GLuint noiseTexId;
+	BlueNoise* blueNoise = nullptr;
+	GpuProfiler* profiler = nullptr;
 	GLuint fbo, fboCombined;
 	Quad* quad;
 	Shader* shader, * mixLayerShader, * upsampleShader;
+	UniformBlock<SSAOParameters>* parametersBlock;
 	GLuint texWidth, texHeight, texWidthSmall, texHeightSmall;
 	GLuint texSSAO, texFilterH, texFilterV1, texFilterV2, texCombined;
 
-	GLuint positionMapId, normalMapId, colorMapId;
+	GLuint depthMapId, normalMapId, colorMapId;
 
 	float normpdf(float x, float s);
 	void computeBlurKernel();
+	int getFrameSamples() const;
 
 public:
 
@@ -45,7 +72,7 @@ public:
 
 	void initializeShaders();
 	void recompileShaders();
-	void drawLayer(int layer, GLuint positionMapId, GLuint normalMapId, GLuint colorMapId);
+	void drawLayer(int layer, GLuint depthMapId, GLuint normalMapId, GLuint colorMapId, GLuint motionMapId = 0);
 	void drawCombined(GLuint colorMapId);
 
 	GLuint getTextureLayer(int layer) const;
@@ -59,6 +86,8 @@ public:
 	float getBlurSigma() const;
 	float getBlurZSigma() const;
 	float getBlurNSigma() const;
+	bool getUseTemporalFilter() const;
+	int getTemporalSampleDivisor() const;
 
 	void setKernelSize(int value);
 	void setKernelRadius(float value);
@@ -70,5 +99,9 @@ public:
 	void setBlurSigma(float value);
 	void setBlurZSigma(float value);
 	void setBlurNSigma(float value);
+	void setUseTemporalFilter(bool value);
+	void setBlueNoise(BlueNoise* noise);
+	void setProfiler(GpuProfiler* profiler);
+	void setTemporalSampleDivisor(int value);
 
 };
\ No newline at end of file
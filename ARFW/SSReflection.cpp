@@ -6,7 +6,11 @@ SSReflection::SSReflection(int width, int height)
 
 	ssReflectionPassShader = new Shader("reflectPass");
 	gaussianBlurShader = new Shader("gaussianBlur");
+	blurMipChainShader = new Shader("blurMipChain");
 	coneTraceShader = new Shader("coneTrace");
+	summedAreaTableShader = new Shader("summedAreaTable");
+	coneTraceSATShader = new Shader("coneTraceSAT");
+	parametersBlock = new UniformBlock<SSRParameters>(14);
 
 	initializeShaders();
 
@@ -14,6 +18,7 @@ SSReflection::SSReflection(int width, int height)
 	bufferHeight = height;
 	cFilterWidth = width;
 	cFilterHeight = height;
+	scissorRect = glm::ivec4(0, 0, width, height);
 	//maxMipLevels = 1 + (int)floor(log2(glm::max(bufferWidth, bufferHeight)));
 	computeGaussianKernel();
 
@@ -51,23 +56,7 @@ SSReflection::SSReflection(int width, int height)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glGenerateMipmap(GL_TEXTURE_2D);
 
-	glGenTextures(1, &cLightFilterH2);
-	glBindTexture(GL_TEXTURE_2D, cLightFilterH2);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, cFilterWidth, cFilterHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glGenTextures(1, &cLightFilterV2);
-	glBindTexture(GL_TEXTURE_2D, cLightFilterV2);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, cFilterWidth, cFilterHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if (useSummedAreaTable) createSummedAreaTables();
 
 	glGenFramebuffers(1, &fbo);
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
@@ -78,11 +67,13 @@ SSReflection::SSReflection(int width, int height)
 
 SSReflection::~SSReflection()
 {
+	delete parametersBlock;
 }
 
-void SSReflection::draw(GLuint texPosition, GLuint texNormal, GLuint texLight, GLuint irrEnv, GLuint prefiltEnv, GLuint outTexture, GLuint aoTexture)
+void SSReflection::draw(GLuint texDepth, GLuint texNormal, GLuint texMaterial, GLuint texLight, GLuint irrEnv, GLuint prefiltEnv, GLuint outTexture, GLuint aoTexture, GLuint motionTexture)
 {
 	// Screen space reflection pass
+	GpuProfileScope rayTraceScope(profiler, "ssrRayTrace");
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cReflection, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, cReflectionRay, 0);
@@ -91,10 +82,17 @@ void SSReflection::draw(GLuint texPosition, GLuint texNormal, GLuint texLight, G
 	glViewport(0, 0, bufferWidth, bufferHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	// Untraced pixels keep an unoccluded ambient occlusion
+	const float unoccluded[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearBufferfv(GL_COLOR, 2, unoccluded);
+
+	updateParameters();
+	if (useTemporalFilter) frameIndex++;
+
 	ssReflectionPassShader->apply();
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texPosition);
+	glBindTexture(GL_TEXTURE_2D, texDepth);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, texNormal);
 	glActiveTexture(GL_TEXTURE2);
@@ -104,142 +102,228 @@ void SSReflection::draw(GLuint texPosition, GLuint texNormal, GLuint texLight, G
 	glActiveTexture(GL_TEXTURE4);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, prefiltEnv);
 
-	quad->draw();
+	if (blueNoise != nullptr)
+	{
+		blueNoise->bind(ssReflectionPassShader->getShaderId(), 5, useTemporalFilter);
+	}
+
+	// Skip tiles outside the list, the cleared reflection falls back to the prefiltered environment.
+	// Pixels outside the scissor rectangle are not traced at all, the clear above still covers them
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(scissorRect.x, scissorRect.y, scissorRect.z, scissorRect.w);
+
+	if (tileClassifier != nullptr)
+	{
+		tileClassifier->drawTiles(ssReflectionPassShader->getShaderId(), tileList);
+	}
+	else
+	{
+		quad->draw();
+	}
+
+	glDisable(GL_SCISSOR_TEST);
 
 	// Make sure to unbind drawing to other attachments
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, 0, 0);
 
-	// Create a mip chain of blurred light (color) buffer
-	gaussianBlurShader->apply();
+	rayTraceScope.end();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, cReflection);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, aoTexture);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, texPosition);
+	// Blend the traced reflection with its reprojected history. Every input geometry keeps its own,
+	// the output targets may be aliased by the frame graph and are no stable key
+	GLuint reflectionSource = cReflection;
 
-	for (int mip = 0; mip <= maxMipLevels; mip++)
+	if (useTemporalFilter)
 	{
-		gaussianKernelRadius = (int)glm::clamp(pow(mipBasePower, mip), 0.0f, 64.0f);
-		gaussianSigma = (float)gaussianKernelRadius;
-		computeGaussianKernel();
-		glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "mipLevel"), mip);
+		GpuProfileScope temporalScope(profiler, "ssrTemporal");
+		TemporalFilter*& temporalFilter = temporalFilters[texDepth];
+		if (temporalFilter == nullptr) temporalFilter = new TemporalFilter(bufferWidth, bufferHeight);
 
-		// Reisze framebuffer according to mip-level size
-		int mipWidth = (int)(cFilterWidth * std::pow(0.5f, mip));
-		int mipHeight = (int)(cFilterHeight * std::pow(0.5f, mip));
+		reflectionSource = temporalFilter->resolve(cReflection, texDepth, texNormal, motionTexture);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cLightFilterH, mip);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, cLightFilterH2, mip);
-		glViewport(0, 0, mipWidth, mipHeight);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	GpuProfileScope lightFilterScope(profiler, "ssrLightFilter");
 
-		glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "isVertical"), 0);
+	if (useSummedAreaTable)
+	{
+		// Build a summed area table of the light buffer, rows first then columns
+		summedAreaTableShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, reflectionSource);
+
+		summedAreaTableShader->setUniform("isVertical", 0);
+		glBindImageTexture(0, cReflectionRows, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
+		glDispatchCompute(1, bufferHeight, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		summedAreaTableShader->setUniform("isVertical", 1);
+		glBindImageTexture(0, cReflectionSAT, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
+		glBindImageTexture(1, cReflectionRows, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32UI);
+		glDispatchCompute(1, bufferWidth, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+	else if (useComputeMipChain && maxMipLevels <= maxComputeMipLevels)
+	{
+		// Create a mip chain of blurred light (color) buffer in a single dispatch
+		blurMipChainShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, reflectionSource);
 
-		if (mip != 0)
+		for (int mip = 0; mip <= maxComputeMipLevels; mip++)
 		{
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, cLightFilterH);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, cLightFilterH2);
+			glBindImageTexture(mip, cLightFilterV, mip, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
 		}
 
-		/*glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, cReflection);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, cAmbientOcclusion);*/
+		glDispatchCompute((cFilterWidth + 63) / 64, (cFilterHeight + 63) / 64, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+	else
+	{
+		// Create a mip chain of blurred light (color) buffer
+		gaussianBlurShader->apply();
 
-		quad->draw();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, reflectionSource);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, texDepth);
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cLightFilterV, mip);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, cLightFilterV2, mip);
-		glViewport(0, 0, mipWidth, mipHeight);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (int mip = 0; mip <= maxMipLevels; mip++)
+		{
+			gaussianKernelRadius = (int)glm::clamp(pow(mipBasePower, mip), 0.0f, 64.0f);
+			gaussianSigma = (float)gaussianKernelRadius;
+			computeGaussianKernel();
+			gaussianBlurShader->setUniform("mipLevel", mip);
 
-		glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "isVertical"), 1);
+			// Reisze framebuffer according to mip-level size
+			int mipWidth = (int)(cFilterWidth * std::pow(0.5f, mip));
+			int mipHeight = (int)(cFilterHeight * std::pow(0.5f, mip));
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, cLightFilterH);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, cLightFilterH2);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cLightFilterH, mip);
+			glViewport(0, 0, mipWidth, mipHeight);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		quad->draw();
+			gaussianBlurShader->setUniform("isVertical", 0);
+
+			if (mip != 0)
+			{
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, cLightFilterH);
+			}
+
+			/*glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, cReflection);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, cAmbientOcclusion);*/
+
+			quad->draw();
+
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cLightFilterV, mip);
+			glViewport(0, 0, mipWidth, mipHeight);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			gaussianBlurShader->setUniform("isVertical", 1);
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, cLightFilterH);
+
+			quad->draw();
+		}
 	}
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+	lightFilterScope.end();
 
 	// Cone tracing
+	GpuProfileScope coneTraceScope(profiler, "ssrConeTrace");
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outTexture, 0);
 
 	glViewport(0, 0, bufferWidth, bufferHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	coneTraceShader->apply();
+	Shader* coneShader = useSummedAreaTable ? coneTraceSATShader : coneTraceShader;
+	coneShader->apply();
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texPosition);
+	glBindTexture(GL_TEXTURE_2D, texMaterial);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, texNormal);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, texLight);
 	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, cLightFilterV);
+	glBindTexture(GL_TEXTURE_2D, useSummedAreaTable ? cReflectionSAT : cLightFilterV);
 	glActiveTexture(GL_TEXTURE4);
 	glBindTexture(GL_TEXTURE_2D, cReflectionRay);
 	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, cLightFilterV2);
+	glBindTexture(GL_TEXTURE_2D, aoTexture);
 
-	quad->draw();
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(scissorRect.x, scissorRect.y, scissorRect.z, scissorRect.w);
+
+	if (tileClassifier != nullptr)
+	{
+		tileClassifier->drawTiles(coneShader->getShaderId(), tileList);
+	}
+	else
+	{
+		quad->draw();
+	}
+
+	glDisable(GL_SCISSOR_TEST);
 }
 
 void SSReflection::initializeShaders()
 {
-	ssReflectionPassShader->apply();
-	glUniform1i(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "inColor"), 2);
-	glUniform1i(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "irradianceMap"), 3);
-	glUniform1i(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "prefilterMap"), 4);
-
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "maxSteps"), maxSteps);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "binarySearchSteps"), binarySearchSteps);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "maxRayTraceDistance"), maxRayTraceDistance);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "nearPlaneZ"), nearPlaneZ);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "rayZThickness"), rayZThickness);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "stride"), stride);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "strideZCutoff"), strideZCutoff);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "jitterFactor"), jitterFactor);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "screenEdgeFadeStart"), screenEdgeFadeStart);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "cameraFadeStart"), cameraFadeStart);
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "cameraFadeLength"), cameraFadeLength);
+	ssReflectionPassShader->setUniform("gDepth", 0);
+	ssReflectionPassShader->setUniform("gNormal", 1);
+	ssReflectionPassShader->setUniform("inColor", 2);
+	ssReflectionPassShader->setUniform("irradianceMap", 3);
+	ssReflectionPassShader->setUniform("prefilterMap", 4);
 
 	computeGaussianKernel();
-	gaussianBlurShader->apply();
-	glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "inColor"), 0);
-	glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "inColor2"), 1);
-	glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "inPosition"), 2);
-	glUniform1f(glGetUniformLocation(gaussianBlurShader->getShaderId(), "bsigma"), gaussianBSigma);
-
-	coneTraceShader->apply();
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "inLight"), 2);
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "inReflection"), 3);
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "inReflectionRay"), 4);
-	glUniform1i(glGetUniformLocation(coneTraceShader->getShaderId(), "inAmbientOcclusion"), 5);
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "sharpness"), sharpness);
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "sharpnessPower"), sharpnessPower);
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "mipLevel"), coneTraceMipLevel);
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "maxMipLevel"), (float)maxMipLevels);
+	gaussianBlurShader->setUniform("inColor", 0);
+	gaussianBlurShader->setUniform("inDepth", 2);
+	gaussianBlurShader->setUniform("bsigma", gaussianBSigma);
+
+	computeMipKernels();
+	blurMipChainShader->setUniform("inColor", 0);
+	blurMipChainShader->setUniform("maxMipLevel", maxMipLevels);
+
+	coneTraceShader->setUniform("gMaterial", 0);
+	coneTraceShader->setUniform("gNormal", 1);
+	coneTraceShader->setUniform("inLight", 2);
+	coneTraceShader->setUniform("inReflection", 3);
+	coneTraceShader->setUniform("inReflectionRay", 4);
+	coneTraceShader->setUniform("inAmbientOcclusion", 5);
+	coneTraceShader->setUniform("sharpness", sharpness);
+	coneTraceShader->setUniform("sharpnessPower", sharpnessPower);
+	coneTraceShader->setUniform("mipLevel", coneTraceMipLevel);
+	coneTraceShader->setUniform("maxMipLevel", (float)maxMipLevels);
+
+	summedAreaTableShader->setUniform("inColor", 0);
+
+	coneTraceSATShader->setUniform("gMaterial", 0);
+	coneTraceSATShader->setUniform("gNormal", 1);
+	coneTraceSATShader->setUniform("inLight", 2);
+	coneTraceSATShader->setUniform("inSummedArea", 3);
+	coneTraceSATShader->setUniform("inReflectionRay", 4);
+	coneTraceSATShader->setUniform("maxBoxRadius", maxBoxRadius);
 }
 
 void SSReflection::recompileShaders()
 {
 	ssReflectionPassShader->recompile();
 	gaussianBlurShader->recompile();
+	blurMipChainShader->recompile();
 	coneTraceShader->recompile();
+	summedAreaTableShader->recompile();
+	coneTraceSATShader->recompile();
+
+	for (auto& temporalFilter : temporalFilters)
+	{
+		temporalFilter.second->recompileShaders();
+	}
 
 	initializeShaders();
 }
@@ -259,98 +343,144 @@ void SSReflection::computeGaussianKernel()
 		gaussianKernel.at(gaussianKernelRadius + i) = gaussianKernel.at(gaussianKernelRadius - i) = value;
 	}
 
-	gaussianBlurShader->apply();
-	glUniform1i(glGetUniformLocation(gaussianBlurShader->getShaderId(), "kernelRadius"), gaussianKernelRadius);
-	glUniform1fv(glGetUniformLocation(gaussianBlurShader->getShaderId(), "kernel"), gaussianKernelRadius * 2 + 1, &gaussianKernel[0]);
+	gaussianBlurShader->setUniform("kernelRadius", gaussianKernelRadius);
+	gaussianBlurShader->setUniformArray("kernel", gaussianKernelRadius * 2 + 1, &gaussianKernel[0]);
+}
+
+// Precompute the 4-tap downsample weights of every mip level for the single dispatch mip chain
+void SSReflection::computeMipKernels()
+{
+	mipKernels = std::vector<glm::vec4>(maxComputeMipLevels + 1, glm::vec4(0.25f));
+
+	for (int mip = 1; mip <= maxComputeMipLevels; mip++)
+	{
+		// Match the footprint of the separable pass, measured in texels of the previous mip level
+		float radius = glm::clamp((float)pow(mipBasePower, mip), 0.0f, 64.0f) / (float)pow(2.0f, mip - 1);
+		float sigma = glm::clamp(radius / 3.0f, 0.5f, 2.0f);
+
+		glm::vec4 kernel;
+		for (int i = 0; i < 4; i++)
+		{
+			kernel[i] = normpdf(i - 1.5f, sigma);
+		}
+
+		mipKernels.at(mip) = kernel / (kernel.x + kernel.y + kernel.z + kernel.w);
+	}
+
+	blurMipChainShader->setUniformArray("mipKernel", maxComputeMipLevels + 1, &mipKernels[0]);
+}
+
+// Tables are only allocated while the summed area table is used
+void SSReflection::createSummedAreaTables()
+{
+	glGenTextures(1, &cReflectionRows);
+	glBindTexture(GL_TEXTURE_2D, cReflectionRows);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, bufferWidth, bufferHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenTextures(1, &cReflectionSAT);
+	glBindTexture(GL_TEXTURE_2D, cReflectionSAT);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, bufferWidth, bufferHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// With temporal accumulation every frame marches half the steps at twice the stride,
+// the per frame jitter of the start offset fills the gaps over time
+void SSReflection::updateParameters()
+{
+	float strideScale = useTemporalFilter ? temporalStrideScale : 1.0f;
+
+	SSRParameters parameters = {};
+	parameters.maxSteps = maxSteps / strideScale;
+	parameters.binarySearchSteps = binarySearchSteps;
+	parameters.maxRayTraceDistance = maxRayTraceDistance;
+	parameters.nearPlaneZ = nearPlaneZ;
+	parameters.rayZThickness = rayZThickness;
+	parameters.stride = stride * strideScale;
+	parameters.strideZCutoff = strideZCutoff;
+	parameters.jitterFactor = jitterFactor;
+	parameters.screenEdgeFadeStart = screenEdgeFadeStart;
+	parameters.cameraFadeStart = cameraFadeStart;
+	parameters.cameraFadeLength = cameraFadeLength;
+	// Jitter only rotates over frames when the temporal filter averages it out
+	parameters.frameIndex = useTemporalFilter ? frameIndex : 0;
+
+	parametersBlock->set(parameters);
+	parametersBlock->bind();
 }
 
 void SSReflection::setMaxSteps(float value)
 {
 	maxSteps = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "maxSteps"), maxSteps);
 }
 
 void SSReflection::setBinarySearchSteps(float value)
 {
 	binarySearchSteps = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "binarySearchSteps"), binarySearchSteps);
 }
 
 void SSReflection::setMaxRayTraceDistance(float value)
 {
 	maxRayTraceDistance = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "maxRayTraceDistance"), maxRayTraceDistance);
 }
 
 void SSReflection::setNearPlaneZ(float value)
 {
 	nearPlaneZ = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "nearPlaneZ"), nearPlaneZ);
 }
 
 void SSReflection::setRayZThickness(float value)
 {
 	rayZThickness = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "rayZThickness"), rayZThickness);
 }
 
 void SSReflection::setStride(float value)
 {
 	stride = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "stride"), stride);
 }
 
 void SSReflection::setStrideZCutoff(float value)
 {
 	strideZCutoff = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "strideZCutoff"), strideZCutoff);
 }
 
 void SSReflection::setJitterFactor(float value)
 {
 	jitterFactor = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "jitterFactor"), jitterFactor);
 }
 
 void SSReflection::setScreenEdgeFadeStart(float value)
 {
 	screenEdgeFadeStart = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "screenEdgeFadeStart"), screenEdgeFadeStart);
 }
 
 void SSReflection::setCameraFadeStart(float value)
 {
 	cameraFadeStart = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "cameraFadeStart"), cameraFadeStart);
 }
 
 void SSReflection::setCameraFadeLength(float value)
 {
 	cameraFadeLength = value;
-	ssReflectionPassShader->apply();
-	glUniform1f(glGetUniformLocation(ssReflectionPassShader->getShaderId(), "cameraFadeLength"), cameraFadeLength);
 }
 
 void SSReflection::setMaxMipLevels(int value)
 {
 	maxMipLevels = value;
-	coneTraceShader->apply();
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "maxMipLevel"), (float)maxMipLevels);
+	coneTraceShader->setUniform("maxMipLevel", (float)maxMipLevels);
+	blurMipChainShader->setUniform("maxMipLevel", maxMipLevels);
 }
 
 void SSReflection::setMipBasePower(float value)
 {
 	mipBasePower = value;
+	computeMipKernels();
 }
 
 void SSReflection::setGaussianKernelRadius(int value)
@@ -368,29 +498,78 @@ void SSReflection::setGaussianSigma(float value)
 void SSReflection::setGaussianBSigma(float value)
 {
 	gaussianBSigma = value;
-	gaussianBlurShader->apply();
-	glUniform1f(glGetUniformLocation(gaussianBlurShader->getShaderId(), "bsigma"), gaussianBSigma);
+	gaussianBlurShader->setUniform("bsigma", gaussianBSigma);
 }
 
 void SSReflection::setConeTraceMipLevel(float value)
 {
 	coneTraceMipLevel = value;
-	coneTraceShader->apply();
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "mipLevel"), coneTraceMipLevel);
+	coneTraceShader->setUniform("mipLevel", coneTraceMipLevel);
 }
 
 void SSReflection::setSharpness(float value)
 {
 	sharpness = value;
-	coneTraceShader->apply();
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "sharpness"), sharpness);
+	coneTraceShader->setUniform("sharpness", sharpness);
 }
 
 void SSReflection::setSharpnessPower(float value)
 {
 	sharpnessPower = value;
-	coneTraceShader->apply();
-	glUniform1f(glGetUniformLocation(coneTraceShader->getShaderId(), "sharpnessPower"), sharpnessPower);
+	coneTraceShader->setUniform("sharpnessPower", sharpnessPower);
+}
+
+void SSReflection::setUseComputeMipChain(bool value)
+{
+	useComputeMipChain = value;
+}
+
+void SSReflection::setUseSummedAreaTable(bool value)
+{
+	useSummedAreaTable = value;
+	if (useSummedAreaTable && cReflectionSAT == 0) createSummedAreaTables();
+}
+
+// Larger boxes could overflow the wrapping sums of the table
+void SSReflection::setMaxBoxRadius(float value)
+{
+	maxBoxRadius = glm::clamp(value, 0.5f, 64.0f);
+	coneTraceSATShader->setUniform("maxBoxRadius", maxBoxRadius);
+}
+
+void SSReflection::setUseTemporalFilter(bool value)
+{
+	useTemporalFilter = value;
+
+	for (auto& temporalFilter : temporalFilters)
+	{
+		temporalFilter.second->reset();
+	}
+}
+
+// Restrict the reflection and cone trace passes to one tile list, nullptr draws full screen
+void SSReflection::setTileClassifier(TileClassifier* classifier, TileList list)
+{
+	tileClassifier = classifier;
+	tileList = list;
+}
+
+// Shared blue noise for the ray start jitter, nullptr falls back to a per pixel hash
+void SSReflection::setBlueNoise(BlueNoise* noise)
+{
+	blueNoise = noise;
+	ssReflectionPassShader->setUniform("useBlueNoise", blueNoise != nullptr);
+}
+
+// Times the trace, light filter and cone trace steps, nullptr disables it
+void SSReflection::setProfiler(GpuProfiler* profiler)
+{
+	this->profiler = profiler;
+}
+
+void SSReflection::setScissorRect(const glm::ivec4& rect)
+{
+	scissorRect = rect;
 }
 
 float SSReflection::getMaxSteps() const
@@ -486,4 +665,24 @@ float SSReflection::getSharpness() const
 float SSReflection::getSharpnessPower() const
 {
 	return sharpnessPower;
+}
+
+bool SSReflection::getUseComputeMipChain() const
+{
+	return useComputeMipChain;
+}
+
+bool SSReflection::getUseSummedAreaTable() const
+{
+	return useSummedAreaTable;
+}
+
+float SSReflection::getMaxBoxRadius() const
+{
+	return maxBoxRadius;
+}
+
+bool SSReflection::getUseTemporalFilter() const
+{
+	return useTemporalFilter;
 }
\ No newline at end of file
@@ -2,6 +2,29 @@
 
 #include "global.h"
 #include "Quad.h"
+#include "TileClassifier.h"
+#include "TemporalFilter.h"
+#include "BlueNoise.h"
+#include "UniformBlock.h"
+#include "GpuProfiler.h"
+#include <map>
+
+// Ray march settings of the reflection pass, std140 block at binding 14
+struct SSRParameters
+{
+	float maxSteps;
+	float binarySearchSteps;
+	float maxRayTraceDistance;
+	float nearPlaneZ;
+	float rayZThickness;
+	float stride;
+	float strideZCutoff;
+	float jitterFactor;
+	float screenEdgeFadeStart;
+	float cameraFadeStart;
+	float cameraFadeLength;
+	int frameIndex;
+};
 
 class SSReflection
 {
@@ -31,28 +54,52 @@ private:
 	float sharpnessPower = 1.0f;
 	float coneTraceMipLevel = 0;
 
+	// Glossy filtering: a summed area table box per cone footprint, or the blurred mip chain as the fallback
+	bool useSummedAreaTable = true;
+	float maxBoxRadius = 64.0f; // Pixels, the box sums stay below 2^32 up to 64
+	bool useComputeMipChain = true;
+	const int maxComputeMipLevels = 5;
+
+	// Temporal accumulation of the traced rays, the march takes fewer but longer steps per frame
+	bool useTemporalFilter = false;
+	const float temporalStrideScale = 2.0f;
+	int frameIndex = 0;
+	std::map<GLuint, TemporalFilter*> temporalFilters;
 	
 	Quad* quad;
+	TileClassifier* tileClassifier = nullptr;
+	TileList tileList = TILE_LIST_REFLECTIVE;
+	BlueNoise* blueNoise = nullptr;
+	GpuProfiler* profiler = nullptr;
+	glm::ivec4 scissorRect; // x, y, width, height of the region the per pixel passes run in
 	Shader* ssReflectionPassShader;
 	Shader* gaussianBlurShader;
+	Shader* blurMipChainShader;
 	Shader* coneTraceShader;
+	Shader* summedAreaTableShader;
+	Shader* coneTraceSATShader;
+	UniformBlock<SSRParameters>* parametersBlock;
 	GLuint fbo;
 	GLuint cReflection, cReflectionRay;
 	GLuint cLightFilterH, cLightFilterV;
-	GLuint cLightFilterH2, cLightFilterV2;
+	GLuint cReflectionRows = 0, cReflectionSAT = 0;
 	std::vector<float> gaussianKernel;
+	std::vector<glm::vec4> mipKernels;
 	int bufferWidth, bufferHeight;
 	int cFilterWidth, cFilterHeight;
 
 	float normpdf(float x, float s);
 	void computeGaussianKernel();
+	void computeMipKernels();
+	void createSummedAreaTables();
+	void updateParameters();
 
 public:
 
 	SSReflection(int width, int height);
 	~SSReflection();
 
-	void draw(GLuint texPosition, GLuint texNormal, GLuint texLight, GLuint irrEnv, GLuint prefiltEnv, GLuint outTexture, GLuint aoTexture);
+	void draw(GLuint texDepth, GLuint texNormal, GLuint texMaterial, GLuint texLight, GLuint irrEnv, GLuint prefiltEnv, GLuint outTexture, GLuint aoTexture, GLuint motionTexture = 0);
 
 	void initializeShaders();
 	void recompileShaders();
@@ -76,6 +123,14 @@ public:
 	void setConeTraceMipLevel(float value);
 	void setSharpness(float value);
 	void setSharpnessPower(float value);
+	void setUseComputeMipChain(bool value);
+	void setUseSummedAreaTable(bool value);
+	void setMaxBoxRadius(float value);
+	void setUseTemporalFilter(bool value);
+	void setTileClassifier(TileClassifier* classifier, TileList list);
+	void setBlueNoise(BlueNoise* noise);
+	void setProfiler(GpuProfiler* profiler);
+	void setScissorRect(const glm::ivec4& rect);
 
 	float getMaxSteps() const;
 	float getBinarySearchSteps() const;
@@ -96,4 +151,8 @@ public:
 	float getConeTraceMipLevel() const;
 	float getSharpness() const;
 	float getSharpnessPower() const;
+	bool getUseComputeMipChain() const;
+	bool getUseSummedAreaTable() const;
+	float getMaxBoxRadius() const;
+	bool getUseTemporalFilter() const;
 };
\ No newline at end of file
@@ -16,9 +16,19 @@ Scene::~Scene()
 	if (sensor != nullptr) delete sensor;
 	if (camera != nullptr) delete camera;
 	if (gPassShader != nullptr) delete gPassShader;
+	if (gPassPRTShader != nullptr) delete gPassPRTShader;
 	if (lightingPassShader != nullptr) delete lightingPassShader;
 	if (quad != nullptr) delete quad;
 	if (dragon != nullptr) delete dragon;
+	if (dragonInstances != nullptr) delete dragonInstances;
+	if (cullingTree != nullptr) delete cullingTree;
+	if (environmentEstimator != nullptr) delete environmentEstimator;
+	if (distanceFieldShadows != nullptr) delete distanceFieldShadows;
+	if (clusteredLights != nullptr) delete clusteredLights;
+	if (shadowMap != nullptr) delete shadowMap;
+	if (frameGraph != nullptr) delete frameGraph;
+	if (profiler != nullptr) delete profiler;
+	if (materialBlock != nullptr) delete materialBlock;
 }
 
 void Scene::recompileShaders()
@@ -26,10 +36,16 @@ void Scene::recompileShaders()
 	pbr->recompileShaders();
 	sensor->recompileShaders();
 	gPassShader->recompile();
+	gPassPRTShader->recompile();
 	gComposePassShader->recompile();
+	dsSeedShader->recompile();
 	ssao->recompileShaders();
 	lightingPassShader->recompile();
 	ssr->recompileShaders();
+	tileClassifier->recompileShaders();
+	clusteredLights->recompileShaders();
+	shadowMap->recompileShaders();
+	finalTemporalFilter->recompileShaders();
 	compositeShader->recompile();
 	outputShader->recompile();
 	pointCloud->recompileShader();
@@ -43,16 +59,29 @@ void Scene::initializeShaders()
 	glUniform1i(glGetUniformLocation(gPassShader->getShaderId(), "normal1"), 1);
 	glUniform1i(glGetUniformLocation(gPassShader->getShaderId(), "specular1"), 2);
 
+	gPassPRTShader->apply();
+	glUniform1i(glGetUniformLocation(gPassPRTShader->getShaderId(), "diffuse1"), 0);
+	glUniform1i(glGetUniformLocation(gPassPRTShader->getShaderId(), "normal1"), 1);
+	glUniform1i(glGetUniformLocation(gPassPRTShader->getShaderId(), "specular1"), 2);
+
 	gComposePassShader->apply();
-	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inPosition"), 0);
+	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inDepth"), 0);
 	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inNormal"), 1);
 	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inColor"), 2);
-	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "dsPosition"), 3);
+	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "dsDepth"), 3);
 	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "dsNormal"), 4);
 	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "dsColor"), 5);
+	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inMotion"), 6);
+	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inTransfer"), 7);
+	glUniform1i(glGetUniformLocation(gComposePassShader->getShaderId(), "inMaterial"), 8);
+
+	dsSeedShader->apply();
+	glUniform1i(glGetUniformLocation(dsSeedShader->getShaderId(), "dsPosition"), 0);
+	glUniform1i(glGetUniformLocation(dsSeedShader->getShaderId(), "dsNormal"), 1);
+	glUniform1i(glGetUniformLocation(dsSeedShader->getShaderId(), "dsColor"), 2);
 
 	lightingPassShader->apply();
-	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "gPosition"), 0);
+	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "gDepth"), 0);
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "gNormal"), 1);
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "gColor"), 2);
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "aoMap"), 3);
@@ -60,7 +89,16 @@ void Scene::initializeShaders()
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "prefilterMap"), 5);
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "brdfLUT"), 6);
 	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "reflectionMap"), 7);
-	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "reflectanceMap"), 8);
+	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "gMaterial"), 8);
+	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "prefilterOctMap"), 9);
+	glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), "transferMap"), 10);
+
+	// Distance field volumes take units 11 to 14, unused slots must not alias the 2D units
+	for (int i = 0; i < 4; i++)
+	{
+		string volume = "distanceFields[" + to_string(i) + "].volume";
+		glUniform1i(glGetUniformLocation(lightingPassShader->getShaderId(), volume.c_str()), 11 + i);
+	}
 
 	compositeShader->apply();
 	glUniform1i(glGetUniformLocation(compositeShader->getShaderId(), "fullScene"), 0);
@@ -70,7 +108,7 @@ void Scene::initializeShaders()
 	outputShader->apply();
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "displayMode"), renderMode);
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "inColor"), 0);
-	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "gPosition"), 1);
+	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "gDepth"), 1);
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "gNormal"), 2);
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "gColor"), 3);
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "aoMap"), 4);
@@ -80,15 +118,20 @@ void Scene::initializeShaders()
 	glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "aoMap2"), 8);
 }
 
-void Scene::initialize(nanogui::Screen* guiScreen)
+void Scene::initialize(nanogui::Screen* guiScreen, string sensorRecording)
 {
 	// Fix to preset resolution for now
 	bufferWidth = g_windowWidth;
 	bufferHeight = g_windowHeight;
+	influenceRect = ivec4(0, 0, bufferWidth, bufferHeight);
+
+	// Timer queries of every frame, the components below report their steps as nested scopes
+	profiler = new GpuProfiler();
 
-	// Initialize depth sensor
+	// Initialize depth sensor, a recording replaces the live device
 	sensor = new DSensor();
-	sensor->initialize(bufferWidth, bufferHeight);
+	sensor->initialize(bufferWidth, bufferHeight, sensorRecording);
+	sensor->setProfiler(profiler);
 
 	// Load framework objects
 	timerRunOnceOnStart = new Timer(2.0f, 2.0f);
@@ -98,11 +141,30 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 	camera->setPosition(vec3(0, 0, 0));
 	camera->setDirection(vec3(0, 0, -1));
 	gPassShader = new Shader("gPass");
+	gPassPRTShader = new Shader("gPassPRT");
 	lightingPassShader = new Shader("lightingPass");
 	gComposePassShader = new Shader("gComposePass");
+	dsSeedShader = new Shader("dsSeed");
 
 	ssr = new SSReflection(bufferWidth, bufferHeight);
+	tileClassifier = new TileClassifier(bufferWidth, bufferHeight);
+	clusteredLights = new ClusteredLights();
+	shadowMap = new ShadowMap();
+	materialBlock = new UniformBlock<MaterialParameters>(12);
+	finalTemporalFilter = new TemporalFilter(bufferWidth, bufferHeight);
+	finalTemporalFilter->setClampHistory(true);
 	ssao = new SSAO(bufferWidth, bufferHeight);
+	blueNoise = new BlueNoise(g_ExePath + "../../media/bluenoise64.ppm");
+	ssao->setBlueNoise(blueNoise);
+	ssr->setBlueNoise(blueNoise);
+	ssao->setProfiler(profiler);
+	ssr->setProfiler(profiler);
+
+	// Precompute PBR environment maps, created before the GUI which reads their settings
+	pbr = new PBR(bufferWidth, bufferHeight);
+	pbr->computeEnvMaps();
+	environmentEstimator = new EnvironmentEstimator(bufferWidth, bufferHeight);
+
 	quad = new Quad();
 	plane = new Object();
 	plane->setGPassShaderId(gPassShader->getShaderId());
@@ -125,17 +187,202 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 	dragon->load("dragon.obj");
 	//dragon->load("knob/mitsuba-sphere.obj");
 	//dragon->load("sibenik/sibenik.obj");
+	dragonInstances = new InstanceBuffer();
+
+	cullingTree = new AABBTree();
+	knob->setCullingTree(cullingTree, (int)cullingObjects.size());
+	cullingObjects.push_back(knob);
+
+	// Distance fields are baked once per model and cached next to it
+	distanceFieldShadows = new DistanceFieldShadows();
+	knobDistanceField = distanceFieldShadows->addField(new DistanceField(knob->getModel()));
+	dragonDistanceField = distanceFieldShadows->addField(new DistanceField(dragon->getModel()));
 	texWhite = Image::loadTexture(g_ExePath + "../../media/white.png");
-	texRed = Image::loadTexture(g_ExePath + "../../media/red.png");
-	texGreen = Image::loadTexture(g_ExePath + "../../media/green.png");
-	texBlue = Image::loadTexture(g_ExePath + "../../media/blue.png");
 
 	randomFloats = uniform_real_distribution<float>(0.0f, 1.0f);
 
 	pointCloud = new PointCloud(sensor->getColorMapId(), sensor->getDepthMapId());
 
-	// Initialize GUI
+	// Headless runs have no screen and keep the default settings
 	this->guiScreen = guiScreen;
+	isGUIVisible = guiScreen != nullptr;
+	if (guiScreen != nullptr) initializeGUI();
+
+	// Initialize CamMat uniform buffer
+	glGenBuffers(1, &uniform_CamMat);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMat);
+	glBufferData(GL_UNIFORM_BUFFER, 6 * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 9, uniform_CamMat);
+
+	// Set matrices to identity
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(mat4(1)));
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
+	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
+	glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
+	glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
+	glBufferSubData(GL_UNIFORM_BUFFER, 5 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Last frame's view matrix for motion vectors
+	glGenBuffers(1, &uniform_CamMatPrevious);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMatPrevious);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(mat4), value_ptr(mat4(1)), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 10, uniform_CamMatPrevious);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Deferred rendering buffer
+	glGenFramebuffers(1, &gBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+
+	// Attachments are transient frame graph targets, bound when the gPass executes
+	const GLenum attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+	glDrawBuffers(5, attachments);
+
+	// Create buffers for gComposeBuffer pass
+	glGenFramebuffers(1, &gComposeBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
+
+	// Positions are reconstructed from depth, normals are octahedral encoded and albedo is sRGB
+	glGenTextures(1, &gComposedDepth);
+	glBindTexture(GL_TEXTURE_2D, gComposedDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, bufferWidth, bufferHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gComposedDepth, 0);
+
+	glGenTextures(1, &gComposedNormal);
+	glBindTexture(GL_TEXTURE_2D, gComposedNormal);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, bufferWidth, bufferHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gComposedNormal, 0);
+
+	glGenTextures(1, &gComposedMaterial);
+	glBindTexture(GL_TEXTURE_2D, gComposedMaterial);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, bufferWidth, bufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gComposedMaterial, 0);
+
+	glGenTextures(1, &gComposedColor);
+	glBindTexture(GL_TEXTURE_2D, gComposedColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, bufferWidth, bufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gComposedColor, 0);
+
+	glGenTextures(1, &gComposedMotion);
+	glBindTexture(GL_TEXTURE_2D, gComposedMotion);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, bufferWidth, bufferHeight, 0, GL_RG, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, gComposedMotion, 0);
+
+	glGenTextures(1, &gComposedTransfer);
+	glBindTexture(GL_TEXTURE_2D, gComposedTransfer);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, gComposedTransfer, 0);
+
+	// Same layout as the gBuffer, the gPass can rasterize straight into the composed targets
+	glDrawBuffers(5, attachments);
+
+	// Kinect ds textures at the buffer resolution to make sure texture sampling are even
+	// Else differential rendering produces artifacts if lowres ds texture are directly used
+	glGenFramebuffers(1, &dsBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, dsBuffer);
+
+	// A depth texture, so it can seed the composed depth buffer
+	glGenTextures(1, &dsDepth);
+	glBindTexture(GL_TEXTURE_2D, dsDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, bufferWidth, bufferHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, dsDepth, 0);
+
+	glGenTextures(1, &dsNormal);
+	glBindTexture(GL_TEXTURE_2D, dsNormal);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, bufferWidth, bufferHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dsNormal, 0);
+
+	// Stays floating point, the sensor color is the light source of estimation and reflections
+	glGenTextures(1, &dsColor);
+	glBindTexture(GL_TEXTURE_2D, dsColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, dsColor, 0);
+
+	glDrawBuffers(2, attachments);
+
+	// The real surfaces share one material, no draw buffer is left for it so it is cleared in update
+	glGenTextures(1, &dsMaterial);
+	glBindTexture(GL_TEXTURE_2D, dsMaterial);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, bufferWidth, bufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Capture final outputs for differential rendering
+	compositeShader = new Shader("composite");
+	outputShader = new Shader("output");
+
+	glGenFramebuffers(1, &captureFBO);
+
+	// The other capture targets are transient, the final image persists for next frame's reflections
+	glGenTextures(1, &cFinalScene);
+	glBindTexture(GL_TEXTURE_2D, cFinalScene);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	frameGraph = new FrameGraph();
+	frameGraph->setProfiler(profiler);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Init shader uniforms
+	initializeShaders();
+
+	glCullFace(GL_BACK);
+	glEnable(GL_DEPTH_TEST);
+	//glDepthFunc(GL_LEQUAL);
+	//glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
+	//glEnable(GL_BLEND);
+	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//sensor->launchUpdateThread();
+
+	initSuccess = true;
+	if (fixedFrameTime <= 0.0f) previousTime = glfwGetTime();
+}
+
+void Scene::initializeGUI()
+{
 	gui = new nanogui::FormHelper(guiScreen);
 	nanoguiWindow = gui->addWindow(Eigen::Vector2i(10, 10), "ARFW");
 
@@ -152,10 +399,19 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 	});
 
 	gui->addVariable("dragonNumRadius", dragonNumRadius);
+	gui->addVariable("useFrustumCulling", useFrustumCulling);
+	gui->addVariable("useDepthPreseed", useDepthPreseed);
+	gui->addVariable("useInfluenceRegion", useInfluenceRegion);
+	gui->addVariable("influenceMargin", influenceMargin);
 	gui->addButton("Spawn Dragons", [&]()
 	{
 		spawnDragons(dragonNumRadius);
 	});
+	gui->addVariable("virtualLightCount", virtualLightCount);
+	gui->addButton("Spawn Lights", [&]()
+	{
+		spawnLights(virtualLightCount);
+	});
 	gui->addButton("Recompute envmap", [&]()
 	{
 		pbr->recomputeBothSums(dsColor);
@@ -163,11 +419,58 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 
 	gui->addGroup("Light/Material");
 	gui->addVariable("Color", lightColor);
+	gui->addVariable("direct light", useDirectLight);
+	gui->addVariable("Intensity", lightIntensity)->setSpinnable(true);
+	gui->addVariable<bool>("shadow map",
+		[&](const bool &value) { shadowMap->setEnabled(value); },
+		[&]() { return shadowMap->getEnabled(); });
+	gui->addVariable<float>("shadow bias",
+		[&](const float &value) { shadowMap->setDepthBias(value); },
+		[&]() { return shadowMap->getDepthBias(); });
 	gui->addVariable("Roughness (kinect)", bgRoughness)->setSpinnable(true);
 	gui->addVariable("Metallic (kinect)", bgMetallic)->setSpinnable(true);
 	gui->addVariable("Roughness", roughness)->setSpinnable(true);
 	gui->addVariable("Metallic", metallic)->setSpinnable(true);
 
+	gui->addGroup("Environment lighting");
+	gui->addVariable<bool>("SH irradiance",
+		[&](const bool &value) { setUseSHIrradiance(value); },
+		[&]() { return getUseSHIrradiance(); });
+	gui->addVariable("live irradiance (SH)", liveIrradiance);
+	gui->addVariable("baked transfer (PRT)", usePRT);
+	gui->addVariable<bool>("progressive refresh",
+		[&](const bool &value) { pbr->setUseProgressiveUpdate(value); },
+		[&]() { return pbr->getUseProgressiveUpdate(); });
+	gui->addVariable<bool>("octahedral prefilter (RGB9E5)",
+		[&](const bool &value) { pbr->setUseOctahedralPrefilter(value); },
+		[&]() { return pbr->getUseOctahedralPrefilter(); });
+	gui->addVariable<bool>("continuous estimation",
+		[&](const bool &value) { setUseEnvironmentEstimation(value); },
+		[&]() { return getUseEnvironmentEstimation(); });
+	gui->addVariable<int>("estimation interval",
+		[&](const int &value) { environmentEstimator->setFrameInterval(value); },
+		[&]() { return environmentEstimator->getFrameInterval(); });
+	gui->addVariable<float>("estimation blend",
+		[&](const float &value) { environmentEstimator->setBlendFactor(value); },
+		[&]() { return environmentEstimator->getBlendFactor(); });
+
+	gui->addGroup("Distance field shadows");
+	gui->addVariable<bool>("enabled (SDF)",
+		[&](const bool &value) { distanceFieldShadows->setEnabled(value); },
+		[&]() { return distanceFieldShadows->getEnabled(); });
+	gui->addVariable<float>("shadow strength (SDF)",
+		[&](const float &value) { distanceFieldShadows->setShadowStrength(value); },
+		[&]() { return distanceFieldShadows->getShadowStrength(); });
+	gui->addVariable<float>("shadow softness (SDF)",
+		[&](const float &value) { distanceFieldShadows->setShadowSoftness(value); },
+		[&]() { return distanceFieldShadows->getShadowSoftness(); });
+	gui->addVariable<float>("occlusion strength (SDF)",
+		[&](const float &value) { distanceFieldShadows->setOcclusionStrength(value); },
+		[&]() { return distanceFieldShadows->getOcclusionStrength(); });
+	gui->addVariable<float>("influence radius (SDF)",
+		[&](const float &value) { distanceFieldShadows->setInfluenceRadius(value); },
+		[&]() { return distanceFieldShadows->getInfluenceRadius(); });
+
 	gui->addGroup("Kinect depth filters");
 	gui->addGroup("Temporal median filter");
 	gui->addVariable<int>("kernelRadius",
@@ -275,6 +578,15 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 	gui->addVariable<float>("mipBasePower",
 		[&](const float &value) { ssr->setMipBasePower(value); },
 		[&]() { return ssr->getMipBasePower(); });
+	gui->addVariable<bool>("computeMipChain",
+		[&](const bool &value) { ssr->setUseComputeMipChain(value); },
+		[&]() { return ssr->getUseComputeMipChain(); });
+	gui->addVariable<bool>("summedAreaTable",
+		[&](const bool &value) { ssr->setUseSummedAreaTable(value); },
+		[&]() { return ssr->getUseSummedAreaTable(); });
+	gui->addVariable<float>("maxBoxRadius",
+		[&](const float &value) { ssr->setMaxBoxRadius(value); },
+		[&]() { return ssr->getMaxBoxRadius(); });
 	gui->addVariable<float>("bsigma",
 		[&](const float &value) { ssr->setGaussianBSigma(value); },
 		[&]() { return ssr->getGaussianBSigma(); });
@@ -290,6 +602,34 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 		[&](const float &value) { ssr->setConeTraceMipLevel(value); },
 		[&]() { return ssr->getConeTraceMipLevel(); });
 
+	gui->addGroup("Tile classification");
+	gui->addVariable<bool>("useTiles",
+		[&](const bool &value) { setUseTileClassification(value); },
+		[&]() { return getUseTileClassification(); });
+	gui->addVariable<float>("roughnessThreshold",
+		[&](const float &value) { tileClassifier->setRoughnessThreshold(value); },
+		[&]() { return tileClassifier->getRoughnessThreshold(); });
+	gui->addVariable<int>("tileDilation",
+		[&](const int &value) { tileClassifier->setDilationRadius(value); },
+		[&]() { return tileClassifier->getDilationRadius(); });
+
+	gui->addGroup("Temporal accumulation");
+	gui->addVariable<bool>("temporalAO",
+		[&](const bool &value) { ssao->setUseTemporalFilter(value); },
+		[&]() { return ssao->getUseTemporalFilter(); });
+	gui->addVariable<int>("aoSampleDivisor",
+		[&](const int &value) { ssao->setTemporalSampleDivisor(value); },
+		[&]() { return ssao->getTemporalSampleDivisor(); });
+	gui->addVariable<bool>("temporalSSR",
+		[&](const bool &value) { ssr->setUseTemporalFilter(value); },
+		[&]() { return ssr->getUseTemporalFilter(); });
+	gui->addVariable<bool>("temporalResolve",
+		[&](const bool &value) { setUseTemporalResolve(value); },
+		[&]() { return getUseTemporalResolve(); });
+	gui->addVariable<float>("resolveBlendFactor",
+		[&](const float &value) { finalTemporalFilter->setBlendFactor(value); },
+		[&]() { return finalTemporalFilter->getBlendFactor(); });
+
 	gui->addGroup("Tonemapping");
 	gui->addVariable<float>("exposure",
 		[&](const float &value) { setExposure(value); },
@@ -298,483 +638,804 @@ void Scene::initialize(nanogui::Screen* guiScreen)
 	gui->addGroup("Objects");
 	gui->addVariable("objectScale", dragonScale);
 	gui->addVariable("objectToGroundFactor", drasonHeightFactor);
+
+	gui->addGroup("Profiler");
+	gui->addVariable<bool>("GPU profiler",
+		[&](const bool &value) { profiler->setEnabled(value); },
+		[&]() { return profiler->getEnabled(); });
+	gui->addVariable<int>("profilerDepth",
+		[&](const int &value) { profiler->setOverlayDepth(value); },
+		[&]() { return profiler->getOverlayDepth(); });
+
+	profiler->initializeOverlay(guiScreen);
 	
 	guiScreen->setVisible(true);
 	guiScreen->performLayout();
+}
 
-	// Initialize CamMat uniform buffer
-	glGenBuffers(1, &uniform_CamMat);
-	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMat);
-	glBufferData(GL_UNIFORM_BUFFER, 6 * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 9, uniform_CamMat);
-
-	// Set matrices to identity
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(mat4(1)));
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
-	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
-	glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
-	glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
-	glBufferSubData(GL_UNIFORM_BUFFER, 5 * sizeof(mat4), sizeof(mat4), value_ptr(mat4(1)));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	// Precompute PBR environment maps
-	pbr = new PBR(bufferWidth, bufferHeight);
-	pbr->computeEnvMaps();
+void Scene::update()
+{
+	if (!initSuccess) return;
 
-	// Deferred rendering buffer
-	glGenFramebuffers(1, &gBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+	// Calculate per frame time interval, headless runs step a fixed one so a recording always renders the same frames
+	float frameTime = fixedFrameTime;
 
-	// Alpha - roughness
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
+	if (fixedFrameTime <= 0.0f)
+	{
+		currentTime = glfwGetTime();
+		frameTime = (float)(currentTime - previousTime);
+		previousTime = currentTime;
+	}
 
-	// Alpha - Metallic
-	glGenTextures(1, &gNormal);
-	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+	// The frame's timer queries start with the sensor update and end after the GUI
+	profiler->beginFrame();
 
-	glGenTextures(1, &gColor);
-	glBindTexture(GL_TEXTURE_2D, gColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gColor, 0);
+	Timer::updateTimers(frameTime);
+	blueNoise->nextFrame();
 
-	glGenTextures(1, &gDepth);
-	glBindTexture(GL_TEXTURE_2D, gDepth);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, bufferWidth, bufferHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+	// The gPass and gCompose materials only cost a buffer write when the GUI changed them
+	MaterialParameters material = { roughness, metallic, bgRoughness, bgMetallic };
 
-	const GLenum attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, attachments);
+	if (materialBlock->set(material))
+	{
+		const float bgMaterial[4] = { bgRoughness, bgMetallic, 0.0f, 0.0f };
+		glClearTexImage(dsMaterial, 0, GL_RGBA, GL_FLOAT, bgMaterial);
+	}
 
-	// Create buffers for gComposeBuffer pass
-	glGenFramebuffers(1, &gComposeBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
+	materialBlock->bind();
 
-	glGenTextures(1, &gComposedPosition);
-	glBindTexture(GL_TEXTURE_2D, gComposedPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gComposedPosition, 0);
+	lightingPassShader->setUniform("cameraPosition", camera->getPosition());
+	lightingPassShader->setUniform("lightPosition", lightPosition);
+	lightingPassShader->setUniform("lightColor", vec3(lightColor.r(), lightColor.g(), lightColor.b()));
+	lightingPassShader->setUniform("lightIntensity", lightIntensity);
+	lightingPassShader->setUniform("useDirectLight", useDirectLight ? 1 : 0);
 
-	glGenTextures(1, &gComposedNormal);
-	glBindTexture(GL_TEXTURE_2D, gComposedNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gComposedNormal, 0);
+	compositeShader->setUniform("exposure", exposure);
 
-	glGenTextures(1, &gComposedColor);
-	glBindTexture(GL_TEXTURE_2D, gComposedColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gComposedColor, 0);
+	camera->update(frameTime);
 
-	// Output kinect ds textures again to make sure texture sampling are even
-	// Else differential rendering produces artifacts if lowres ds texture are directly used
-	glGenTextures(1, &dsPosition);
-	glBindTexture(GL_TEXTURE_2D, dsPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, dsPosition, 0);
+	// Update for potential color or depth frame from kinect
+	GpuProfileScope sensorScope(profiler, "sensor");
+	sensor->update();
+	sensor->update();
+	sensorScope.end();
 
-	glGenTextures(1, &dsNormal);
-	glBindTexture(GL_TEXTURE_2D, dsNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, dsNormal, 0);
+	// Update CamMat uniform buffer
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMat);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(camera->getMatProjection()));
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatProjectionInverse()));
+	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatView()));
+	glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatViewInverse()));
+	glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof(mat4), sizeof(mat4), value_ptr(sensor->getMatProjection()));
+	glBufferSubData(GL_UNIFORM_BUFFER, 5 * sizeof(mat4), sizeof(mat4), value_ptr(sensor->getMatProjectionInverse()));
 
-	glGenTextures(1, &dsColor);
-	glBindTexture(GL_TEXTURE_2D, dsColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, GL_TEXTURE_2D, dsColor, 0);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMatPrevious);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(matViewPrevious));
+	matViewPrevious = camera->getMatView();
 
-	const GLenum gComposeAttachments[6] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2,
-		GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5 };
-	glDrawBuffers(6, gComposeAttachments);
+	GpuProfileScope environmentScope(profiler, "environment");
 
-	// Capture final outputs for differential rendering
-	compositeShader = new Shader("composite");
-	outputShader = new Shader("output");
+	if (timerRunOnceOnStart->ticked())
+	{
+		spawnDragons(1);
+		pbr->recomputeBothSums(dsColor);
+	}
 
-	glGenFramebuffers(1, &captureFBO);
+	// Advance a pending environment refresh by one slice
+	pbr->updateProgressive();
+}
 
-	glGenTextures(1, &cLightingFull);
-	glBindTexture(GL_TEXTURE_2D, cLightingFull);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+void Scene::render(GLFWwindow* window)
+{
+	if (!initSuccess) return;
+	if (pauseRender) return;
 
-	glGenTextures(1, &cLightingBack);
-	glBindTexture(GL_TEXTURE_2D, cLightingBack);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Initial GL states
+	glCullFace(GL_BACK);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
 
-	glGenTextures(1, &cFullScene);
-	glBindTexture(GL_TEXTURE_2D, cFullScene);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Passes are declared every frame, the display mode decides which of them run
+	GpuProfileScope renderScope(profiler, "render");
+	frameGraph->reset();
+	buildFrameGraph();
+	frameGraph->compile();
+	frameGraph->execute();
+	renderScope.end();
 
-	glGenTextures(1, &cBackScene);
-	glBindTexture(GL_TEXTURE_2D, cBackScene);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Draw GUI
+	if (isGUIVisible && guiScreen != nullptr)
+	{
+		GpuProfileScope guiScope(profiler, "gui");
+		guiScreen->drawWidgets();
+		glEnable(GL_DEPTH_TEST); // Reset changed states
+		glDisable(GL_BLEND);
+	}
 
-	glGenTextures(1, &cFinalScene);
-	glBindTexture(GL_TEXTURE_2D, cFinalScene);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	profiler->endFrame(isGUIVisible);
 
+	if (window != nullptr) glfwSwapBuffers(window);
 
-	glGenTextures(1, &cAmbientOcclusion);
-	glBindTexture(GL_TEXTURE_2D, cAmbientOcclusion);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	//pauseRender = true;
+}
 
-	glGenTextures(1, &cAmbientOcclusionBg);
-	glBindTexture(GL_TEXTURE_2D, cAmbientOcclusionBg);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+// Writes what the output pass shows in the default display mode, the composite or its temporal resolve
+bool Scene::saveFinalImage(string filepath) const
+{
+	if (finalOutput == 0) return false;
 
+	return Image::saveTexturePPM(finalOutput, bufferWidth, bufferHeight, filepath);
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// Declares the passes of one frame. Transient targets only live between their first and last use and
+// share pooled textures, the gCompose outputs, sensor copies and history buffers are imported.
+void Scene::buildFrameGraph()
+{
+	FrameGraphTextureDesc colorDesc = { GL_RGBA16F, GL_RGBA, GL_FLOAT, bufferWidth, bufferHeight };
+	FrameGraphTextureDesc motionDesc = { GL_RG16F, GL_RG, GL_FLOAT, bufferWidth, bufferHeight };
+	FrameGraphTextureDesc depthDesc = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, bufferWidth, bufferHeight };
+	FrameGraphTextureDesc normalDesc = { GL_RG16, GL_RG, GL_UNSIGNED_SHORT, bufferWidth, bufferHeight };
+	FrameGraphTextureDesc materialDesc = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, bufferWidth, bufferHeight };
+	FrameGraphTextureDesc albedoDesc = { GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, bufferWidth, bufferHeight };
+
+	// Octahedral normal, roughness - metallic, sRGB color, depth, motion and baked transfer of the virtual objects
+	int gNormal = frameGraph->createTexture("gNormal", normalDesc);
+	int gMaterial = frameGraph->createTexture("gMaterial", materialDesc);
+	int gColor = frameGraph->createTexture("gColor", albedoDesc);
+	int gDepth = frameGraph->createTexture("gDepth", depthDesc);
+	int gMotion = frameGraph->createTexture("gMotion", motionDesc);
+	int gTransfer = frameGraph->createTexture("gTransfer", colorDesc);
+
+	int composedDepth = frameGraph->importTexture("gComposedDepth", gComposedDepth);
+	int composedNormal = frameGraph->importTexture("gComposedNormal", gComposedNormal);
+	int composedMaterial = frameGraph->importTexture("gComposedMaterial", gComposedMaterial);
+	int composedColor = frameGraph->importTexture("gComposedColor", gComposedColor);
+	int composedMotion = frameGraph->importTexture("gComposedMotion", gComposedMotion);
+	int composedTransfer = frameGraph->importTexture("gComposedTransfer", gComposedTransfer);
+	int sensorDepthBuffer = frameGraph->importTexture("dsDepth", dsDepth);
+	int sensorNormal = frameGraph->importTexture("dsNormal", dsNormal);
+	int sensorMaterial = frameGraph->importTexture("dsMaterial", dsMaterial);
+	int sensorColor = frameGraph->importTexture("dsColor", dsColor);
+	int finalScene = frameGraph->importTexture("cFinalScene", cFinalScene);
+	int sensorDepth = frameGraph->importTexture("sensorDepth", sensor->getDepthMapId());
+	int ambientOcclusion = frameGraph->importTexture("ssaoCombined", ssao->getTextureLayer(0));
+	int ambientOcclusionBack = frameGraph->importTexture("ssaoBackground", ssao->getTextureLayer(2));
+
+	int lightingBack = frameGraph->createTexture("cLightingBack", colorDesc);
+	int lightingFull = frameGraph->createTexture("cLightingFull", colorDesc);
+	int reflectionAOBack = frameGraph->createTexture("cAmbientOcclusionBg", colorDesc);
+	int reflectionAO = frameGraph->createTexture("cAmbientOcclusion", colorDesc);
+	int backScene = frameGraph->createTexture("cBackScene", colorDesc);
+	int fullScene = frameGraph->createTexture("cFullScene", colorDesc);
+
+	int tileLists = frameGraph->createToken("tileLists");
+	int lightClusters = frameGraph->createToken("lightClusters");
+	int casterList = frameGraph->createToken("shadowCasters");
+	int shadowDepth = frameGraph->createToken("shadowMap");
+	int resolvedScene = frameGraph->createToken("resolvedScene");
+
+	// Passes that read the tile lists only do so while tiles are in use
+	vector<int> tileReads;
+	if (useTileClassification) tileReads.push_back(tileLists);
+
+	// Resample the filtered sensor maps to the buffer resolution, only after the sensor delivered a new frame
+	frameGraph->addPass("sensorSeed", {}, { sensorDepthBuffer, sensorNormal, sensorColor }, [=]()
+	{
+		if (sensor->getFrameRevision() == seededSensorRevision) return;
+		seededSensorRevision = sensor->getFrameRevision();
 
-	// Init shader uniforms
-	initializeShaders();
+		glBindFramebuffer(GL_FRAMEBUFFER, dsBuffer);
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glCullFace(GL_BACK);
-	glEnable(GL_DEPTH_TEST);
-	//glDepthFunc(GL_LEQUAL);
-	//glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
-	//glEnable(GL_BLEND);
-	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthFunc(GL_ALWAYS);
 
-	//sensor->launchUpdateThread();
+		dsSeedShader->apply();
 
-	initSuccess = true;
-	previousTime = glfwGetTime();
-}
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, sensor->getPositionMapId());
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, sensor->getNormalMapId());
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, sensor->getColorMapId());
 
-void Scene::update()
-{
-	if (!initSuccess) return;
+		quad->draw();
 
-	// Calculate per frame time interval
-	currentTime = glfwGetTime();
-	float frameTime = (float)(currentTime - previousTime);
-	previousTime = currentTime;
+		glDepthFunc(GL_LESS);
+	});
 
-	Timer::updateTimers(frameTime);
+	// With the depth preseed the virtual objects go straight into the composed targets, else into their own gBuffer
+	vector<int> gPassReads;
+	vector<int> gPassWrites;
 
-	gPassShader->apply();
-	glUniform1f(glGetUniformLocation(gPassShader->getShaderId(), "metallic"), metallic);
-	glUniform1f(glGetUniformLocation(gPassShader->getShaderId(), "roughness"), roughness);
+	if (useDepthPreseed)
+	{
+		gPassReads = { sensorDepthBuffer, sensorNormal, sensorColor };
+		gPassWrites = { composedDepth, composedNormal, composedMaterial, composedColor, composedMotion, composedTransfer, casterList };
+	}
+	else
+	{
+		gPassWrites = { gNormal, gMaterial, gColor, gDepth, gMotion, gTransfer, casterList };
+	}
 
-	gComposePassShader->apply();
-	glUniform1f(glGetUniformLocation(gComposePassShader->getShaderId(), "bgRoughness"), bgRoughness);
-	glUniform1f(glGetUniformLocation(gComposePassShader->getShaderId(), "bgMetallic"), bgMetallic);
+	frameGraph->addPass("gPass", gPassReads, gPassWrites, [=]()
+	{
+		const GLenum attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
 
-	lightingPassShader->apply();
-	glUniform3fv(glGetUniformLocation(lightingPassShader->getShaderId(), "cameraPosition"), 1, value_ptr(camera->getPosition()));
-	glUniform3fv(glGetUniformLocation(lightingPassShader->getShaderId(), "lightPosition"), 1, value_ptr(lightPosition));
-	glUniform3fv(glGetUniformLocation(lightingPassShader->getShaderId(), "lightColor"), 1, value_ptr(vec3(lightColor.r(), lightColor.g(), lightColor.b())));
+		if (useDepthPreseed)
+		{
+			// Start from the real surfaces, the depth test then merges the virtual objects in
+			glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+
+			glCopyImageSubData(dsDepth, GL_TEXTURE_2D, 0, 0, 0, 0, gComposedDepth, GL_TEXTURE_2D, 0, 0, 0, 0, bufferWidth, bufferHeight, 1);
+			glCopyImageSubData(dsNormal, GL_TEXTURE_2D, 0, 0, 0, 0, gComposedNormal, GL_TEXTURE_2D, 0, 0, 0, 0, bufferWidth, bufferHeight, 1);
+
+			// The linear sensor color is encoded to the sRGB target by a blit to that attachment only
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, dsBuffer);
+			glReadBuffer(GL_COLOR_ATTACHMENT1);
+			glDrawBuffer(GL_COLOR_ATTACHMENT2);
+			glEnable(GL_FRAMEBUFFER_SRGB);
+			glBlitFramebuffer(0, 0, bufferWidth, bufferHeight, 0, 0, bufferWidth, bufferHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glDisable(GL_FRAMEBUFFER_SRGB);
+			glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
+			glDrawBuffers(5, attachments);
+
+			// Real surfaces share the background material, have no baked transfer and stay fixed on screen
+			const float bgMaterial[4] = { bgRoughness, bgMetallic, 0.0f, 0.0f };
+			const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			glClearBufferfv(GL_COLOR, 1, bgMaterial);
+			glClearBufferfv(GL_COLOR, 3, zero);
+			glClearBufferfv(GL_COLOR, 4, zero);
+		}
+		else
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameGraph->getTexture(gNormal), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, frameGraph->getTexture(gMaterial), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, frameGraph->getTexture(gColor), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, frameGraph->getTexture(gMotion), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, frameGraph->getTexture(gTransfer), 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, frameGraph->getTexture(gDepth), 0);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
 
-	compositeShader->apply();
-	glUniform1f(glGetUniformLocation(compositeShader->getShaderId(), "exposure"), exposure);
+		//pointCloud->draw();
 
-	camera->update(frameTime);
+		//plane->draw();
 
-	// Update for potential color or depth frame from kinect
-	sensor->update();
-	sensor->update();
+		distanceFieldShadows->clearInstances();
+		shadowMap->clearCasters();
 
-	// Update CamMat uniform buffer
-	glBindBuffer(GL_UNIFORM_BUFFER, uniform_CamMat);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(camera->getMatProjection()));
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatProjectionInverse()));
-	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatView()));
-	glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), sizeof(mat4), value_ptr(camera->getMatViewInverse()));
-	glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof(mat4), sizeof(mat4), value_ptr(sensor->getMatProjection()));
-	glBufferSubData(GL_UNIFORM_BUFFER, 5 * sizeof(mat4), sizeof(mat4), value_ptr(sensor->getMatProjectionInverse()));
+		bool drawDragons = customPositions != nullptr && dragonNumRadius != 0;
 
-	if (timerRunOnceOnStart->ticked())
+		if (drawDragons && (!dragonsPlaced || dragonScale != placedDragonScale || drasonHeightFactor != placedDragonHeightFactor))
+		{
+			placeDragons();
+		}
+
+		cullScene();
+		computeInfluenceRegion(drawDragons);
+
+		for (Object* object : visibleObjects)
+		{
+			applyGPassShader(object);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, texWhite);
+			object->drawMeshOnly();
+		}
+
+		// Casters outside the view still shadow the visible surfaces
+		knob->commitPreviousModelMatrix();
+		distanceFieldShadows->addInstance(knobDistanceField, knob->getModelMatrix());
+		shadowMap->addCaster(knob);
+
+		// Draw dragon fest, one instanced draw per mesh for all visible ones
+		if (drawDragons)
+		{
+			if (dragonInstances->getVisibleCount() > 0)
+			{
+				Shader* shader = applyGPassShader(dragon);
+				shader->setUniform("useInstances", 1);
+				dragonInstances->bind(8);
+
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, texWhite);
+				dragon->getModel()->drawInstanced(dragonInstances->getVisibleCount());
+
+				shader->setUniform("useInstances", 0);
+			}
+
+			for (const InstanceData& instance : dragonInstances->getInstances())
+			{
+				distanceFieldShadows->addInstance(dragonDistanceField, instance.model);
+				shadowMap->addCaster(dragon->getModel(), instance.model, dragonInstances->getRevision());
+			}
+		}
+	});
+
+	// Only redrawn when a caster moved or the light changed
+	frameGraph->addPass("shadowMap", { casterList }, { shadowDepth }, [=]()
 	{
-		spawnDragons(1);
-		pbr->recomputeBothSums(dsColor);
+		if (useDirectLight) shadowMap->update(lightPosition);
+	});
+
+	// Combine GBuffer and kinect buffers
+	if (!useDepthPreseed)
+	{
+		frameGraph->addPass("gCompose", { gDepth, gNormal, gMaterial, gColor, gMotion, gTransfer, sensorDepthBuffer, sensorNormal, sensorColor },
+			{ composedDepth, composedNormal, composedMaterial, composedColor, composedMotion, composedTransfer }, [=]()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			// Every pixel writes its depth, the composed color is encoded to sRGB on write
+			glDepthFunc(GL_ALWAYS);
+			glEnable(GL_FRAMEBUFFER_SRGB);
+
+			gComposePassShader->apply();
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gDepth));
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gNormal));
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gColor));
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, dsDepth);
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_2D, dsNormal);
+			glActiveTexture(GL_TEXTURE5);
+			glBindTexture(GL_TEXTURE_2D, dsColor);
+			glActiveTexture(GL_TEXTURE6);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gMotion));
+			glActiveTexture(GL_TEXTURE7);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gTransfer));
+			glActiveTexture(GL_TEXTURE8);
+			glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(gMaterial));
+
+			quad->draw();
+
+			glDisable(GL_FRAMEBUFFER_SRGB);
+			glDepthFunc(GL_LESS);
+		});
 	}
-}
 
-void Scene::render(GLFWwindow* window)
-{
-	if (!initSuccess) return;
-	if (pauseRender) return;
+	// Environment tracking feeds the PBR maps of later frames, so it runs in every display mode
+	frameGraph->addPass("environment", { sensorColor }, {}, [=]()
+	{
+		// Track the room lighting in the background, finished estimates go through the progressive refresh
+		if (useEnvironmentEstimation && environmentEstimator->update(dsColor))
+		{
+			pbr->setEnvironmentEstimate(environmentEstimator->getEstimateMapId(), environmentEstimator->getSHCoefficients());
+		}
 
-	// Initial GL states
-	glCullFace(GL_BACK);
-	glEnable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
+		// Diffuse environment from the current sensor frame, only affordable with spherical harmonics
+		if (liveIrradiance && pbr->getUseSHIrradiance())
+		{
+			pbr->computeSHIrradiance(dsColor);
+		}
+	}, true);
 
-	// GBuffer pass
-	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// Sort screen tiles by content so later passes can skip irrelevant ones
+	if (useTileClassification)
+	{
+		frameGraph->addPass("tileClassify", { composedMaterial, composedColor }, { tileLists }, [=]()
+		{
+			tileClassifier->classify(gComposedMaterial, gComposedColor);
+		});
+	}
 
-	//pointCloud->draw();
-	
-	gPassShader->apply();
+	// Bin the virtual lights into view space clusters for the lighting pass
+	frameGraph->addPass("lightClusters", {}, { lightClusters }, [=]()
+	{
+		clusteredLights->assign();
+	});
 
-	//plane->draw();
+	// Compute ssao for GBuffer and kinect inputs
+	frameGraph->addPass("ssao", { composedDepth, composedNormal, composedColor, composedMotion, sensorDepthBuffer, sensorNormal, sensorColor },
+		{ ambientOcclusion, ambientOcclusionBack }, [=]()
+	{
+		ssao->drawLayer(1, gComposedDepth, gComposedNormal, gComposedColor, gComposedMotion);
+		ssao->drawLayer(2, dsDepth, dsNormal, dsColor);
+		ssao->drawCombined(gComposedColor);
+	});
+
+	// Screen space reflection pass
+	frameGraph->addPass("reflectionBack", { sensorDepthBuffer, sensorNormal, sensorMaterial, sensorColor }, { lightingBack, reflectionAOBack }, [=]()
+	{
+		// The real scene has a single material, so the roughness of the composed tiles does not apply.
+		// Only edge tiles are lit in the back scene, a rough background skips tracing entirely
+		bool roughBackground = useTileClassification && bgRoughness >= tileClassifier->getRoughnessThreshold();
+		ssr->setTileClassifier(useTileClassification ? tileClassifier : nullptr, TILE_LIST_EDGE);
+		ssr->setScissorRect(roughBackground ? ivec4(0) : influenceRect);
+		ssr->draw(dsDepth, dsNormal, dsMaterial, dsColor, pbr->getIrradianceMapId(), pbr->getPrefilterMapId(), frameGraph->getTexture(lightingBack), frameGraph->getTexture(reflectionAOBack));
+		ssr->setTileClassifier(useTileClassification ? tileClassifier : nullptr, TILE_LIST_REFLECTIVE);
+	});
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texWhite);
-	knob->drawMeshOnly();
+	// Differential rendering: Background (real) scene pass
+	vector<int> lightingBackReads = { sensorDepthBuffer, sensorNormal, sensorMaterial, sensorColor, ambientOcclusionBack, lightingBack };
+	lightingBackReads.insert(lightingBackReads.end(), tileReads.begin(), tileReads.end());
 
-	// Draw dragon fest
-	if (customPositions != nullptr && dragonNumRadius != 0)
+	frameGraph->addPass("lightingBack", lightingBackReads, { backScene }, [=]()
 	{
-		for (int i = 0; i < customPositions->size(); i++)
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameGraph->getTexture(backScene), 0);
+
+		// Lighting pass
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		lightingPassShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, dsDepth);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, dsNormal);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, dsColor);
+		glActiveTexture(GL_TEXTURE8);
+		glBindTexture(GL_TEXTURE_2D, dsMaterial);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(2));
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getIrradianceMapId());
+		pbr->bindPrefilter(lightingPassShader->getShaderId(), 5, 9);
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, pbr->getBrdfLUTId());
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(lightingBack));
+		lightingPassShader->setUniform("useTransferMap", 0);
+		lightingPassShader->setUniform("distanceFieldInstanceCount", 0);
+		lightingPassShader->setUniform("useClusteredLights", 0);
+		lightingPassShader->setUniform("useShadowMap", 0);
+
+		// The back scene is only needed where the composite divides by it, real pixels near virtual objects
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(influenceRect.x, influenceRect.y, influenceRect.z, influenceRect.w);
+
+		if (useTileClassification)
+		{
+			tileClassifier->drawTiles(lightingPassShader->getShaderId(), TILE_LIST_EDGE);
+		}
+		else
 		{
-			if (customPositions->at(i) == glm::vec3(0)) continue;
+			quad->draw();
+		}
 
-			// Give each dragon a different material
-			int w = dragonNumRadius * 2 + 1;
-			float x = (float)i / (w - 1);
-			float y = (float)(i % (w - 1)) / w;
+		glDisable(GL_SCISSOR_TEST);
+	});
 
-			float mRoughness = x;
-			float mMetallic = y;
+	// Screen space reflection pass, traces last frame's final image
+	vector<int> reflectionFullReads = { composedDepth, composedNormal, composedMaterial, composedMotion, finalScene };
+	reflectionFullReads.insert(reflectionFullReads.end(), tileReads.begin(), tileReads.end());
 
-			//glUniform1f(glGetUniformLocation(gPassShader->getShaderId(), "metallic"), mMetallic);
-			//glUniform1f(glGetUniformLocation(gPassShader->getShaderId(), "roughness"), mRoughness);
+	frameGraph->addPass("reflectionFull", reflectionFullReads, { lightingFull, reflectionAO }, [=]()
+	{
+		ssr->setScissorRect(influenceRect);
+		ssr->draw(gComposedDepth, gComposedNormal, gComposedMaterial, cFinalScene, pbr->getIrradianceMapId(), pbr->getPrefilterMapId(), frameGraph->getTexture(lightingFull), frameGraph->getTexture(reflectionAO), gComposedMotion);
+	});
 
-			glActiveTexture(GL_TEXTURE0);
-			if (i % 4 == 0) glBindTexture(GL_TEXTURE_2D, texWhite);
-			else if (i % 4 == 1) glBindTexture(GL_TEXTURE_2D, texRed);
-			else if (i % 4 == 2) glBindTexture(GL_TEXTURE_2D, texGreen);
-			else if (i % 4 == 3) glBindTexture(GL_TEXTURE_2D, texBlue);
-
-			dragon->setScale(vec3(dragonScale) * -customPositions->at(i).z);
-			float halfHeight = (dragon->getBoundingBox().Height / 2) * drasonHeightFactor;
-			dragon->setPosition(customPositions->at(i) + customNormals->at(i) * halfHeight);
-			dragon->setRotationByAxisAngle(customNormals->at(i), customRandoms.at(i) * 360.0f);
-			//dragon->setRotationByAxisAngle(customNormals->at(i), 0.0f);
-			dragon->drawMeshOnly();
+	// Differential rendering: Rendered (virtual) scene pass
+	vector<int> lightingFullReads = { composedDepth, composedNormal, composedMaterial, composedColor, composedTransfer, ambientOcclusion, lightingFull, lightClusters, shadowDepth };
+	lightingFullReads.insert(lightingFullReads.end(), tileReads.begin(), tileReads.end());
+
+	frameGraph->addPass("lightingFull", lightingFullReads, { fullScene }, [=]()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameGraph->getTexture(fullScene), 0);
+
+		// Lighting pass
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		lightingPassShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, gComposedDepth);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, gComposedNormal);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, gComposedColor);
+		glActiveTexture(GL_TEXTURE8);
+		glBindTexture(GL_TEXTURE_2D, gComposedMaterial);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(0));
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getIrradianceMapId());
+		pbr->bindPrefilter(lightingPassShader->getShaderId(), 5, 9);
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, pbr->getBrdfLUTId());
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(lightingFull));
+		glActiveTexture(GL_TEXTURE10);
+		glBindTexture(GL_TEXTURE_2D, gComposedTransfer);
+		lightingPassShader->setUniform("useTransferMap", 1);
+		distanceFieldShadows->bind(lightingPassShader->getShaderId(), 11);
+		clusteredLights->bind(lightingPassShader->getShaderId());
+		shadowMap->bind(lightingPassShader->getShaderId(), 15);
+
+		// Pure background tiles and everything outside the influence region are taken straight from the sensor in the composite
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(influenceRect.x, influenceRect.y, influenceRect.z, influenceRect.w);
+
+		if (useTileClassification)
+		{
+			tileClassifier->drawTiles(lightingPassShader->getShaderId(), TILE_LIST_VIRTUAL);
+		}
+		else
+		{
+			quad->draw();
 		}
+
+		glDisable(GL_SCISSOR_TEST);
+	});
+
+	// Combine the differential rendering textures
+	vector<int> compositeReads = { fullScene, backScene, sensorColor };
+	compositeReads.insert(compositeReads.end(), tileReads.begin(), tileReads.end());
+
+	frameGraph->addPass("composite", compositeReads, { finalScene }, [=]()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cFinalScene, 0);
+
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		compositeShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(fullScene));
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(backScene));
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, dsColor);
+
+		// Outside the influence region the sensor color is passed through without reading the lighting results
+		compositeShader->setUniform("influenceRect", vec4(influenceRect.x, influenceRect.y, influenceRect.x + influenceRect.z, influenceRect.y + influenceRect.w));
+
+		if (useTileClassification)
+		{
+			tileClassifier->drawTiles(compositeShader->getShaderId(), TILE_LIST_VIRTUAL);
+
+			compositeShader->setUniform("realOnly", 1);
+			tileClassifier->drawTiles(compositeShader->getShaderId(), TILE_LIST_REAL_ONLY);
+			compositeShader->setUniform("realOnly", 0);
+		}
+		else
+		{
+			quad->draw();
+		}
+
+		finalOutput = cFinalScene;
+	});
+
+	// Accumulate the final image over frames, the unresolved one still feeds next frame's reflections
+	int outputScene = finalScene;
+
+	if (useTemporalResolve)
+	{
+		frameGraph->addPass("temporalResolve", { finalScene, composedDepth, composedNormal, composedMotion }, { resolvedScene }, [=]()
+		{
+			finalOutput = finalTemporalFilter->resolve(cFinalScene, gComposedDepth, gComposedNormal, gComposedMotion);
+		});
+
+		outputScene = resolvedScene;
 	}
 
-	// Combine GBuffer and kinect buffers
-	glBindFramebuffer(GL_FRAMEBUFFER, gComposeBuffer);
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// Only what the display mode shows keeps its producers alive
+	vector<int> outputReads;
 
-	gComposePassShader->apply();
+	switch (renderMode)
+	{
+	case 2: outputReads = { composedDepth }; break;
+	case 3: outputReads = { composedNormal }; break;
+	case 4: outputReads = { ambientOcclusion }; break;
+	case 5: outputReads = { composedColor }; break;
+	case 7: outputReads = { sensorDepth }; break;
+	case 8: outputReads = { lightingFull }; break;
+	case 9: outputReads = { reflectionAO }; break;
+	default: outputReads = { outputScene }; break;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gColor);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, sensor->getPositionMapId());
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, sensor->getNormalMapId());
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, sensor->getColorMapId());
-
-	quad->draw();
+	// Just output the final texture
+	frameGraph->addPass("output", outputReads, {}, [=]()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	// Compute ssao for GBuffer and kinect inputs
-	ssao->drawLayer(1, gComposedPosition, gComposedNormal, gComposedColor);
-	ssao->drawLayer(2, dsPosition, dsNormal, dsColor);
-	ssao->drawCombined(gComposedColor);
+		glViewport(0, 0, bufferWidth, bufferHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		outputShader->apply();
 
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, finalOutput);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, gComposedDepth);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, gComposedNormal);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, gComposedColor);
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(0));
+		glActiveTexture(GL_TEXTURE5);
+		glBindTexture(GL_TEXTURE_2D, dsColor);
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, sensor->getDepthMapId());
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(lightingFull));
+		glActiveTexture(GL_TEXTURE8);
+		glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(reflectionAO));
+
+		quad->draw();
+	}, true);
+}
 
-	// Screen space reflection pass
-	ssr->draw(dsPosition, dsNormal, dsColor, pbr->getIrradianceMapId(), pbr->getPrefilterMapId(), cLightingBack, cAmbientOcclusionBg);
 
+// Objects with baked transfer use the PRT variant of the gPass, so their irradiance comes self shadowed
+Shader* Scene::applyGPassShader(Object* object)
+{
+	Shader* shader = (usePRT && object->getHasTransfer()) ? gPassPRTShader : gPassShader;
+	shader->apply();
+	object->setGPassShaderId(shader->getShaderId());
+	return shader;
+}
 
-	// Differential rendering: Background (real) scene pass
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cBackScene, 0);
+// Visible objects and dragon instances for the gPass, tested against the sensor projection the gPass renders with
+void Scene::cullScene()
+{
+	visibleObjects.clear();
+	visibleDragons.clear();
 
-	// Lighting pass
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (useFrustumCulling)
+	{
+		cullingFrustum.extract(sensor->getMatProjection() * camera->getMatView());
 
-	lightingPassShader->apply();
+		visibleProxies.clear();
+		cullingTree->query(cullingFrustum, visibleProxies);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, dsPosition);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, dsNormal);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, dsColor);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(2));
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getIrradianceMapId());
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getPrefilterMapId());
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, pbr->getBrdfLUTId());
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, cLightingBack);
-
-	quad->draw();
-	
+		for (int userData : visibleProxies)
+		{
+			if (userData >= 0) visibleObjects.push_back(cullingObjects[userData]);
+			else visibleDragons.push_back(-1 - userData);
+		}
 
-	// Screen space reflection pass
-	ssr->draw(gComposedPosition, gComposedNormal, cFinalScene, pbr->getIrradianceMapId(), pbr->getPrefilterMapId(), cLightingFull, cAmbientOcclusion);
-	
-	// Differential rendering: Rendered (virtual) scene pass
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cFullScene, 0);
+		// Keep the instance order, so the list is only uploaded again when the visible set changed
+		sort(visibleDragons.begin(), visibleDragons.end());
+	}
+	else
+	{
+		visibleObjects = cullingObjects;
+		for (int i = 0; i < dragonInstances->getInstanceCount(); i++)
+		{
+			visibleDragons.push_back(i);
+		}
+	}
 
-	// Lighting pass
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	dragonInstances->setVisibleInstances(visibleDragons);
+}
 
-	lightingPassShader->apply();
+// Screen rectangle of the visible virtual objects, the sensor only scene is the same as the full one outside of it
+void Scene::computeInfluenceRegion(bool includeDragons)
+{
+	// Debug views of the lighting results show the whole buffer
+	if (!useInfluenceRegion || renderMode == 8 || renderMode == 9)
+	{
+		influenceRect = ivec4(0, 0, bufferWidth, bufferHeight);
+		return;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gComposedPosition);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gComposedNormal);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gComposedColor);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(0));
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getIrradianceMapId());
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getPrefilterMapId());
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, pbr->getBrdfLUTId());
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, cLightingFull);
-
-	quad->draw();
+	// Grow the bounds in world space by the reach of the AO kernel and the reflection rays, contact shadows by the margin
+	mat4 viewProjection = sensor->getMatProjection() * camera->getMatView();
+	vec3 reach = vec3(influenceMargin + ssao->getKernelRadius() + ssr->getMaxRayTraceDistance());
+	vec2 rectMin = vec2(FLT_MAX);
+	vec2 rectMax = vec2(-FLT_MAX);
+	bool fullScreen = false;
 
-	
+	auto addBox = [&](vec3 boxMin, vec3 boxMax)
+	{
+		boxMin -= reach;
+		boxMax += reach;
 
-	// Combine the differential rendering textures
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cFinalScene, 0);
+		for (int i = 0; i < 8; i++)
+		{
+			vec3 corner = vec3((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+			vec4 clip = viewProjection * vec4(corner, 1.0f);
+
+			// A box reaching behind the camera can cover any part of the screen
+			if (clip.w <= 0.0001f)
+			{
+				fullScreen = true;
+				return;
+			}
+
+			vec2 ndc = vec2(clip) / clip.w;
+			rectMin = min(rectMin, ndc);
+			rectMax = max(rectMax, ndc);
+		}
+	};
 
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	for (Object* object : visibleObjects)
+	{
+		addBox(object->getWorldMin(), object->getWorldMax());
+	}
 
-	compositeShader->apply();
+	if (includeDragons)
+	{
+		for (GLuint instance : visibleDragons)
+		{
+			addBox(dragonBounds[instance * 2], dragonBounds[instance * 2 + 1]);
+		}
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, cFullScene);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, cBackScene);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, dsColor);
+	// Virtual lights brighten the real surfaces within their radius, lights outside the view are skipped
+	Frustum lightFrustum;
+	lightFrustum.extract(viewProjection);
 
-	quad->draw();
+	for (const PointLight& light : clusteredLights->getLights())
+	{
+		vec3 lightMin = vec3(light.positionRadius) - light.positionRadius.w;
+		vec3 lightMax = vec3(light.positionRadius) + light.positionRadius.w;
 
-	// Just output the final texture
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (lightFrustum.testBox(lightMin, lightMax) != FRUSTUM_OUTSIDE)
+		{
+			addBox(lightMin, lightMax);
+		}
+	}
 
-	glViewport(0, 0, bufferWidth, bufferHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (fullScreen)
+	{
+		influenceRect = ivec4(0, 0, bufferWidth, bufferHeight);
+		return;
+	}
 
-	outputShader->apply();
+	// Nothing virtual in view leaves an empty rectangle, the passes then draw nothing
+	if (rectMin.x > rectMax.x)
+	{
+		influenceRect = ivec4(0);
+		return;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, cFinalScene);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gComposedPosition);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gComposedNormal);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, gComposedColor);
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(0));
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, dsColor);
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, sensor->getDepthMapId());
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, cLightingFull);
-	glActiveTexture(GL_TEXTURE8);
-	glBindTexture(GL_TEXTURE_2D, cAmbientOcclusion);
+	// To pixels, with a margin for the screen space blurs
+	vec2 bufferSize = vec2(bufferWidth, bufferHeight);
+	ivec2 pixelMin = ivec2(floor((rectMin * 0.5f + 0.5f) * bufferSize)) - influencePixelMargin;
+	ivec2 pixelMax = ivec2(ceil((rectMax * 0.5f + 0.5f) * bufferSize)) + influencePixelMargin;
+	pixelMin = clamp(pixelMin, ivec2(0), ivec2(bufferWidth, bufferHeight));
+	pixelMax = clamp(pixelMax, ivec2(0), ivec2(bufferWidth, bufferHeight));
 
-	quad->draw();
+	influenceRect = ivec4(pixelMin, max(pixelMax - pixelMin, ivec2(0)));
+}
 
+// Scatter small virtual lights just above the sensor surface around the dragon spawn points
+void Scene::spawnLights(int count)
+{
+	clusteredLights->clearLights();
 
-	// Draw GUI
-	if (isGUIVisible)
+	if (customPositions == nullptr || customPositions->empty())
 	{
-		guiScreen->drawWidgets();
-		glEnable(GL_DEPTH_TEST); // Reset changed states
-		glDisable(GL_BLEND);
+		cout << "Spawn dragons first, lights are placed around their sensor positions" << endl;
+		return;
 	}
 
-	glfwSwapBuffers(window);
+	for (int i = 0; i < count; i++)
+	{
+		int index = (int)(randomFloats(generator) * customPositions->size()) % customPositions->size();
+		if (customPositions->at(index) == vec3(0)) continue;
+
+		vec3 jitter = vec3(randomFloats(generator), randomFloats(generator), randomFloats(generator)) - 0.5f;
+		float height = 0.02f + randomFloats(generator) * 0.1f;
+		vec3 position = customPositions->at(index) + jitter * 0.3f + customNormals->at(index) * height;
 
-	//pauseRender = true;
+		vec3 color = vec3(randomFloats(generator), randomFloats(generator), randomFloats(generator));
+		color = color / std::max(compMax(color), 0.001f) * virtualLightIntensity;
+
+		clusteredLights->addLight(position, virtualLightRadius, color);
+	}
+
+	cout << "Spawned " << clusteredLights->getLightCount() << " virtual lights" << endl;
 }
 
 void Scene::spawnDragons(int numRadius)
@@ -782,10 +1443,60 @@ void Scene::spawnDragons(int numRadius)
 	sensor->getCustomPixelInfo(numRadius, customPositions, customNormals);
 
 	customRandoms.clear();
-	for (int i = 0; i < customPositions->size(); i++)
+	for (size_t i = 0; i < customPositions->size(); i++)
 	{
 		customRandoms.push_back(randomFloats(generator));
 	}
+
+	dragonsPlaced = false;
+}
+
+// Rebuild the instance list of the spawned dragons, the shared object only serves to compose the matrices
+void Scene::placeDragons()
+{
+	const vec4 albedos[4] = { vec4(1, 1, 1, 1), vec4(1, 0, 0, 1), vec4(0, 1, 0, 1), vec4(0, 0, 1, 1) };
+
+	dragonInstances->clearInstances();
+
+	for (int proxy : dragonProxies)
+	{
+		cullingTree->destroyProxy(proxy);
+	}
+	dragonProxies.clear();
+	dragonBounds.clear();
+
+	for (size_t i = 0; i < customPositions->size(); i++)
+	{
+		if (customPositions->at(i) == glm::vec3(0)) continue;
+
+		dragon->setScale(vec3(dragonScale) * -customPositions->at(i).z);
+		float halfHeight = (dragon->getBoundingBox().Height / 2) * drasonHeightFactor;
+		dragon->setPosition(customPositions->at(i) + customNormals->at(i) * halfHeight);
+		dragon->setRotationByAxisAngle(customNormals->at(i), customRandoms.at(i) * 360.0f);
+
+		InstanceData instance = {};
+		instance.model = dragon->getModelMatrix();
+		instance.modelInverse = inverse(instance.model);
+		instance.shRotationBand1 = mat4(dragon->getSHRotationBand1());
+		memcpy(instance.shRotationBand2, dragon->getSHRotationBand2(), 25 * sizeof(float));
+
+		// Give each dragon a different material, roughness along the rows and metallic along the columns
+		size_t w = (size_t)dragonNumRadius * 2 + 1;
+		float x = (float)(i % w) / std::max(w - 1, (size_t)1);
+		float y = (float)(i / w) / std::max(w - 1, (size_t)1);
+		instance.albedo = albedos[i % 4];
+		instance.material = vec4(x, y, 0, 0);
+
+		// Instances are told apart from objects by negative user data
+		dragonProxies.push_back(cullingTree->createProxy(dragon->getWorldMin(), dragon->getWorldMax(), -1 - dragonInstances->getInstanceCount()));
+		dragonBounds.push_back(dragon->getWorldMin());
+		dragonBounds.push_back(dragon->getWorldMax());
+		dragonInstances->addInstance(instance);
+	}
+
+	dragonsPlaced = true;
+	placedDragonScale = dragonScale;
+	placedDragonHeightFactor = drasonHeightFactor;
 }
 
 
@@ -807,7 +1518,7 @@ void Scene::keyCallback(int key, int action)
 	{
 		renderMode = key - 48;
 		outputShader->apply();
-		glUniform1i(glGetUniformLocation(outputShader->getShaderId(), "displayMode"), renderMode);
+		outputShader->setUniform("displayMode", renderMode);
 	}
 
 	if (key == GLFW_KEY_P && action == GLFW_PRESS)
@@ -837,6 +1548,11 @@ void Scene::keyCallback(int key, int action)
 		pbr->recomputeEnvMaps(dsColor);
 	}
 
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+	{
+		frameGraph->printPasses();
+	}
+
 	if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
 	{
 		spawnDragons(dragonNumRadius);
@@ -859,6 +1575,20 @@ void Scene::windowSizeCallback(int x, int y)
 	camera->setResolution(x, y);
 }
 
+// Dropping a .hdr panorama replaces the environment until the next recapture
+void Scene::dropCallback(int count, const char** paths)
+{
+	for (int i = 0; i < count; i++)
+	{
+		string filepath = paths[i];
+
+		if (filepath.size() > 4 && filepath.substr(filepath.size() - 4) == ".hdr")
+		{
+			pbr->loadEnvironment(filepath);
+		}
+	}
+}
+
 float Scene::getBgRoughness() const
 {
 	return bgRoughness;
@@ -879,6 +1609,36 @@ float Scene::getExposure() const
 	return exposure;
 }
 
+bool Scene::getUseTileClassification() const
+{
+	return useTileClassification;
+}
+
+bool Scene::getUseTemporalResolve() const
+{
+	return useTemporalResolve;
+}
+
+bool Scene::getUseSHIrradiance() const
+{
+	return pbr->getUseSHIrradiance();
+}
+
+bool Scene::getUseEnvironmentEstimation() const
+{
+	return useEnvironmentEstimation;
+}
+
+GpuProfiler* Scene::getProfiler() const
+{
+	return profiler;
+}
+
+void Scene::setFixedFrameTime(float value)
+{
+	fixedFrameTime = value;
+}
+
 void Scene::setBgRoughness(float value)
 {
 	bgRoughness = value;
@@ -898,5 +1658,33 @@ void Scene::setExposure(float value)
 {
 	exposure = value;
 	lightingPassShader->apply();
-	glUniform1f(glGetUniformLocation(lightingPassShader->getShaderId(), "exposure"), exposure);
+	lightingPassShader->setUniform("exposure", exposure);
+}
+
+void Scene::setUseTileClassification(bool value)
+{
+	useTileClassification = value;
+	ssr->setTileClassifier(useTileClassification ? tileClassifier : nullptr, TILE_LIST_REFLECTIVE);
+}
+
+void Scene::setUseTemporalResolve(bool value)
+{
+	useTemporalResolve = value;
+	if (useTemporalResolve) finalTemporalFilter->reset();
+}
+
+void Scene::setUseSHIrradiance(bool value)
+{
+	pbr->setUseSHIrradiance(value);
+
+	// The irradiance cubemap is not kept up to date while spherical harmonics are used
+	if (!value) pbr->recomputeEnvMaps(dsColor);
+}
+
+void Scene::setUseEnvironmentEstimation(bool value)
+{
+	useEnvironmentEstimation = value;
+
+	// Start over instead of blending with a stale room
+	if (useEnvironmentEstimation) environmentEstimator->reset();
 }
\ No newline at end of file
@@ -11,9 +11,29 @@
 #include "PBR.h"
 #include "PointCloud.h"
 #include "SSReflection.h"
+#include "TileClassifier.h"
+#include "TemporalFilter.h"
+#include "BlueNoise.h"
+#include "EnvironmentEstimator.h"
+#include "DistanceFieldShadows.h"
+#include "ClusteredLights.h"
+#include "ShadowMap.h"
+#include "InstanceBuffer.h"
+#include "FrameGraph.h"
+#include "GpuProfiler.h"
+#include "UniformBlock.h"
 
 #include <random>
 
+// Materials of the virtual objects and the real surfaces, std140 block at binding 12
+struct MaterialParameters
+{
+	float roughness;
+	float metallic;
+	float bgRoughness;
+	float bgMetallic;
+};
+
 class Scene
 {
 	
@@ -21,24 +41,32 @@ private:
 
 	bool initSuccess = false;
 	double currentTime, previousTime = 0.0;
+	float fixedFrameTime = 0.0f; // Used instead of the measured interval when set
 	bool pauseRender = false;
 
-	GLuint gBuffer, gComposeBuffer;
-	GLuint gPosition, gNormal, gColor, gDepth;
-	GLuint gComposedPosition, gComposedNormal, gComposedColor;
-	GLuint dsPosition, dsNormal, dsColor;
+	GLuint gBuffer, gComposeBuffer, dsBuffer;
+	GLuint gComposedDepth, gComposedNormal, gComposedMaterial, gComposedColor, gComposedMotion, gComposedTransfer;
+	GLuint dsDepth, dsNormal, dsMaterial, dsColor;
 	Shader* gPassShader = nullptr;
+	Shader* gPassPRTShader = nullptr;
 	Shader* lightingPassShader = nullptr;
 	Shader* gComposePassShader = nullptr;
+	Shader* dsSeedShader = nullptr;
+
+	// The ds textures are only resampled when the sensor filtered a new frame. With the depth preseed they seed
+	// the composed targets and the virtual objects are depth tested against them, replacing the gCompose pass
+	bool useDepthPreseed = true;
+	int seededSensorRevision = -1;
 	SSAO* ssao = nullptr;
 	int bufferWidth, bufferHeight;
 
 	CameraFPS* camera = nullptr;
 	Quad* quad = nullptr;
 	Object* dragon = nullptr;
+	InstanceBuffer* dragonInstances = nullptr;
 	Object* plane;
 	Object* knob;
-	GLuint texWhite, texRed, texGreen, texBlue;
+	GLuint texWhite;
 
 	std::uniform_real_distribution<float> randomFloats;
 	std::default_random_engine generator;
@@ -47,7 +75,8 @@ private:
 	std::vector<float> customRandoms;
 	Timer* timerRunOnceOnStart;
 
-	GLuint uniform_CamMat;
+	GLuint uniform_CamMat, uniform_CamMatPrevious;
+	glm::mat4 matViewPrevious = glm::mat4(1);
 	int renderMode = 1;
 
 	nanogui::Screen* guiScreen = nullptr;
@@ -60,57 +89,125 @@ private:
 
 	glm::vec3 lightPosition = glm::vec3(0.0f, 1111.5f, 0.0f);
 	nanogui::Color lightColor = nanogui::Color(1.00f, 0.48f, 0.49f, 1.0f);
+	float lightIntensity = 0.5f;
+	bool useDirectLight = false;
 	float bgRoughness = 0.8f;
 	float bgMetallic = 0.0f;
 	float roughness = 0.04f;
 	float metallic = 0.1f;
 	float exposure = 2.0;
+	UniformBlock<MaterialParameters>* materialBlock = nullptr;
 
 	PBR* pbr;
+	bool liveIrradiance = false;
+	EnvironmentEstimator* environmentEstimator = nullptr;
+	// Opt in, finished estimates replace environments captured or loaded by hand
+	bool useEnvironmentEstimation = false;
+	bool usePRT = true;
 
 	Shader* compositeShader;
 	Shader* outputShader;
 	GLuint captureFBO;
-	GLuint cLightingFull, cLightingBack;
-	GLuint cFullScene, cBackScene;
 	GLuint cFinalScene;
+	GLuint finalOutput = 0;
+	FrameGraph* frameGraph = nullptr;
+	GpuProfiler* profiler = nullptr;
 	int currFrame = 0;
 
 	SSReflection* ssr;
-	GLuint cAmbientOcclusion, cAmbientOcclusionBg;
+
+	TileClassifier* tileClassifier;
+	bool useTileClassification = false;
+
+	DistanceFieldShadows* distanceFieldShadows = nullptr;
+	int knobDistanceField = -1;
+	int dragonDistanceField = -1;
+
+	ClusteredLights* clusteredLights = nullptr;
+	int virtualLightCount = 32;
+	float virtualLightRadius = 0.3f;
+	float virtualLightIntensity = 0.5f;
+
+	ShadowMap* shadowMap = nullptr;
+
+	// Objects and dragon instances are culled against the view before the gPass
+	AABBTree* cullingTree = nullptr;
+	Frustum cullingFrustum;
+	bool useFrustumCulling = true;
+	std::vector<Object*> cullingObjects; // Indexed by the user data of their proxies
+	std::vector<int> dragonProxies;
+	std::vector<int> visibleProxies;
+	std::vector<Object*> visibleObjects;
+	std::vector<GLuint> visibleDragons;
+	std::vector<glm::vec3> dragonBounds; // World min and max of every instance
+
+	// Differential rendering only runs where the virtual objects can change the image:
+	// their projected bounds grown by the reach of their AO, shadows and reflections
+	bool useInfluenceRegion = true;
+	float influenceMargin = 0.1f;
+	int influencePixelMargin = 16;
+	glm::ivec4 influenceRect; // x, y, width, height in buffer pixels
+
+	BlueNoise* blueNoise;
+	TemporalFilter* finalTemporalFilter;
+	bool useTemporalResolve = false;
 
 	PointCloud* pointCloud;
 
 	void recompileShaders();
 	void initializeShaders();
+	void initializeGUI();
+	void buildFrameGraph();
 
 	void spawnDragons(int numRadius);
+	void placeDragons();
+	void cullScene();
+	void computeInfluenceRegion(bool includeDragons);
+	Shader* applyGPassShader(Object* object);
+	void spawnLights(int count);
 	int dragonNumRadius = 1;
 	float dragonScale = 0.15f;
 	float drasonHeightFactor = 0.8f;
 
+	// Placement the instance list was built for, rebuilt after a spawn or a GUI change
+	bool dragonsPlaced = false;
+	float placedDragonScale = 0.0f;
+	float placedDragonHeightFactor = 0.0f;
+
 public:
 
 	Scene();
 	~Scene();
 
-	void initialize(nanogui::Screen* guiScreen);
+	void initialize(nanogui::Screen* guiScreen, std::string sensorRecording = "");
 	void update();
 	void render(GLFWwindow* window);
+	bool saveFinalImage(std::string filepath) const;
 
 	void keyCallback(int key, int action);
 	void cursorPosCallback(double x, double y);
 	void mouseCallback(int button, int action);
 	void windowSizeCallback(int x, int y);
+	void dropCallback(int count, const char** paths);
 
 	float getBgRoughness() const;
 	float getRoughness() const;
 	float getMetallic() const;
 	float getExposure() const;
+	bool getUseTileClassification() const;
+	bool getUseTemporalResolve() const;
+	bool getUseSHIrradiance() const;
+	bool getUseEnvironmentEstimation() const;
+	GpuProfiler* getProfiler() const;
 
+	void setFixedFrameTime(float value);
 	void setBgRoughness(float value);
 	void setRoughness(float value);
 	void setMetallic(float value);
 	void setExposure(float value);
+	void setUseTileClassification(bool value);
+	void setUseTemporalResolve(bool value);
+	void setUseSHIrradiance(bool value);
+	void setUseEnvironmentEstimation(bool value);
 
 };
\ No newline at end of file
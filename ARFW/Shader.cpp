@@ -5,6 +5,7 @@ using namespace glm;
 
 extern std::string g_ExePath;
 vector<Shader::IdNamePair> Shader::shaderList;
+unordered_map<GLuint, Shader::LocationMap> Shader::uniformLocations;
 
 Shader::Shader(string shadername)
 {
@@ -17,8 +18,8 @@ Shader::Shader(string shadername)
 	if (it == shaderList.end())
 	{
 		cout << "Shader Loaded: " << shadername << endl;
-		shaderId = compileShader(shadername);
 		shaderName = shadername;
+		shaderId = compileShader(shadername);
 		if (shaderId)
 		{
 			shaderList.push_back(make_pair(shaderId, shadername));
@@ -47,6 +48,72 @@ void Shader::recompile()
 	if (shaderId != 0) compileShader(shaderName);
 }
 
+GLint Shader::getUniformLocation(const string& name) const
+{
+	return getUniformLocation(shaderId, name);
+}
+
+// Cached location of a uniform, programs linked outside this class fall back to the driver
+GLint Shader::getUniformLocation(GLuint program, const string& name)
+{
+	unordered_map<GLuint, LocationMap>::const_iterator programIt = uniformLocations.find(program);
+	if (programIt == uniformLocations.end()) return glGetUniformLocation(program, name.c_str());
+
+	LocationMap::const_iterator it = programIt->second.find(name);
+	return (it != programIt->second.end()) ? it->second : -1;
+}
+
+// The setters write to the program directly, it does not have to be applied
+void Shader::setUniform(const string& name, int value) const
+{
+	glProgramUniform1i(shaderId, getUniformLocation(name), value);
+}
+
+void Shader::setUniform(const string& name, float value) const
+{
+	glProgramUniform1f(shaderId, getUniformLocation(name), value);
+}
+
+void Shader::setUniform(const string& name, const vec2& value) const
+{
+	glProgramUniform2fv(shaderId, getUniformLocation(name), 1, value_ptr(value));
+}
+
+void Shader::setUniform(const string& name, const vec3& value) const
+{
+	glProgramUniform3fv(shaderId, getUniformLocation(name), 1, value_ptr(value));
+}
+
+void Shader::setUniform(const string& name, const vec4& value) const
+{
+	glProgramUniform4fv(shaderId, getUniformLocation(name), 1, value_ptr(value));
+}
+
+void Shader::setUniform(const string& name, const mat3& value) const
+{
+	glProgramUniformMatrix3fv(shaderId, getUniformLocation(name), 1, GL_FALSE, value_ptr(value));
+}
+
+void Shader::setUniform(const string& name, const mat4& value) const
+{
+	glProgramUniformMatrix4fv(shaderId, getUniformLocation(name), 1, GL_FALSE, value_ptr(value));
+}
+
+void Shader::setUniformArray(const string& name, int count, const float* values) const
+{
+	glProgramUniform1fv(shaderId, getUniformLocation(name), count, values);
+}
+
+void Shader::setUniformArray(const string& name, int count, const vec3* values) const
+{
+	glProgramUniform3fv(shaderId, getUniformLocation(name), count, value_ptr(values[0]));
+}
+
+void Shader::setUniformArray(const string& name, int count, const vec4* values) const
+{
+	glProgramUniform4fv(shaderId, getUniformLocation(name), count, value_ptr(values[0]));
+}
+
 GLuint Shader::getShaderId() const
 {
 	return shaderId;
@@ -57,20 +124,39 @@ std::string Shader::getShaderName() const
 	return shaderName;
 }
 
-// Read and return the contents of a file.
+// Read and return the contents of a file. Lines #include "file" are replaced by that file from the same directory,
+// followed by a #line directive so compile errors still report the line numbers of the including file.
 string Shader::readShaderFile(string filename)
 {
 	ifstream fileStream(filename, ios::in);
-	if (fileStream.is_open())
+	if (!fileStream.is_open()) return "";
+
+	const string includeDirective = "#include \"";
+	string directory = filename.substr(0, filename.find_last_of("\\/") + 1);
+	stringstream strStream;
+	string line;
+	int lineNumber = 0;
+
+	while (getline(fileStream, line))
 	{
-		stringstream strStream;
-		strStream << fileStream.rdbuf();
-		fileStream.close();
+		lineNumber++;
 
-		return strStream.str();
+		if (line.compare(0, includeDirective.size(), includeDirective) == 0)
+		{
+			string includeName = line.substr(includeDirective.size(), line.find('"', includeDirective.size()) - includeDirective.size());
+			string includeSource = readShaderFile(directory + includeName);
+			if (includeSource == "") cout << "Cannot open shader include: " << directory + includeName << endl;
+
+			strStream << includeSource << "\n#line " << lineNumber + 1 << "\n";
+			continue;
+		}
+
+		strStream << line << "\n";
 	}
 
-	return "";
+	fileStream.close();
+
+	return strStream.str();
 }
 
 // Load, compile and link shader and return program id.
@@ -80,9 +166,15 @@ GLuint Shader::compileShader(string name)
 	string vspath = g_ExePath + "../../media/shader/" + name + ".vs";
 	string fspath = g_ExePath + "../../media/shader/" + name + ".fs";
 	string gspath = g_ExePath + "../../media/shader/" + name + ".gs";
+	string cspath = g_ExePath + "../../media/shader/" + name + ".cs";
 	string vs = readShaderFile(vspath);
 	string fs = readShaderFile(fspath);
 	string gs = readShaderFile(gspath);
+	string cs = readShaderFile(cspath);
+
+	// Compute programs consist of a single stage
+	if (cs != "" && vs == "" && fs == "") return compileComputeShader(cs);
+
 	const GLchar* vertSrc = vs.c_str();
 	const GLchar* fragSrc = fs.c_str();
 	const GLchar* geomSrc = gs.c_str();
@@ -189,5 +281,120 @@ GLuint Shader::compileShader(string name)
 	glDetachShader(shaderId, fragShader);
 	if (gs != "") glDetachShader(shaderId, geomShader);
 
+	reflectProgram();
+
 	return shaderId;
+}
+
+// Compile and link a compute shader and return program id.
+GLuint Shader::compileComputeShader(string source)
+{
+	const GLchar* compSrc = source.c_str();
+
+	GLuint compShader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compShader, 1, &compSrc, NULL);
+	glCompileShader(compShader);
+
+	glGetShaderiv(compShader, GL_COMPILE_STATUS, &status);
+	glGetShaderiv(compShader, GL_INFO_LOG_LENGTH, &logLength);
+	infoLog = vector<GLchar>(logLength);
+	glGetShaderInfoLog(compShader, logLength, &logLength, &infoLog[0]);
+	if (logLength > 0)
+	{
+		cout << "=== COMPUTE SHADER LOG ===" << endl;
+		cout << &infoLog[0] << endl;
+	}
+
+	if (status == GL_FALSE)
+	{
+		glDeleteShader(compShader);
+		return 0;
+	}
+
+	if (shaderId == 0) shaderId = glCreateProgram();
+	glAttachShader(shaderId, compShader);
+	glLinkProgram(shaderId);
+
+	// Linking error checking
+	glGetProgramiv(shaderId, GL_LINK_STATUS, &status);
+	glGetProgramiv(shaderId, GL_INFO_LOG_LENGTH, &logLength);
+	infoLog = vector<GLchar>(logLength);
+	glGetProgramInfoLog(shaderId, logLength, &logLength, &infoLog[0]);
+	if (logLength > 0)
+	{
+		cout << "=== PROGRAM LINKING LOG ===" << endl;
+		cout << &infoLog[0] << endl;
+	}
+
+	if (status == GL_FALSE)
+	{
+		glDeleteShader(compShader);
+		glDeleteProgram(shaderId);
+		return 0;
+	}
+
+	glDetachShader(shaderId, compShader);
+	glDeleteShader(compShader);
+
+	reflectProgram();
+
+	return shaderId;
+}
+
+// Enumerate the active uniforms of the linked program once, so per frame updates skip the string lookups
+void Shader::reflectProgram()
+{
+	LocationMap& locations = uniformLocations[shaderId];
+	locations.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv(shaderId, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+
+	const GLenum uniformProperties[3] = { GL_NAME_LENGTH, GL_LOCATION, GL_ARRAY_SIZE };
+
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLint values[3];
+		glGetProgramResourceiv(shaderId, GL_UNIFORM, i, 3, uniformProperties, 3, NULL, values);
+
+		// Members of uniform blocks have no location
+		if (values[1] < 0) continue;
+
+		vector<GLchar> nameBuffer(values[0]);
+		glGetProgramResourceName(shaderId, GL_UNIFORM, i, values[0], NULL, &nameBuffer[0]);
+		string name(&nameBuffer[0]);
+		locations[name] = values[1];
+
+		// Arrays are reported by their first element, also accept the plain name and register every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			string baseName = name.substr(0, name.size() - 3);
+			locations[baseName] = values[1];
+
+			for (GLint element = 1; element < values[2]; element++)
+			{
+				string elementName = baseName + "[" + to_string(element) + "]";
+				locations[elementName] = glGetUniformLocation(shaderId, elementName.c_str());
+			}
+		}
+	}
+
+	// Parameter blocks are shared by binding point, one without a binding would silently alias block 0
+	GLint blockCount = 0;
+	glGetProgramInterfaceiv(shaderId, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCount);
+
+	const GLenum blockProperties[2] = { GL_NAME_LENGTH, GL_BUFFER_BINDING };
+
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		GLint values[2];
+		glGetProgramResourceiv(shaderId, GL_UNIFORM_BLOCK, i, 2, blockProperties, 2, NULL, values);
+
+		if (values[1] == 0)
+		{
+			vector<GLchar> nameBuffer(values[0]);
+			glGetProgramResourceName(shaderId, GL_UNIFORM_BLOCK, i, values[0], NULL, &nameBuffer[0]);
+			cout << "Uniform block " << &nameBuffer[0] << " of " << shaderName << " has no binding" << endl;
+		}
+	}
 }
\ No newline at end of file
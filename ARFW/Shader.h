@@ -4,6 +4,7 @@
 #include <fstream>
 #include <algorithm>
 #include <utility>
+#include <unordered_map>
 
 class Shader
 {
@@ -13,6 +14,10 @@ private:
 	typedef std::pair<GLuint, std::string> IdNamePair;
 	static std::vector<IdNamePair> shaderList;
 
+	// Locations of the active uniforms per program, filled when a program links
+	typedef std::unordered_map<std::string, GLint> LocationMap;
+	static std::unordered_map<GLuint, LocationMap> uniformLocations;
+
 	bool hasError = false;
 	GLint status, logLength;
 	std::vector<GLchar> infoLog;
@@ -21,6 +26,8 @@ private:
 
 	std::string readShaderFile(std::string filename);
 	GLuint compileShader(std::string name);
+	GLuint compileComputeShader(std::string source);
+	void reflectProgram();
 
 public:
 
@@ -30,6 +37,20 @@ public:
 	void apply();
 	void recompile();
 
+	GLint getUniformLocation(const std::string& name) const;
+	static GLint getUniformLocation(GLuint program, const std::string& name);
+
+	void setUniform(const std::string& name, int value) const;
+	void setUniform(const std::string& name, float value) const;
+	void setUniform(const std::string& name, const glm::vec2& value) const;
+	void setUniform(const std::string& name, const glm::vec3& value) const;
+	void setUniform(const std::string& name, const glm::vec4& value) const;
+	void setUniform(const std::string& name, const glm::mat3& value) const;
+	void setUniform(const std::string& name, const glm::mat4& value) const;
+	void setUniformArray(const std::string& name, int count, const float* values) const;
+	void setUniformArray(const std::string& name, int count, const glm::vec3* values) const;
+	void setUniformArray(const std::string& name, int count, const glm::vec4* values) const;
+
 	GLuint getShaderId() const;
 	std::string getShaderName() const;
 	
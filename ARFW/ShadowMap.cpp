@@ -0,0 +1,200 @@
+#include "ShadowMap.h"
+
+using namespace std;
+using namespace glm;
+
+ShadowMap::ShadowMap()
+{
+	depthShader = new Shader("shadowDepth");
+
+	glGenTextures(1, &depthMap);
+	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cout << "Shadow map framebuffer not complete!" << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowMap::~ShadowMap()
+{
+	delete depthShader;
+	glDeleteTextures(1, &depthMap);
+	glDeleteFramebuffers(1, &fbo);
+}
+
+void ShadowMap::recompileShaders()
+{
+	depthShader->recompile();
+	invalidate();
+}
+
+void ShadowMap::clearCasters()
+{
+	casters.clear();
+}
+
+// Records the object as currently placed, call right after it was drawn in the gPass
+void ShadowMap::addCaster(const Object* object)
+{
+	addCaster(object->getModel(), object->getModelMatrix(), object->getTransformRevision());
+}
+
+// Instances of a shared model, the revision of their instance list stands in for the object's
+void ShadowMap::addCaster(Model* model, const mat4& matModel, unsigned int transformRevision)
+{
+	ShadowCaster caster;
+	caster.model = model;
+	caster.matModel = matModel;
+	caster.transformRevision = transformRevision;
+	casters.push_back(caster);
+}
+
+// Compares this frame's casters against the ones in the map. An unchanged revision means the object
+// was not touched since, objects re-posed for every draw fall back to comparing the matrices.
+bool ShadowMap::needsRender(vec3 lightDirection) const
+{
+	if (!valid || lightDirection != renderedLightDirection) return true;
+	if (casters.size() != renderedCasters.size()) return true;
+
+	for (size_t i = 0; i < casters.size(); i++)
+	{
+		const ShadowCaster& current = casters[i];
+		const ShadowCaster& rendered = renderedCasters[i];
+
+		if (current.model != rendered.model) return true;
+		if (current.transformRevision == rendered.transformRevision) continue;
+		if (current.matModel != rendered.matModel) return true;
+	}
+
+	return false;
+}
+
+// Orthographic light frustum around the bounding sphere of all casters plus a margin for their shadows
+void ShadowMap::fitLight(vec3 lightDirection)
+{
+	vec3 boundsMin = vec3(FLT_MAX);
+	vec3 boundsMax = vec3(-FLT_MAX);
+
+	for (const ShadowCaster& caster : casters)
+	{
+		const BoundingBox& box = caster.model->getBoundingBox();
+
+		for (int i = 0; i < 8; i++)
+		{
+			vec3 corner = vec3((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z);
+			vec3 world = vec3(caster.matModel * vec4(corner, 1.0f));
+			boundsMin = glm::min(boundsMin, world);
+			boundsMax = glm::max(boundsMax, world);
+		}
+	}
+
+	vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = length(boundsMax - boundsMin) * 0.5f + receiverMargin;
+	vec3 up = (abs(lightDirection.y) > 0.99f) ? vec3(0, 0, 1) : vec3(0, 1, 0);
+
+	mat4 lightView = lookAt(center + lightDirection * radius * 2.0f, center, up);
+	mat4 lightProjection = ortho(-radius, radius, -radius, radius, radius, radius * 4.0f);
+	lightViewProjection = lightProjection * lightView;
+}
+
+// Draws the casters into the map when they or the light changed, static frames skip the pass
+void ShadowMap::update(vec3 lightDirection)
+{
+	if (!enabled || casters.empty()) return;
+
+	lightDirection = normalize(lightDirection);
+	if (!needsRender(lightDirection)) return;
+
+	fitLight(lightDirection);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, mapSize, mapSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.5f, 4.0f);
+
+	depthShader->apply();
+	depthShader->setUniform("lightViewProjection", lightViewProjection);
+
+	for (const ShadowCaster& caster : casters)
+	{
+		depthShader->setUniform("model", caster.matModel);
+		caster.model->drawMeshOnly();
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	renderedCasters = casters;
+	renderedLightDirection = lightDirection;
+	valid = true;
+	renderCount++;
+}
+
+void ShadowMap::invalidate()
+{
+	valid = false;
+}
+
+void ShadowMap::bind(GLuint shaderId, int unit) const
+{
+	bool active = enabled && valid && !casters.empty();
+	glUniform1i(Shader::getUniformLocation(shaderId, "useShadowMap"), active ? 1 : 0);
+	if (!active) return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glUniform1i(Shader::getUniformLocation(shaderId, "shadowMap"), unit);
+	glUniformMatrix4fv(Shader::getUniformLocation(shaderId, "lightViewProjection"), 1, GL_FALSE, value_ptr(lightViewProjection));
+	glUniform1f(Shader::getUniformLocation(shaderId, "shadowDepthBias"), depthBias);
+	glUniform1f(Shader::getUniformLocation(shaderId, "shadowNormalOffset"), normalOffset);
+}
+
+void ShadowMap::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+void ShadowMap::setDepthBias(float value)
+{
+	depthBias = std::max(value, 0.0f);
+}
+
+void ShadowMap::setNormalOffset(float value)
+{
+	normalOffset = std::max(value, 0.0f);
+}
+
+bool ShadowMap::getEnabled() const
+{
+	return enabled;
+}
+
+float ShadowMap::getDepthBias() const
+{
+	return depthBias;
+}
+
+float ShadowMap::getNormalOffset() const
+{
+	return normalOffset;
+}
+
+int ShadowMap::getRenderCount() const
+{
+	return renderCount;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "global.h"
+#include "Shader.h"
+#include "Object.h"
+
+// One draw of a caster as it was placed in the gPass, shared objects are recorded once per pose
+struct ShadowCaster
+{
+	Model* model;
+	glm::mat4 matModel;
+	unsigned int transformRevision;
+};
+
+// Directional shadow map of the virtual objects for the scene light. Receivers are the sensor pixels
+// and the objects themselves, the composite turns the darkened full scene into shadows on the real surfaces.
+// The map is cached across frames and only drawn again when a caster moved or the light changed.
+class ShadowMap
+{
+
+private:
+
+	const int mapSize = 2048;
+
+	GLuint fbo, depthMap;
+	Shader* depthShader;
+
+	std::vector<ShadowCaster> casters, renderedCasters;
+	glm::vec3 renderedLightDirection = glm::vec3(0);
+	glm::mat4 lightViewProjection = glm::mat4(1);
+
+	bool enabled = true;
+	bool valid = false;
+	float depthBias = 0.0015f;
+	float normalOffset = 0.01f; // World units along the normal at grazing light angles
+	float receiverMargin = 0.5f; // Extra radius around the casters so their shadows land inside the map
+	int renderCount = 0;
+
+	bool needsRender(glm::vec3 lightDirection) const;
+	void fitLight(glm::vec3 lightDirection);
+
+public:
+
+	ShadowMap();
+	~ShadowMap();
+
+	void recompileShaders();
+	void clearCasters();
+	void addCaster(const Object* object);
+	void addCaster(Model* model, const glm::mat4& matModel, unsigned int transformRevision);
+	void update(glm::vec3 lightDirection);
+	void invalidate();
+	void bind(GLuint shaderId, int unit) const;
+
+	void setEnabled(bool value);
+	void setDepthBias(float value);
+	void setNormalOffset(float value);
+
+	bool getEnabled() const;
+	float getDepthBias() const;
+	float getNormalOffset() const;
+	int getRenderCount() const;
+
+};
\ No newline at end of file
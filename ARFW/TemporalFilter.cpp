@@ -0,0 +1,172 @@
+#include "TemporalFilter.h"
+
+using namespace std;
+using namespace glm;
+
+TemporalFilter::TemporalFilter(int width, int height)
+{
+	bufferWidth = width;
+	bufferHeight = height;
+
+	quad = new Quad();
+	shader = new Shader("temporalResolve");
+	initializeShaders();
+
+	glGenFramebuffers(1, &fbo);
+
+	// Ping-pong pairs, the resolve reads one and writes the other
+	glGenTextures(2, texHistory);
+	glGenTextures(2, texGeometry);
+
+	for (int i = 0; i < 2; i++)
+	{
+		// Linear filtering for the history, it is sampled at subpixel positions
+		glBindTexture(GL_TEXTURE_2D, texHistory[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// Normal and view depth of the pixel the history was accumulated for
+		glBindTexture(GL_TEXTURE_2D, texGeometry[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bufferWidth, bufferHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TemporalFilter::~TemporalFilter()
+{
+	delete quad;
+	delete shader;
+	glDeleteTextures(2, texHistory);
+	glDeleteTextures(2, texGeometry);
+	glDeleteFramebuffers(1, &fbo);
+}
+
+void TemporalFilter::initializeShaders()
+{
+	shader->apply();
+	shader->setUniform("inCurrent", 0);
+	shader->setUniform("inDepth", 1);
+	shader->setUniform("inNormal", 2);
+	shader->setUniform("inMotion", 3);
+	shader->setUniform("inHistory", 4);
+	shader->setUniform("inHistoryGeometry", 5);
+	shader->setUniform("blendFactor", blendFactor);
+	shader->setUniform("depthThreshold", depthThreshold);
+	shader->setUniform("normalThreshold", normalThreshold);
+	shader->setUniform("clampHistory", clampHistory);
+}
+
+void TemporalFilter::recompileShaders()
+{
+	shader->recompile();
+
+	initializeShaders();
+}
+
+GLuint TemporalFilter::resolve(GLuint texCurrent, GLuint texDepth, GLuint texNormal, GLuint texMotion)
+{
+	int previousIndex = currentIndex;
+	currentIndex = 1 - currentIndex;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texHistory[currentIndex], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, texGeometry[currentIndex], 0);
+
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+
+	glViewport(0, 0, bufferWidth, bufferHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	shader->apply();
+	shader->setUniform("historyValid", historyValid);
+	shader->setUniform("useMotion", texMotion != 0);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texCurrent);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texDepth);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, texNormal);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, texMotion);
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_2D, texHistory[previousIndex]);
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_2D, texGeometry[previousIndex]);
+
+	quad->draw();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	historyValid = true;
+
+	return texHistory[currentIndex];
+}
+
+// Drop the accumulated history, next resolve starts from the current frame only
+void TemporalFilter::reset()
+{
+	historyValid = false;
+}
+
+void TemporalFilter::setBlendFactor(float value)
+{
+	blendFactor = value;
+	shader->apply();
+	shader->setUniform("blendFactor", blendFactor);
+}
+
+void TemporalFilter::setDepthThreshold(float value)
+{
+	depthThreshold = value;
+	shader->apply();
+	shader->setUniform("depthThreshold", depthThreshold);
+}
+
+void TemporalFilter::setNormalThreshold(float value)
+{
+	normalThreshold = value;
+	shader->apply();
+	shader->setUniform("normalThreshold", normalThreshold);
+}
+
+void TemporalFilter::setClampHistory(bool value)
+{
+	clampHistory = value;
+	shader->apply();
+	shader->setUniform("clampHistory", clampHistory);
+}
+
+GLuint TemporalFilter::getOutputTexture() const
+{
+	return texHistory[currentIndex];
+}
+
+float TemporalFilter::getBlendFactor() const
+{
+	return blendFactor;
+}
+
+float TemporalFilter::getDepthThreshold() const
+{
+	return depthThreshold;
+}
+
+float TemporalFilter::getNormalThreshold() const
+{
+	return normalThreshold;
+}
+
+bool TemporalFilter::getClampHistory() const
+{
+	return clampHistory;
+}
\ No newline at end of file
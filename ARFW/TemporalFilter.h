@@ -0,0 +1,49 @@
+#pragma once
+
+#include "global.h"
+#include "Quad.h"
+#include "Shader.h"
+
+// Accumulates a noisy per frame signal over time by reprojecting last frame's result with the motion map.
+// History is rejected where depth or normal changed (disocclusion) so moving objects do not ghost.
+// Without a motion map the input is assumed to be static on screen.
+class TemporalFilter
+{
+
+private:
+
+	float blendFactor = 0.1f;
+	float depthThreshold = 0.05f;
+	float normalThreshold = 0.9f;
+	bool clampHistory = false;
+
+	Quad* quad;
+	Shader* shader;
+	GLuint fbo;
+	GLuint texHistory[2], texGeometry[2];
+	int currentIndex = 0;
+	bool historyValid = false;
+	int bufferWidth, bufferHeight;
+
+public:
+
+	TemporalFilter(int width, int height);
+	~TemporalFilter();
+
+	void initializeShaders();
+	void recompileShaders();
+	GLuint resolve(GLuint texCurrent, GLuint texDepth, GLuint texNormal, GLuint texMotion);
+	void reset();
+
+	void setBlendFactor(float value);
+	void setDepthThreshold(float value);
+	void setNormalThreshold(float value);
+	void setClampHistory(bool value);
+
+	GLuint getOutputTexture() const;
+	float getBlendFactor() const;
+	float getDepthThreshold() const;
+	float getNormalThreshold() const;
+	bool getClampHistory() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "TileClassifier.h"
+
+using namespace std;
+using namespace glm;
+
+TileClassifier::TileClassifier(int width, int height)
+{
+	bufferWidth = width;
+	bufferHeight = height;
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	maxTiles = tilesX * tilesY;
+
+	classifyShader = new Shader("tileClassify");
+	buildListsShader = new Shader("tileLists");
+	initializeShaders();
+
+	// One flag word per tile
+	glGenBuffers(1, &tileFlagsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileFlagsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxTiles * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+
+	// Indirect draw commands of every list followed by the packed tile coordinates of every list
+	glGenBuffers(1, &tileListBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (TILE_LIST_COUNT * 4 + TILE_LIST_COUNT * maxTiles) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Tiles are generated in the vertex shader, no attributes needed
+	glGenVertexArrays(1, &vao);
+}
+
+TileClassifier::~TileClassifier()
+{
+}
+
+void TileClassifier::initializeShaders()
+{
+	classifyShader->apply();
+	classifyShader->setUniform("inMaterial", 0);
+	classifyShader->setUniform("inColor", 1);
+	classifyShader->setUniform("roughnessThreshold", roughnessThreshold);
+
+	buildListsShader->apply();
+	glUniform2i(buildListsShader->getUniformLocation("tileCount"), tilesX, tilesY);
+	buildListsShader->setUniform("maxTiles", maxTiles);
+	buildListsShader->setUniform("dilationRadius", dilationRadius);
+}
+
+void TileClassifier::recompileShaders()
+{
+	classifyShader->recompile();
+	buildListsShader->recompile();
+
+	initializeShaders();
+}
+
+void TileClassifier::classify(GLuint texMaterial, GLuint texColor)
+{
+	// Reset the instance count of every list, a tile is always two triangles
+	GLuint commands[TILE_LIST_COUNT * 4];
+	for (int i = 0; i < TILE_LIST_COUNT; i++)
+	{
+		commands[i * 4 + 0] = 6;
+		commands[i * 4 + 1] = 0;
+		commands[i * 4 + 2] = 0;
+		commands[i * 4 + 3] = 0;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tileListBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, tileFlagsBuffer);
+
+	// Gather per tile flags
+	classifyShader->apply();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texMaterial);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texColor);
+
+	glDispatchCompute(tilesX, tilesY, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// Sort tiles into lists
+	buildListsShader->apply();
+
+	glDispatchCompute((maxTiles + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+// Draw the tiles of a list with the given full screen shader, its vertex shader must support useTiles
+void TileClassifier::drawTiles(GLuint shaderId, TileList list)
+{
+	glUniform1i(Shader::getUniformLocation(shaderId, "useTiles"), 1);
+	glUniform1i(Shader::getUniformLocation(shaderId, "tileListOffset"), TILE_LIST_COUNT * 4 + list * maxTiles);
+	glUniform2f(Shader::getUniformLocation(shaderId, "tileScale"), (float)tileSize / bufferWidth, (float)tileSize / bufferHeight);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tileListBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, tileListBuffer);
+	glBindVertexArray(vao);
+
+	glDrawArraysIndirect(GL_TRIANGLES, (const void*)(list * 4 * sizeof(GLuint)));
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glUniform1i(Shader::getUniformLocation(shaderId, "useTiles"), 0);
+}
+
+void TileClassifier::setRoughnessThreshold(float value)
+{
+	roughnessThreshold = value;
+	classifyShader->apply();
+	classifyShader->setUniform("roughnessThreshold", roughnessThreshold);
+}
+
+void TileClassifier::setDilationRadius(int value)
+{
+	dilationRadius = value;
+	buildListsShader->apply();
+	buildListsShader->setUniform("dilationRadius", dilationRadius);
+}
+
+float TileClassifier::getRoughnessThreshold() const
+{
+	return roughnessThreshold;
+}
+
+int TileClassifier::getDilationRadius() const
+{
+	return dilationRadius;
+}
\ No newline at end of file
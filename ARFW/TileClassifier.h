@@ -0,0 +1,49 @@
+#pragma once
+
+#include "global.h"
+#include "Shader.h"
+
+// Tile lists produced per frame, each one can be drawn with drawTiles
+enum TileList
+{
+	TILE_LIST_REAL_ONLY = 0,
+	TILE_LIST_VIRTUAL,
+	TILE_LIST_EDGE, // Virtual influence over real pixels, where the differential reads the back scene
+	TILE_LIST_REFLECTIVE,
+	TILE_LIST_COUNT
+};
+
+class TileClassifier
+{
+
+private:
+
+	const int tileSize = 16;
+
+	float roughnessThreshold = 0.75f;
+	int dilationRadius = 2;
+
+	Shader* classifyShader;
+	Shader* buildListsShader;
+	GLuint tileFlagsBuffer, tileListBuffer;
+	GLuint vao;
+	int bufferWidth, bufferHeight;
+	int tilesX, tilesY, maxTiles;
+
+public:
+
+	TileClassifier(int width, int height);
+	~TileClassifier();
+
+	void initializeShaders();
+	void recompileShaders();
+	void classify(GLuint texMaterial, GLuint texColor);
+	void drawTiles(GLuint shaderId, TileList list);
+
+	void setRoughnessThreshold(float value);
+	void setDilationRadius(int value);
+
+	float getRoughnessThreshold() const;
+	int getDilationRadius() const;
+
+};
\ No newline at end of file
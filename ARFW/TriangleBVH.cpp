@@ -0,0 +1,221 @@
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace std;
+using namespace glm;
+
+TriangleBVH::TriangleBVH(const vector<vec3>& corners)
+{
+	this->corners = corners;
+
+	int triangleCount = getTriangleCount();
+	vector<vec3> centers(triangleCount);
+	triangleIndices.resize(triangleCount);
+
+	for (int i = 0; i < triangleCount; i++)
+	{
+		centers[i] = (corners[i * 3] + corners[i * 3 + 1] + corners[i * 3 + 2]) / 3.0f;
+		triangleIndices[i] = i;
+	}
+
+	if (triangleCount > 0) build(0, triangleCount, centers);
+}
+
+TriangleBVH::~TriangleBVH()
+{
+}
+
+int TriangleBVH::build(int first, int count, const vector<vec3>& centers)
+{
+	BVHNode node;
+	node.boundsMin = vec3(FLT_MAX);
+	node.boundsMax = vec3(-FLT_MAX);
+
+	for (int i = first; i < first + count; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			node.boundsMin = min(node.boundsMin, corners[triangleIndices[i] * 3 + c]);
+			node.boundsMax = max(node.boundsMax, corners[triangleIndices[i] * 3 + c]);
+		}
+	}
+
+	int index = (int)nodes.size();
+	nodes.push_back(node);
+
+	if (count <= 4)
+	{
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return index;
+	}
+
+	vec3 extent = node.boundsMax - node.boundsMin;
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+	int middle = first + count / 2;
+
+	nth_element(triangleIndices.begin() + first, triangleIndices.begin() + middle, triangleIndices.begin() + first + count,
+		[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+	build(first, middle - first, centers);
+	int right = build(middle, first + count - middle, centers);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+float TriangleBVH::boxDistance(const BVHNode& node, vec3 point) const
+{
+	vec3 outside = max(max(node.boundsMin - point, point - node.boundsMax), vec3(0));
+	return length(outside);
+}
+
+bool TriangleBVH::intersectBounds(const BVHNode& node, vec3 origin, vec3 inverseDirection) const
+{
+	vec3 tNear = (node.boundsMin - origin) * inverseDirection;
+	vec3 tFar = (node.boundsMax - origin) * inverseDirection;
+	vec3 tMin = min(tNear, tFar);
+	vec3 tMax = max(tNear, tFar);
+
+	float t0 = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+	float t1 = std::min(std::min(tMax.x, tMax.y), tMax.z);
+	return t0 <= t1;
+}
+
+// Closest point on a triangle by Voronoi regions (Ericson, Real-Time Collision Detection 5.1.5)
+vec3 TriangleBVH::closestPointOnTriangle(int triangle, vec3 p) const
+{
+	vec3 a = corners[triangle * 3];
+	vec3 b = corners[triangle * 3 + 1];
+	vec3 c = corners[triangle * 3 + 2];
+
+	vec3 ab = b - a;
+	vec3 ac = c - a;
+	vec3 ap = p - a;
+	float d1 = dot(ab, ap);
+	float d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	vec3 bp = p - b;
+	float d3 = dot(ab, bp);
+	float d4 = dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	vec3 cp = p - c;
+	float d5 = dot(ab, cp);
+	float d6 = dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denominator = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Moller-Trumbore, any hit in front of the origin counts
+bool TriangleBVH::intersectTriangle(int triangle, vec3 origin, vec3 direction) const
+{
+	vec3 a = corners[triangle * 3];
+	vec3 edge1 = corners[triangle * 3 + 1] - a;
+	vec3 edge2 = corners[triangle * 3 + 2] - a;
+
+	vec3 p = cross(direction, edge2);
+	float determinant = dot(edge1, p);
+	if (abs(determinant) < 1e-12f) return false;
+
+	float inverseDeterminant = 1.0f / determinant;
+	vec3 s = origin - a;
+	float u = dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f) return false;
+
+	vec3 q = cross(s, edge1);
+	float v = dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f) return false;
+
+	return dot(edge2, q) * inverseDeterminant > 0.0f;
+}
+
+// Unsigned distance to the closest triangle, nodes farther than the best hit so far are skipped
+float TriangleBVH::closestDistance(vec3 point) const
+{
+	if (nodes.empty()) return FLT_MAX;
+
+	float bestSquared = FLT_MAX;
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BVHNode& node = nodes[stack[--stackSize]];
+		float distance = boxDistance(node, point);
+		if (distance * distance >= bestSquared) continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				vec3 offset = point - closestPointOnTriangle(triangleIndices[i], point);
+				bestSquared = std::min(bestSquared, dot(offset, offset));
+			}
+		}
+		else
+		{
+			// Visit the nearer child first so the bound tightens early
+			int left = (int)(&node - &nodes[0]) + 1;
+			int right = node.first;
+			bool leftFirst = boxDistance(nodes[left], point) <= boxDistance(nodes[right], point);
+			stack[stackSize++] = leftFirst ? right : left;
+			stack[stackSize++] = leftFirst ? left : right;
+		}
+	}
+
+	return sqrt(bestSquared);
+}
+
+// Number of surface crossings along a ray, odd counts mean the origin is inside a closed mesh
+int TriangleBVH::countHits(vec3 origin, vec3 direction) const
+{
+	if (nodes.empty()) return 0;
+
+	vec3 inverseDirection = 1.0f / direction;
+	int hits = 0;
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int index = stack[--stackSize];
+		const BVHNode& node = nodes[index];
+		if (!intersectBounds(node, origin, inverseDirection)) continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				if (intersectTriangle(triangleIndices[i], origin, direction)) hits++;
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = index + 1;
+		}
+	}
+
+	return hits;
+}
+
+int TriangleBVH::getTriangleCount() const
+{
+	return (int)corners.size() / 3;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "global.h"
+
+struct BVHNode
+{
+	glm::vec3 boundsMin, boundsMax;
+	int first, count; // Leaves reference triangles, inner nodes keep the right child in first
+};
+
+// Bounding volume hierarchy over a triangle soup for CPU side distance and ray queries,
+// split at the median of the longest axis. Queries are const and safe to run from many threads.
+class TriangleBVH
+{
+
+private:
+
+	std::vector<glm::vec3> corners; // Three corners per triangle
+	std::vector<int> triangleIndices;
+	std::vector<BVHNode> nodes;
+
+	int build(int first, int count, const std::vector<glm::vec3>& centers);
+	float boxDistance(const BVHNode& node, glm::vec3 point) const;
+	bool intersectBounds(const BVHNode& node, glm::vec3 origin, glm::vec3 inverseDirection) const;
+	glm::vec3 closestPointOnTriangle(int triangle, glm::vec3 point) const;
+	bool intersectTriangle(int triangle, glm::vec3 origin, glm::vec3 direction) const;
+
+public:
+
+	TriangleBVH(const std::vector<glm::vec3>& corners);
+	~TriangleBVH();
+
+	float closestDistance(glm::vec3 point) const;
+	int countHits(glm::vec3 origin, glm::vec3 direction) const;
+
+	int getTriangleCount() const;
+
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "global.h"
+#include <cstring>
+
+// Parameters of a pass in a std140 uniform buffer at a fixed binding point. T has to follow the std140
+// layout, scalars only or vec4 aligned members, padded to a multiple of 16 bytes. Changing values costs
+// one buffer write the next time the block is bound, unchanged values cost nothing.
+template <typename T>
+class UniformBlock
+{
+
+private:
+
+	GLuint buffer = 0;
+	GLuint binding;
+	T data;
+	bool dirty = true;
+
+public:
+
+	UniformBlock(GLuint bindingPoint) : binding(bindingPoint)
+	{
+		static_assert(sizeof(T) % 16 == 0, "std140 blocks are padded to 16 bytes");
+
+		memset(&data, 0, sizeof(T));
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	~UniformBlock()
+	{
+		glDeleteBuffers(1, &buffer);
+	}
+
+	// Returns true while the block waits for an upload
+	bool set(const T& value)
+	{
+		if (memcmp(&data, &value, sizeof(T)) != 0)
+		{
+			data = value;
+			dirty = true;
+		}
+
+		return dirty;
+	}
+
+	void bind()
+	{
+		if (dirty)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			dirty = false;
+		}
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+
+	const T& get() const
+	{
+		return data;
+	}
+
+	GLuint getBufferId() const
+	{
+		return buffer;
+	}
+
+};
\ No newline at end of file
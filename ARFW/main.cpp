@@ -1,4 +1,6 @@
 #include "Scene.h"
+#include "HeadlessContext.h"
+#include <iomanip>
 
 std::string g_ExePath;
 int g_windowWidth = 1920;
@@ -14,13 +16,24 @@ void windowSizeCallback(GLFWwindow* window, int w, int h);
 void charCallback(GLFWwindow* window, unsigned int codepoint);
 void dropCallback(GLFWwindow* window, int count, const char** paths);
 void scrollCallback(GLFWwindow* window, double x, double y);
+int runHeadless(int frameCount, std::string outputPath, std::string sensorRecording);
 
 int main(int argc, char *argv[])
 {
 	std::string exePath(argv[0]);
 	g_ExePath = exePath.substr(0, exePath.find_last_of("\\/")) + "\\";
 
+	// ARFW --headless <frames> <output directory> [recording.oni]
+	if (argc >= 4 && std::string(argv[1]) == "--headless")
+	{
+		return runHeadless(atoi(argv[2]), argv[3], (argc >= 5) ? argv[4] : "");
+	}
+
 	glfwInit();
+#ifdef ARFW_EGL
+	// GLEW built with EGL loads its entry points through EGL, so the window context has to come from it too
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
 	GLFWwindow* window = glfwCreateWindow(g_windowWidth, g_windowHeight, "ARFW", NULL, NULL);
 	glfwMakeContextCurrent(window);
 	glfwSwapInterval(0);
@@ -58,6 +71,52 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+// Render farm and CI runs: an offscreen context without GUI and input, the scene is stepped at a fixed
+// interval for a number of frames and every final image is written as frame_0000.ppm, frame_0001.ppm, ...
+int runHeadless(int frameCount, std::string outputPath, std::string sensorRecording)
+{
+	HeadlessContext context;
+
+	if (!context.create(g_windowWidth, g_windowHeight))
+	{
+		std::cout << "Cannot create an offscreen OpenGL context" << std::endl;
+		return 1;
+	}
+
+	// The headless context is a 4.5 core profile, GLEW only loads all of its entry points this way
+	glewExperimental = GL_TRUE;
+	glewInit();
+
+	scene = new Scene();
+	scene->setFixedFrameTime(1.0f / 30.0f);
+	scene->initialize(nullptr, sensorRecording);
+
+	for (int i = 0; i < frameCount; i++)
+	{
+		scene->update();
+		scene->render(nullptr);
+
+		std::ostringstream filepath;
+		filepath << outputPath << "/frame_" << std::setw(4) << std::setfill('0') << i << ".ppm";
+
+		if (!scene->saveFinalImage(filepath.str()))
+		{
+			std::cout << "Frame " << i << " has no final image" << std::endl;
+		}
+	}
+
+	std::cout << "Rendered " << frameCount << " frames to " << outputPath << std::endl;
+
+	// Per pass timings of the run next to the frames
+	scene->getProfiler()->exportCSV(outputPath + "/profile.csv");
+	scene->getProfiler()->exportJSON(outputPath + "/profile.json");
+
+	delete scene;
+	context.destroy();
+
+	return 0;
+}
+
 static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -96,6 +155,7 @@ static void charCallback(GLFWwindow* window, unsigned int codepoint)
 
 static void dropCallback(GLFWwindow* window, int count, const char** paths)
 {
+	scene->dropCallback(count, paths);
 	guiScreen->dropCallbackEvent(count, paths);
 }
 
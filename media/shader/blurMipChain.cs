@@ -0,0 +1,118 @@
+#version 450
+
+// Builds the blurred mip chain of the light buffer in a single dispatch.
+// Every work group owns a 64x64 tile of mip 0 and reduces it down to mip 5 in shared memory.
+// Plain Gaussian weights without a depth term, the same as gaussianBlur.fs whose bilateral weight is disabled.
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (rgba16f, binding = 0) uniform writeonly image2D outMip[6];
+
+uniform sampler2D inColor;
+
+uniform int maxMipLevel = 5;
+uniform vec4 mipKernel[6];
+
+const int tileSize = 64;
+
+// Level 1 (32x32) and level 2 (16x16) are ping-ponged, odd levels use the first part
+shared vec4 levelData[32 * 32 + 16 * 16];
+
+int levelOffset(int level)
+{
+	return (level % 2 == 1) ? 0 : 32 * 32;
+}
+
+// Downsample level 0 directly from the input so its footprint can reach into neighbor tiles
+vec4 downsampleInput(ivec2 coord)
+{
+	ivec2 inputSize = textureSize(inColor, 0);
+	vec4 kernel = mipKernel[1];
+	vec4 value = vec4(0);
+
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			ivec2 sampleCoord = clamp(coord * 2 + ivec2(x - 1, y - 1), ivec2(0), inputSize - 1);
+			value += texelFetch(inColor, sampleCoord, 0) * kernel[x] * kernel[y];
+		}
+	}
+
+	return value;
+}
+
+// Downsample a level stored in shared memory, the footprint is clamped to the tile
+vec4 downsampleShared(int level, ivec2 coord)
+{
+	int size = tileSize >> (level - 1);
+	int offset = levelOffset(level - 1);
+	vec4 kernel = mipKernel[level];
+	vec4 value = vec4(0);
+
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			ivec2 sampleCoord = clamp(coord * 2 + ivec2(x - 1, y - 1), ivec2(0), ivec2(size - 1));
+			value += levelData[offset + sampleCoord.y * size + sampleCoord.x] * kernel[x] * kernel[y];
+		}
+	}
+
+	return value;
+}
+
+void storeMip(int level, ivec2 tileCoord, vec4 value)
+{
+	ivec2 coord = (ivec2(gl_WorkGroupID.xy) * tileSize >> level) + tileCoord;
+
+	if (all(lessThan(coord, imageSize(outMip[level]))))
+	{
+		imageStore(outMip[level], coord, value);
+	}
+}
+
+void main()
+{
+	ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * tileSize;
+	ivec2 inputSize = textureSize(inColor, 0);
+	int threadIndex = int(gl_LocalInvocationIndex);
+
+	// Mip 0 is a plain copy of the input
+	for (int i = threadIndex; i < tileSize * tileSize; i += 256)
+	{
+		ivec2 coord = tileOrigin + ivec2(i % tileSize, i / tileSize);
+
+		if (all(lessThan(coord, inputSize)))
+		{
+			imageStore(outMip[0], coord, texelFetch(inColor, coord, 0));
+		}
+	}
+
+	if (maxMipLevel < 1) return;
+
+	// Mip 1, four texels per thread
+	for (int i = threadIndex; i < 32 * 32; i += 256)
+	{
+		ivec2 tileCoord = ivec2(i % 32, i / 32);
+		vec4 value = downsampleInput((tileOrigin >> 1) + tileCoord);
+		levelData[levelOffset(1) + i] = value;
+		storeMip(1, tileCoord, value);
+	}
+
+	// Remaining mips stay in shared memory, threads drop out as the tile shrinks
+	for (int level = 2; level <= min(maxMipLevel, 5); level++)
+	{
+		memoryBarrierShared();
+		barrier();
+
+		int size = tileSize >> level;
+
+		if (threadIndex < size * size)
+		{
+			ivec2 tileCoord = ivec2(threadIndex % size, threadIndex / size);
+			vec4 value = downsampleShared(level, tileCoord);
+			levelData[levelOffset(level) + threadIndex] = value;
+			storeMip(level, tileCoord, value);
+		}
+	}
+}
\ No newline at end of file
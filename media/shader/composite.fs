@@ -9,6 +9,8 @@ uniform sampler2D backScene;
 uniform sampler2D dsColor;
 
 uniform float exposure = 1.0;
+uniform int realOnly = 0;
+uniform vec4 influenceRect = vec4(0, 0, 65536, 65536); // Pixel bounds of the region virtual objects can change
 
 float rgb2gray(vec3 color)
 {
@@ -18,15 +20,29 @@ float rgb2gray(vec3 color)
 
 void main()
 {
-	vec4 fullcolor = clamp(texture(fullScene, TexCoord), 0.0, 1.0);
-	vec4 backcolor = clamp(texture(backScene, TexCoord), 0.0, 1.0);
 	vec3 dscolor = texture(dsColor, TexCoord).rgb;
+	vec4 finalColor = vec4(dscolor, 0.0);
 	
-	vec4 finalColor = fullcolor;
-	vec3 objects = fullcolor.rgb;
-	vec3 background = dscolor * clamp(fullcolor.rgb / backcolor.rgb, 0, 1);
-	//vec3 background = (dscolor + fullcolor.rgb - backcolor.rgb);
-	finalColor.rgb = mix(objects, background, 1 - fullcolor.a);
+	// Tiles without any virtual influence keep the sensor color, full and back scene are equal there.
+	// The lighting passes only ran inside the influence rectangle, outside it is the same
+	bool influenced = all(greaterThanEqual(gl_FragCoord.xy, influenceRect.xy)) && all(lessThan(gl_FragCoord.xy, influenceRect.zw));
+	
+	if (realOnly == 0 && influenced)
+	{
+		vec4 fullcolor = clamp(texture(fullScene, TexCoord), 0.0, 1.0);
+		
+		finalColor = fullcolor;
+
+		// The back scene is only lit on edge tiles, fully virtual pixels never read it
+		if (fullcolor.a < 1.0)
+		{
+			vec4 backcolor = clamp(texture(backScene, TexCoord), 0.0, 1.0);
+			vec3 objects = fullcolor.rgb;
+			vec3 background = dscolor * clamp(fullcolor.rgb / backcolor.rgb, 0, 1);
+			//vec3 background = (dscolor + fullcolor.rgb - backcolor.rgb);
+			finalColor.rgb = mix(objects, background, 1 - fullcolor.a);
+		}
+	}
 	
 	//finalColor.rgb = fullcolor.rgb;
 	//finalColor.rgb = backcolor.rgb;
@@ -4,7 +4,7 @@ in vec2 TexCoord;
 
 layout (location = 0) out vec4 outColor;
 
-uniform sampler2D gPosition;
+uniform sampler2D gMaterial;
 uniform sampler2D gNormal;
 uniform sampler2D inLight;
 uniform sampler2D inReflection;
@@ -18,7 +18,7 @@ uniform float maxMipLevel = 5;
 
 void main()
 {
-	float roughness = texture(gPosition, TexCoord).a;
+	float roughness = texture(gMaterial, TexCoord).r;
     //float metallic = texture(gNormal, TexCoord).a;
 	vec4 light = texture(inLight, TexCoord);
 	//vec4 reflection = textureLod(inReflection, TexCoord, mipLevel);
@@ -26,7 +26,7 @@ void main()
 	//vec4 ao = textureLod(inAmbientOcclusion, TexCoord, mipLevel);
 	
 	float mRoughness = roughness;
-	//mRoughness = texture(gPosition, reflectionRay.xy).a; // sample rough parm at hitcoord
+	//mRoughness = texture(gMaterial, reflectionRay.xy).r; // sample rough parm at hitcoord
 	
 	//float distScaled = smoothstep(0.0, sharpness * pow(1 - mRoughness, sharpnessPower), reflectionRay.z);
 	float distScaled = smoothstep(0.0, sharpness, pow(reflectionRay.z, sharpnessPower));
@@ -0,0 +1,61 @@
+#version 450
+
+in vec2 TexCoord;
+
+layout (location = 0) out vec4 outColor;
+
+uniform sampler2D gMaterial;
+uniform sampler2D gNormal;
+uniform sampler2D inLight;
+uniform usampler2D inSummedArea;
+uniform sampler2D inReflectionRay;
+
+uniform float maxBoxRadius = 64; // Pixels, keeps every box sum below 2^32, see summedAreaTable.cs
+
+const float fixedPointScale = 255.0;
+
+// Summed area table lookup, everything above or left of the table sums to zero
+uvec4 fetchSum(ivec2 coord)
+{
+	if (coord.x < 0 || coord.y < 0) return uvec4(0);
+	return texelFetch(inSummedArea, coord, 0);
+}
+
+// Average of the inclusive box [minCoord, maxCoord] in 4 fetches, the unsigned differences undo the wrap around
+vec4 boxFilter(ivec2 minCoord, ivec2 maxCoord)
+{
+	uvec4 sum = fetchSum(maxCoord)
+		- fetchSum(ivec2(minCoord.x - 1, maxCoord.y))
+		- fetchSum(ivec2(maxCoord.x, minCoord.y - 1))
+		+ fetchSum(minCoord - 1);
+	
+	vec2 area = vec2(maxCoord - minCoord + 1);
+	return vec4(sum) / (area.x * area.y * fixedPointScale);
+}
+
+// Half angle of the cone that bounds the specular lobe, Phong power from the GGX alpha (Uludag, Hi-Z Screen-Space Cone-Traced Reflections)
+float coneTangent(float roughness)
+{
+	float alpha = max(roughness * roughness, 0.001);
+	float specularPower = 2.0 / (alpha * alpha) - 2.0;
+	float cosAngle = pow(0.244, 1.0 / (specularPower + 1.0));
+	return sqrt(1.0 - cosAngle * cosAngle) / cosAngle;
+}
+
+void main()
+{
+	float roughness = texture(gMaterial, TexCoord).r;
+	vec4 reflectionRay = texture(inReflectionRay, TexCoord);
+	
+	ivec2 tableSize = textureSize(inSummedArea, 0);
+	vec2 center = TexCoord * vec2(tableSize);
+	
+	// The cone widens along the screen space ray, its radius at the hit point is the box size
+	float rayLength = length((reflectionRay.xy - TexCoord) * vec2(tableSize));
+	vec2 halfSize = vec2(clamp(rayLength * coneTangent(roughness), 0.5, maxBoxRadius));
+	
+	ivec2 minCoord = clamp(ivec2(floor(center - halfSize)), ivec2(0), tableSize - 1);
+	ivec2 maxCoord = clamp(ivec2(ceil(center + halfSize)) - 1, minCoord, tableSize - 1);
+	
+	outColor = boxFilter(minCoord, maxCoord);
+}
\ No newline at end of file
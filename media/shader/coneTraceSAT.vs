@@ -0,0 +1,15 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texcoord;
+
+out vec2 TexCoord;
+
+#include "tiles.glsl"
+
+void main()
+{
+	vec2 vertexTexcoord = (useTiles == 1) ? tileTexcoord() : texcoord;
+    gl_Position = vec4(vertexTexcoord * 2.0 - 1.0, 0.0, 1.0);
+	TexCoord = vertexTexcoord;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+
+// Replicates every cube triangle into the selected cubemap faces, a whole level is rendered with one draw
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+uniform mat4 projection;
+uniform mat4 captureViews[6];
+uniform int firstFace = 0;
+uniform int faceCount = 6;
+
+in vec3 gsWorldPos[];
+
+out vec3 WorldPos;
+
+void main()
+{
+	for (int face = firstFace; face < firstFace + faceCount; face++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			gl_Layer = face;
+			WorldPos = gsWorldPos[i];
+			gl_Position = projection * captureViews[face] * vec4(WorldPos, 1.0);
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+
+out vec3 gsWorldPos;
+
+// Face projection happens in the geometry shader
+void main()
+{
+	gsWorldPos = position;
+	gl_Position = vec4(position, 1.0);
+}
\ No newline at end of file
@@ -9,9 +9,16 @@ uniform sampler2D dsColor;
 uniform sampler2D dsDepth;
 
 uniform int isVertical = 0;
-uniform int kernelRadius = 4;
 uniform float kernel[128];
-uniform float bsigma = 0.1;
+
+layout (std140, binding = 15) uniform SensorParameters
+{
+	int temporalKernelRadius;
+	int temporalFrameLayers;
+	int fillKernelRadius;
+	int blurKernelRadius;
+	float blurBSigma;
+};
 
 float normpdf(float x, float s)
 {
@@ -32,12 +39,12 @@ void main()
 	float accumValue = 0;
 	float accumWeight = 0;
 	
-	for (int i = -kernelRadius; i <= kernelRadius; i++)
+	for (int i = -blurKernelRadius; i <= blurKernelRadius; i++)
 	{
 		vec2 sampleCoord = TexCoord + i * texelSize;
 		float sampleValue = texture(dsDepth, sampleCoord).r;
-		//float sampleWeight = kernel[kernelRadius + i];
-		float sampleWeight = normpdf(dsdepth - sampleValue, bsigma) * kernel[kernelRadius + i];
+		//float sampleWeight = kernel[blurKernelRadius + i];
+		float sampleWeight = normpdf(dsdepth - sampleValue, blurBSigma) * kernel[blurKernelRadius + i];
 		
 		accumValue += sampleValue * sampleWeight;
 		accumWeight += sampleWeight;
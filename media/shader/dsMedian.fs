@@ -8,7 +8,14 @@ layout (location = 1) out float dsOutDepth;
 uniform sampler2D dsColor;
 uniform sampler2D dsDepth;
 
-uniform int kernelRadius = 10;
+layout (std140, binding = 15) uniform SensorParameters
+{
+	int temporalKernelRadius;
+	int temporalFrameLayers;
+	int fillKernelRadius;
+	int blurKernelRadius;
+	float blurBSigma;
+};
 
 /*vec3 RGBToXYZ(vec3 inColor)
 {
@@ -35,9 +42,9 @@ void main()
 		// Find mean within 3D kernel
 		float meanDepth = 0;
 		float validDepth = 0;
-		for (int i = -kernelRadius; i <= kernelRadius; i++)
+		for (int i = -fillKernelRadius; i <= fillKernelRadius; i++)
 		{
-			for (int j = -kernelRadius; j <= kernelRadius; j++)
+			for (int j = -fillKernelRadius; j <= fillKernelRadius; j++)
 			{
 				vec2 offset = TexCoord + vec2(i, j) * texelSize;
 				float offsetDepth = texture(dsDepth, offset).r;
@@ -57,9 +64,9 @@ void main()
 		
 		// Find value closest to mean and set as result
 		float bestDepth = 0, bestDiff = 1;
-		for (int i = -kernelRadius; i <= kernelRadius; i++)
+		for (int i = -fillKernelRadius; i <= fillKernelRadius; i++)
 		{
-			for (int j = -kernelRadius; j <= kernelRadius; j++)
+			for (int j = -fillKernelRadius; j <= fillKernelRadius; j++)
 			{
 				vec2 offset = TexCoord + vec2(i, j) * texelSize;
 				float offsetDepth = texture(dsDepth, offset).r;
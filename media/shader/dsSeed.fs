@@ -0,0 +1,38 @@
+#version 450
+
+in vec2 TexCoord;
+
+layout (location = 0) out vec2 outDsNormal;
+layout (location = 1) out vec4 outDsColor;
+
+#include "gbuffer.glsl"
+
+uniform sampler2D dsPosition;
+uniform sampler2D dsNormal;
+uniform sampler2D dsColor;
+
+// Sensor pixels without a measurement go to the far plane
+float viewPositionToDepth(vec3 position)
+{
+	if (position.z >= 0.0) return 1.0;
+
+	vec4 clipPosition = kinectProjection * vec4(position, 1.0);
+	return clamp(clipPosition.z / clipPosition.w * 0.5 + 0.5, 0.0, 1.0);
+}
+
+// Resamples the filtered sensor maps to the buffer resolution once per sensor frame,
+// the depth goes to a depth attachment the gPass can be seeded with
+void main()
+{
+	vec3 dsposition = texture(dsPosition, TexCoord).rgb;
+	vec3 dsnormal = texture(dsNormal, TexCoord).rgb;
+	vec4 dscolor = texture(dsColor, TexCoord);
+	
+	// Convert sensor colors to linear space, alpha 0 marks real pixels
+	dscolor.rgb = pow(dscolor.rgb, vec3(2.2));
+	dscolor.a = 0;
+	
+	gl_FragDepth = viewPositionToDepth(dsposition);
+	outDsNormal = encodeNormal(dsnormal);
+	outDsColor = dscolor;
+}
\ No newline at end of file
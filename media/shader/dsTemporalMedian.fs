@@ -8,8 +8,14 @@ layout (location = 1) out float dsOutDepth;
 uniform sampler2D dsColor;
 uniform sampler2DArray dsDepth;
 
-uniform int kernelRadius = 1;
-uniform int frameLayers;
+layout (std140, binding = 15) uniform SensorParameters
+{
+	int temporalKernelRadius;
+	int temporalFrameLayers;
+	int fillKernelRadius;
+	int blurKernelRadius;
+	float blurBSigma;
+};
 
 void main()
 {
@@ -18,7 +24,7 @@ void main()
 	float dsdepth = texture(dsDepth, vec3(TexCoord, 0)).r;
 	
 	vec2 texelSize = 1.0 / textureSize(dsDepth, 0).xy;
-	//frameLayers = textureSize(dsDepth, 0).z;
+	//temporalFrameLayers = textureSize(dsDepth, 0).z;
 	
 	
 	// Temporal median filter
@@ -27,11 +33,11 @@ void main()
 		// Find mean within 3D kernel
 		float meanDepth = 0;
 		float validDepth = 0;
-		for (int i = -kernelRadius; i <= kernelRadius; i++)
+		for (int i = -temporalKernelRadius; i <= temporalKernelRadius; i++)
 		{
-			for (int j = -kernelRadius; j <= kernelRadius; j++)
+			for (int j = -temporalKernelRadius; j <= temporalKernelRadius; j++)
 			{
-				for (int k = 0; k < frameLayers; k++)
+				for (int k = 0; k < temporalFrameLayers; k++)
 				{
 					vec3 offset = vec3(TexCoord + vec2(i, j) * texelSize, k);
 					float offsetDepth = texture(dsDepth, offset).r;
@@ -48,11 +54,11 @@ void main()
 		
 		// Find value closest to mean and set as result
 		float bestDepth = 0, bestDiff = 1;
-		for (int i = -kernelRadius; i <= kernelRadius; i++)
+		for (int i = -temporalKernelRadius; i <= temporalKernelRadius; i++)
 		{
-			for (int j = -kernelRadius; j <= kernelRadius; j++)
+			for (int j = -temporalKernelRadius; j <= temporalKernelRadius; j++)
 			{
-				for (int k = 0; k < frameLayers; k++)
+				for (int k = 0; k < temporalFrameLayers; k++)
 				{
 					vec3 offset = vec3(TexCoord + vec2(i, j) * texelSize, k);
 					float offsetDepth = texture(dsDepth, offset).r;
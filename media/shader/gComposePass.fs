@@ -2,63 +2,76 @@
 
 in vec2 TexCoord;
 
-layout (location = 0) out vec4 gPosition;
-layout (location = 1) out vec4 gNormal;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gMaterial;
 layout (location = 2) out vec4 gColor;
-layout (location = 3) out vec4 outDsPosition;
-layout (location = 4) out vec4 outDsNormal;
-layout (location = 5) out vec4 outDsColor;
+layout (location = 3) out vec2 gMotion;
+layout (location = 4) out vec4 gTransfer;
 
-uniform sampler2D inPosition;
+#include "gbuffer.glsl"
+
+uniform sampler2D inDepth;
 uniform sampler2D inNormal;
 uniform sampler2D inColor;
-uniform sampler2D dsPosition;
+uniform sampler2D dsDepth;
 uniform sampler2D dsNormal;
 uniform sampler2D dsColor;
+uniform sampler2D inMotion;
+uniform sampler2D inTransfer;
+uniform sampler2D inMaterial;
 
-uniform float bgRoughness = 0.5;
-uniform float bgMetallic = 0.5;
+layout (std140, binding = 12) uniform MaterialParameters
+{
+	float roughness;
+	float metallic;
+	float bgRoughness;
+	float bgMetallic;
+};
 
 void main()
 {
-	vec4 position = texture(inPosition, TexCoord);
-    vec4 normal = texture(inNormal, TexCoord);
-    vec4 color = texture(inColor, TexCoord);
+	float depth = texture(inDepth, TexCoord).r;
+	vec3 position = depthToViewPosition(depth, TexCoord);
+	vec2 normal = texture(inNormal, TexCoord).xy;
+	vec4 material = texture(inMaterial, TexCoord);
+	vec4 color = texture(inColor, TexCoord); // Already linear, sampled from the sRGB target
 	
-	// Depth sensor outputs
-	vec3 dsposition = texture(dsPosition, TexCoord).rgb;
-	vec3 dsnormal = texture(dsNormal, TexCoord).rgb;
+	// Depth sensor outputs, already resampled to the buffer resolution by the seed pass
+	float dsdepth = texture(dsDepth, TexCoord).r;
+	vec3 dsposition = depthToViewPosition(dsdepth, TexCoord);
+	vec2 dsnormal = texture(dsNormal, TexCoord).xy;
 	vec4 dscolor = texture(dsColor, TexCoord);
-	dscolor.a = 0;
 	
 	// Mix gBuffer and kinect position and color
-	vec4 mixPosition = position;
-	vec4 mixNormal = normal;
+	float mixDepth = depth;
+	vec2 mixNormal = normal;
+	vec4 mixMaterial = material;
 	vec4 mixColor = color;
 	
-	if (mixPosition.z < dsposition.z)
+	if (position.z < dsposition.z)
 	{
-		mixPosition.xyz = dsposition;
-		mixNormal.xyz = dsnormal;
 		mixColor = vec4(dscolor.rgb, 0);
 	}
 	
 	if (mixColor.a == 0)
 	{
-		mixPosition = vec4(dsposition, bgRoughness);
-		mixNormal = vec4(dsnormal, bgMetallic);
+		mixDepth = dsdepth;
+		mixNormal = dsnormal;
+		mixMaterial = vec4(bgRoughness, bgMetallic, 0, 0);
 		mixColor.rgb = dscolor.rgb;
+
+		// Sensor pixels stay fixed on screen, the camera only moves the virtual layer
+		gMotion = vec2(0);
+		gTransfer = vec4(0);
+	}
+	else
+	{
+		gMotion = texture(inMotion, TexCoord).xy;
+		gTransfer = texture(inTransfer, TexCoord);
 	}
 	
-	// Convert colors to linear space
-	mixColor.rgb = pow(mixColor.rgb, vec3(2.2));
-	dscolor.rgb = pow(dscolor.rgb, vec3(2.2));
-	
-	gPosition = mixPosition;
+	gl_FragDepth = mixDepth;
 	gNormal = mixNormal;
+	gMaterial = mixMaterial;
 	gColor = mixColor;
-	
-	outDsPosition = vec4(dsposition, bgRoughness);
-	outDsNormal = vec4(dsnormal, bgMetallic);
-	outDsColor = dscolor;
 }
\ No newline at end of file
@@ -3,24 +3,45 @@
 in vec3 Position;
 in vec2 TexCoord;
 in vec3 Normal;
+in vec4 ClipPosition;
+in vec4 ClipPositionPrevious;
+flat in vec4 InstanceAlbedo;
+flat in vec4 InstanceMaterial;
 
-layout (location = 0) out vec4 gPosition;
-layout (location = 1) out vec4 gNormal;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gMaterial;
 layout (location = 2) out vec4 gColor;
+layout (location = 3) out vec2 gMotion;
+layout (location = 4) out vec4 gTransfer;
 
 uniform sampler2D diffuse1;
 uniform sampler2D normal1;
 uniform sampler2D specular1;
 
-uniform float roughness = 0.0;
-uniform float metallic = 0.0;
+uniform int useInstances = 0;
+
+layout (std140, binding = 12) uniform MaterialParameters
+{
+	float roughness;
+	float metallic;
+	float bgRoughness;
+	float bgMetallic;
+};
+
+#include "gbuffer.glsl"
 
 void main()
 {
-	vec3 position = Position;
-	vec4 color = texture(diffuse1, TexCoord);
+	vec4 color = texture(diffuse1, TexCoord) * InstanceAlbedo;
 	
-	gPosition = vec4(position, roughness);
-	gNormal = vec4(normalize(Normal), metallic);
+	// The color target is sRGB, the texture value is stored as is and sampled back linear
+	gNormal = encodeNormal(normalize(Normal));
+	gMaterial = (useInstances == 1) ? vec4(InstanceMaterial.xy, 0, 0) : vec4(roughness, metallic, 0, 0);
 	gColor = color;
+
+	// Screen space motion in texture coordinates, current minus previous
+	gMotion = (ClipPosition.xy / ClipPosition.w - ClipPositionPrevious.xy / ClipPositionPrevious.w) * 0.5;
+
+	// No baked transfer, the lighting pass uses its own irradiance
+	gTransfer = vec4(0);
 }
\ No newline at end of file
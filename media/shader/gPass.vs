@@ -7,6 +7,10 @@ layout (location = 2) in vec3 normal;
 out vec3 Position;
 out vec2 TexCoord;
 out vec3 Normal;
+out vec4 ClipPosition;
+out vec4 ClipPositionPrevious;
+flat out vec4 InstanceAlbedo;
+flat out vec4 InstanceMaterial;
 
 layout (std140, binding = 9) uniform MatCam
 {
@@ -18,15 +22,67 @@ layout (std140, binding = 9) uniform MatCam
 	mat4 kinectProjectionInverse;
 };
 
+layout (std140, binding = 10) uniform MatCamPrevious
+{
+	mat4 viewPrevious;
+};
+
 uniform mat4 model;
 uniform mat4 modelInverse;
+uniform mat4 modelPrevious;
+
+// Spawned objects are drawn instanced, their transform and material come from the instance list
+struct Instance
+{
+	mat4 model;
+	mat4 modelInverse;
+	vec4 albedo;
+	vec4 material;
+	mat4 shRotationBand1;
+	float shRotationBand2[28];
+};
+
+layout (std430, binding = 8) readonly buffer InstanceList
+{
+	Instance instances[];
+};
+
+// Instances that survived frustum culling, gl_InstanceID indexes this list
+layout (std430, binding = 9) readonly buffer VisibleInstanceList
+{
+	uint visibleInstances[];
+};
+
+uniform int useInstances = 0;
 
 void main()
 {
-	vec4 viewPos = view * model * vec4(position, 1.0);
+	vec4 viewPos;
+
+	if (useInstances == 1)
+	{
+		// Instances never move, the inverse is precomputed once per placement
+		Instance instance = instances[visibleInstances[gl_InstanceID]];
+		viewPos = view * instance.model * vec4(position, 1.0);
+		Normal = transpose(mat3(viewInverse)) * transpose(mat3(instance.modelInverse)) * normal;
+		ClipPositionPrevious = kinectProjection * viewPrevious * instance.model * vec4(position, 1.0);
+		InstanceAlbedo = instance.albedo;
+		InstanceMaterial = instance.material;
+	}
+	else
+	{
+		viewPos = view * model * vec4(position, 1.0);
+		Normal = mat3(transpose(inverse(view * model))) * normal;
+		//Normal = mat3(transpose(modelInverse)) * normal;
+		ClipPositionPrevious = kinectProjection * viewPrevious * modelPrevious * vec4(position, 1.0);
+		InstanceAlbedo = vec4(1);
+		InstanceMaterial = vec4(0);
+	}
+
 	Position = viewPos.xyz;
-	Normal = mat3(transpose(inverse(view * model))) * normal;
-	//Normal = mat3(transpose(modelInverse)) * normal;
 	TexCoord = texcoord;
 	gl_Position = kinectProjection * viewPos;
+
+	// Both clip positions are interpolated so the motion is exact per pixel
+	ClipPosition = gl_Position;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 450
+
+in vec3 Position;
+in vec2 TexCoord;
+in vec3 Normal;
+in vec4 ClipPosition;
+in vec4 ClipPositionPrevious;
+flat in vec4 InstanceAlbedo;
+flat in vec4 InstanceMaterial;
+in vec4 Transfer;
+
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gMaterial;
+layout (location = 2) out vec4 gColor;
+layout (location = 3) out vec2 gMotion;
+layout (location = 4) out vec4 gTransfer;
+
+uniform sampler2D diffuse1;
+uniform sampler2D normal1;
+uniform sampler2D specular1;
+
+uniform int useInstances = 0;
+
+layout (std140, binding = 12) uniform MaterialParameters
+{
+	float roughness;
+	float metallic;
+	float bgRoughness;
+	float bgMetallic;
+};
+
+#include "gbuffer.glsl"
+
+void main()
+{
+	vec4 color = texture(diffuse1, TexCoord) * InstanceAlbedo;
+	
+	// The color target is sRGB, the texture value is stored as is and sampled back linear
+	gNormal = encodeNormal(normalize(Normal));
+	gMaterial = (useInstances == 1) ? vec4(InstanceMaterial.xy, 0, 0) : vec4(roughness, metallic, 0, 0);
+	gColor = color;
+
+	// Screen space motion in texture coordinates, current minus previous
+	gMotion = (ClipPosition.xy / ClipPosition.w - ClipPositionPrevious.xy / ClipPositionPrevious.w) * 0.5;
+
+	// Precomputed radiance transfer, alpha marks pixels whose irradiance is already self shadowed
+	gTransfer = Transfer;
+}
\ No newline at end of file
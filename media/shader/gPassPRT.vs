@@ -0,0 +1,139 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texcoord;
+layout (location = 2) in vec3 normal;
+layout (location = 3) in vec3 transfer0;
+layout (location = 4) in vec3 transfer1;
+layout (location = 5) in vec3 transfer2;
+
+out vec3 Position;
+out vec2 TexCoord;
+out vec3 Normal;
+out vec4 ClipPosition;
+out vec4 ClipPositionPrevious;
+flat out vec4 InstanceAlbedo;
+flat out vec4 InstanceMaterial;
+out vec4 Transfer;
+
+layout (std140, binding = 9) uniform MatCam
+{
+    mat4 projection;
+	mat4 projectionInverse;
+    mat4 view;
+	mat4 viewInverse;
+	mat4 kinectProjection;
+	mat4 kinectProjectionInverse;
+};
+
+layout (std140, binding = 10) uniform MatCamPrevious
+{
+	mat4 viewPrevious;
+};
+
+layout (std140, binding = 11) uniform SHIrradiance
+{
+	vec4 shCoefficients[9];
+	int useSHIrradiance;
+};
+
+uniform mat4 model;
+uniform mat4 modelInverse;
+uniform mat4 modelPrevious;
+
+// Spawned objects are drawn instanced, their transform and material come from the instance list
+struct Instance
+{
+	mat4 model;
+	mat4 modelInverse;
+	vec4 albedo;
+	vec4 material;
+	mat4 shRotationBand1;
+	float shRotationBand2[28];
+};
+
+layout (std430, binding = 8) readonly buffer InstanceList
+{
+	Instance instances[];
+};
+
+// Instances that survived frustum culling, gl_InstanceID indexes this list
+layout (std430, binding = 9) readonly buffer VisibleInstanceList
+{
+	uint visibleInstances[];
+};
+
+uniform int useInstances = 0;
+
+// Object to world rotation of the baked transfer, band 2 is row major
+uniform mat3 shRotationBand1;
+uniform float shRotationBand2[25];
+
+mat3 transferRotationBand1()
+{
+	return (useInstances == 1) ? mat3(instances[visibleInstances[gl_InstanceID]].shRotationBand1) : shRotationBand1;
+}
+
+float transferRotationBand2(int index)
+{
+	return (useInstances == 1) ? instances[visibleInstances[gl_InstanceID]].shRotationBand2[index] : shRotationBand2[index];
+}
+
+// Self shadowed irradiance of the vertex, the transfer dotted with the environment SH
+vec3 transferIrradiance()
+{
+	float t[9] = float[9](transfer0.x, transfer0.y, transfer0.z, transfer1.x, transfer1.y, transfer1.z, transfer2.x, transfer2.y, transfer2.z);
+
+	vec3 band1 = transferRotationBand1() * vec3(t[3], t[1], t[2]);
+	vec3 irradiance = shCoefficients[0].rgb * t[0]
+		+ shCoefficients[1].rgb * band1.y
+		+ shCoefficients[2].rgb * band1.z
+		+ shCoefficients[3].rgb * band1.x;
+
+	for (int row = 0; row < 5; row++)
+	{
+		float value = 0.0;
+		for (int column = 0; column < 5; column++)
+		{
+			value += transferRotationBand2(row * 5 + column) * t[4 + column];
+		}
+		irradiance += shCoefficients[4 + row].rgb * value;
+	}
+
+	return max(irradiance, vec3(0));
+}
+
+void main()
+{
+	vec4 viewPos;
+
+	if (useInstances == 1)
+	{
+		// Instances never move, the inverse is precomputed once per placement
+		Instance instance = instances[visibleInstances[gl_InstanceID]];
+		viewPos = view * instance.model * vec4(position, 1.0);
+		Normal = transpose(mat3(viewInverse)) * transpose(mat3(instance.modelInverse)) * normal;
+		ClipPositionPrevious = kinectProjection * viewPrevious * instance.model * vec4(position, 1.0);
+		InstanceAlbedo = instance.albedo;
+		InstanceMaterial = instance.material;
+	}
+	else
+	{
+		viewPos = view * model * vec4(position, 1.0);
+		Normal = mat3(transpose(inverse(view * model))) * normal;
+		//Normal = mat3(transpose(modelInverse)) * normal;
+		ClipPositionPrevious = kinectProjection * viewPrevious * modelPrevious * vec4(position, 1.0);
+		InstanceAlbedo = vec4(1);
+		InstanceMaterial = vec4(0);
+	}
+
+	Position = viewPos.xyz;
+	TexCoord = texcoord;
+	gl_Position = kinectProjection * viewPos;
+
+	// Both clip positions are interpolated so the motion is exact per pixel
+	ClipPosition = gl_Position;
+
+	// Without SH lighting the lighting pass keeps its own irradiance
+	Transfer = (useSHIrradiance == 1) ? vec4(transferIrradiance(), 1.0) : vec4(0);
+}
\ No newline at end of file
@@ -3,11 +3,9 @@
 in vec2 TexCoord;
 
 layout (location = 0) out vec4 outColor;
-layout (location = 1) out vec4 outColor2;
 
 uniform sampler2D inColor;
-uniform sampler2D inColor2;
-uniform sampler2D inPosition;
+uniform sampler2D inDepth;
 
 uniform int isVertical = 0;
 uniform int mipLevel = 0;
@@ -28,9 +26,7 @@ void main()
 	if (mip == 0)
 	{
 		vec4 color = textureLod(inColor, TexCoord, mip);
-		vec4 color2 = textureLod(inColor2, TexCoord, mip);
 		outColor = color;
-		outColor2 = color2;
 		return;
 	}
 	
@@ -46,11 +42,8 @@ void main()
 		mip = mip - 1;
 	}
 	
-	float Z = texture(inPosition, TexCoord).z;
-	
 	// Gaussian filter
 	vec4 accumValue = vec4(0);
-	vec4 accumValue2 = vec4(0);
 	float accumWeight = 0;
 	
 	//kernelRadius = kernelRadius * mip;
@@ -59,20 +52,15 @@ void main()
 	{
 		vec2 sampleCoord = TexCoord + i * texelSize;
 		vec4 sampleValue = textureLod(inColor, sampleCoord, mip);
-		//float sampleZ = texture(inPosition, sampleCoord).z;
+		//float sampleZ = depthToViewPosition(inDepth, sampleCoord).z;
 		//float sampleWeight = normpdf(Z - sampleZ, bsigma) * kernel[kernelRadius + i];
 		float sampleWeight = kernel[kernelRadius + i];
 		
 		accumValue += sampleValue * sampleWeight;
 		accumWeight += sampleWeight;
-		
-		vec4 sampleValue2 = textureLod(inColor2, sampleCoord, mip);
-		accumValue2 += sampleValue2 * sampleWeight;
 	}
 	
 	vec4 finalColor = accumValue / accumWeight;
-	vec4 finalColor2 = accumValue2 / accumWeight;
 	
 	outColor = finalColor;
-	//outColor2 = finalColor2;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Camera matrices and the gBuffer encodings shared by every pass that reads or writes normals and depth
+
+layout (std140, binding = 9) uniform MatCam
+{
+    mat4 projection;
+	mat4 projectionInverse;
+    mat4 view;
+	mat4 viewInverse;
+	mat4 kinectProjection;
+	mat4 kinectProjectionInverse;
+};
+
+// Octahedral normal in [0, 1]
+vec2 encodeNormal(vec3 n)
+{
+	float length1 = abs(n.x) + abs(n.y) + abs(n.z);
+	if (length1 == 0.0) return vec2(0.5);
+
+	n /= length1;
+	vec2 p = n.xy;
+	if (n.z < 0.0) p = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return p * 0.5 + 0.5;
+}
+
+// Inverse of the octahedral normal encoding of the gBuffer
+vec3 decodeNormal(vec2 e)
+{
+	vec2 f = e * 2.0 - 1.0;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = max(-n.z, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+// View space position from the depth buffer, the gBuffer is rendered with the sensor projection and the far plane marks empty pixels
+vec3 depthToViewPosition(float depth, vec2 texcoord)
+{
+	if (depth >= 1.0) return vec3(0);
+
+	vec4 clipPosition = vec4(texcoord * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 viewPosition = kinectProjectionInverse * clipPosition;
+	return viewPosition.xyz / viewPosition.w;
+}
+
+vec3 depthToViewPosition(sampler2D depthMap, vec2 texcoord)
+{
+	return depthToViewPosition(texture(depthMap, texcoord).r, texcoord);
+}
\ No newline at end of file
@@ -0,0 +1 @@
+#include "cubeLayeredGeometry.glsl"
\ No newline at end of file
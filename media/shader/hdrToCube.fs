@@ -5,6 +5,7 @@ in vec3 WorldPos;
 out vec4 FragColor;
 
 uniform sampler2D colorMap;
+uniform int decodeGamma = 1;
 
 const vec2 invAtan = vec2(0.1591, 0.3183);
 vec2 SampleSphericalMap(vec3 v)
@@ -19,7 +20,7 @@ void main()
 {		
     vec2 uv = SampleSphericalMap(normalize(WorldPos));
     vec3 color = texture(colorMap, uv).rgb;
-	color = pow(color, vec3(2.2));
+	if (decodeGamma == 1) color = pow(color, vec3(2.2));
     
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#version 450
+
+// One thread per froxel, every light sphere is tested against the view space bounds of the cluster.
+// Lights are streamed through shared memory in batches, so each one is read once per work group.
+layout (local_size_x = 64) in;
+
+layout (std140, binding = 9) uniform MatCam
+{
+    mat4 projection;
+	mat4 projectionInverse;
+    mat4 view;
+	mat4 viewInverse;
+	mat4 kinectProjection;
+	mat4 kinectProjectionInverse;
+};
+
+struct PointLight
+{
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout (std430, binding = 6) readonly buffer LightData
+{
+	PointLight lights[];
+};
+
+// Per cluster the light count followed by maxLightsPerCluster light indices
+layout (std430, binding = 7) writeonly buffer ClusterLights
+{
+	uint clusterData[];
+};
+
+uniform ivec3 clusterCount;
+uniform int maxLightsPerCluster;
+uniform int lightCount;
+uniform float clusterNear;
+uniform float clusterFar;
+
+shared vec4 batchLights[64];
+
+float sliceDepth(int slice)
+{
+	return clusterNear * pow(clusterFar / clusterNear, float(slice) / float(clusterCount.z));
+}
+
+// View space point at the given depth along the ray through a screen position
+vec3 screenToView(vec2 ndc, float depth)
+{
+	vec4 nearPoint = kinectProjectionInverse * vec4(ndc, -1.0, 1.0);
+	vec3 direction = nearPoint.xyz / nearPoint.w;
+	return direction * (depth / -direction.z);
+}
+
+void main()
+{
+	int clusterIndex = int(gl_GlobalInvocationID.x);
+	bool isValid = clusterIndex < clusterCount.x * clusterCount.y * clusterCount.z;
+	ivec3 cluster = ivec3(clusterIndex % clusterCount.x, (clusterIndex / clusterCount.x) % clusterCount.y, clusterIndex / (clusterCount.x * clusterCount.y));
+
+	// Bounds of the eight froxel corners
+	vec2 ndcMin = vec2(cluster.xy) / vec2(clusterCount.xy) * 2.0 - 1.0;
+	vec2 ndcMax = vec2(cluster.xy + 1) / vec2(clusterCount.xy) * 2.0 - 1.0;
+	float depthNear = sliceDepth(cluster.z);
+	float depthFar = sliceDepth(cluster.z + 1);
+
+	vec3 boundsMin = vec3(1e30);
+	vec3 boundsMax = vec3(-1e30);
+
+	for (int i = 0; i < 8; i++)
+	{
+		vec2 ndc = vec2(((i & 1) != 0) ? ndcMax.x : ndcMin.x, ((i & 2) != 0) ? ndcMax.y : ndcMin.y);
+		vec3 corner = screenToView(ndc, ((i & 4) != 0) ? depthFar : depthNear);
+		boundsMin = min(boundsMin, corner);
+		boundsMax = max(boundsMax, corner);
+	}
+
+	uint count = 0u;
+	uint base = uint(clusterIndex * (maxLightsPerCluster + 1));
+	int threadIndex = int(gl_LocalInvocationIndex);
+
+	for (int batch = 0; batch < lightCount; batch += 64)
+	{
+		if (batch + threadIndex < lightCount)
+		{
+			vec4 light = lights[batch + threadIndex].positionRadius;
+			batchLights[threadIndex] = vec4((view * vec4(light.xyz, 1.0)).xyz, light.w);
+		}
+
+		memoryBarrierShared();
+		barrier();
+
+		int batchSize = min(64, lightCount - batch);
+
+		for (int i = 0; i < batchSize && isValid; i++)
+		{
+			// Sphere against box through the closest point of the box
+			vec4 light = batchLights[i];
+			vec3 offset = clamp(light.xyz, boundsMin, boundsMax) - light.xyz;
+
+			if (dot(offset, offset) <= light.w * light.w && count < uint(maxLightsPerCluster))
+			{
+				clusterData[base + 1u + count] = uint(batch + i);
+				count++;
+			}
+		}
+
+		barrier();
+	}
+
+	if (isValid) clusterData[base] = count;
+}
\ No newline at end of file
@@ -5,45 +5,223 @@ in vec2 TexCoord;
 layout (location = 0) out vec4 outColor;
 //layout (location = 1) out vec4 outReflection;
 
-layout (std140, binding = 9) uniform MatCam
-{
-    mat4 projection;
-	mat4 projectionInverse;
-    mat4 view;
-	mat4 viewInverse;
-	mat4 kinectProjection;
-	mat4 kinectProjectionInverse;
-};
+#include "gbuffer.glsl"
 
 //uniform vec2 bufferSize = vec2(1920, 1080);
 //uniform vec2 texelSize = 1.0 / vec2(1920, 1080);
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gColor;
 uniform sampler2D aoMap;
 uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
+uniform sampler2D prefilterOctMap;
+uniform int useOctahedralPrefilter = 0;
 uniform sampler2D brdfLUT;
 uniform sampler2D reflectionMap;
-uniform sampler2D reflectanceMap;
+uniform sampler2D gMaterial;
+uniform sampler2D transferMap;
+uniform int useTransferMap = 0;
+
+#include "sh.glsl"
+
+// Octahedral map with the poles along y, the compressed 2D layout of the prefiltered environment
+vec2 octahedralEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 p = n.xz;
+	if (n.y < 0.0) p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+	return p * 0.5 + 0.5;
+}
+
+vec3 samplePrefilter(vec3 R, float lod)
+{
+	if (useOctahedralPrefilter == 1) return textureLod(prefilterOctMap, octahedralEncode(normalize(R)), lod).rgb;
+	return textureLod(prefilterMap, R, lod).rgb;
+}
+
+// Virtual point lights, binned into view space clusters by lightClusters.cs
+
+struct PointLight
+{
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout (std430, binding = 6) readonly buffer LightData
+{
+	PointLight lights[];
+};
+
+layout (std430, binding = 7) readonly buffer ClusterLights
+{
+	uint clusterData[];
+};
+
+uniform int useClusteredLights = 0;
+uniform ivec3 clusterCount;
+uniform int maxLightsPerCluster;
+uniform float clusterNear;
+uniform float clusterFar;
+
+int clusterIndex(vec2 texCoord, float viewDepth)
+{
+	ivec2 tile = clamp(ivec2(texCoord * vec2(clusterCount.xy)), ivec2(0), clusterCount.xy - 1);
+	int slice = int(log(max(viewDepth, clusterNear) / clusterNear) / log(clusterFar / clusterNear) * float(clusterCount.z));
+	slice = clamp(slice, 0, clusterCount.z - 1);
+	return (slice * clusterCount.y + tile.y) * clusterCount.x + tile.x;
+}
 
 // PBR variables
 uniform vec3 cameraPosition;
 uniform vec3 lightPosition;
 uniform vec3 lightColor;
+uniform float lightIntensity = 1.0;
+uniform int useDirectLight = 0;
 
 const float pi = 3.1415926;
 
-// Helper functions
+// Cached shadow map of the virtual objects for the scene light
+
+uniform sampler2DShadow shadowMap;
+uniform mat4 lightViewProjection;
+uniform int useShadowMap = 0;
+uniform float shadowDepthBias = 0.0015;
+uniform float shadowNormalOffset = 0.01;
+
+// 3x3 hardware PCF, receivers outside the light frustum are lit
+float shadowVisibility(vec3 P, vec3 N)
+{
+	vec3 L = normalize(lightPosition);
+	vec3 offsetP = P + N * shadowNormalOffset * (1.0 - max(dot(N, L), 0.0));
+	vec4 lightClip = lightViewProjection * vec4(offsetP, 1.0);
+	vec3 coord = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+
+	if (any(lessThan(coord, vec3(0))) || any(greaterThan(coord, vec3(1)))) return 1.0;
+
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+	float visibility = 0.0;
+
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			visibility += texture(shadowMap, vec3(coord.xy + vec2(x, y) * texelSize, coord.z - shadowDepthBias));
+		}
+	}
+
+	return visibility / 9.0;
+}
+
+// Distance fields of virtual models, shadows and occlusion onto sensor pixels
 
-vec3 depthToViewPosition(float depth, vec2 texcoord)
+struct DistanceField
 {
-    vec4 clipPosition = vec4(texcoord * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
-    vec4 viewPosition = projectionInverse * clipPosition;
-    return viewPosition.xyz / viewPosition.w;
+	sampler3D volume;
+	vec3 boundsMin;
+	vec3 boundsMax;
+	float distanceRange;
+};
+
+const int maxDistanceFields = 4;
+const int maxDistanceFieldInstances = 32;
+
+uniform DistanceField distanceFields[maxDistanceFields];
+uniform mat4 instanceWorldToLocal[maxDistanceFieldInstances];
+uniform float instanceScale[maxDistanceFieldInstances];
+uniform int instanceField[maxDistanceFieldInstances];
+uniform int distanceFieldInstanceCount = 0;
+uniform float distanceFieldShadowStrength = 0.6;
+uniform float distanceFieldShadowSoftness = 8.0;
+uniform float distanceFieldOcclusionStrength = 1.0;
+uniform float distanceFieldInfluence = 0.3;
+
+// Model space distance, outside the volume only the distance to the box is trusted
+float fieldDistance(int field, vec3 p)
+{
+	vec3 boundsMin = distanceFields[field].boundsMin;
+	vec3 boundsMax = distanceFields[field].boundsMax;
+	vec3 uvw = clamp((p - boundsMin) / (boundsMax - boundsMin), 0.0, 1.0);
+	float distance = texture(distanceFields[field].volume, uvw).r * distanceFields[field].distanceRange;
+
+	float boxDistance = length(max(max(boundsMin - p, p - boundsMax), vec3(0)));
+	return (boxDistance > 0.0) ? max(boxDistance, distance - boxDistance) : distance;
+}
+
+// Strongest direction of the environment from the first SH band, the scene light otherwise
+vec3 dominantLightDirection()
+{
+	if (useSHIrradiance == 1)
+	{
+		vec3 luminance = vec3(0.2126, 0.7152, 0.0722);
+		vec3 direction = vec3(dot(shCoefficients[3].rgb, luminance), dot(shCoefficients[1].rgb, luminance), dot(shCoefficients[2].rgb, luminance));
+		if (length(direction) > 1e-4) return normalize(direction);
+	}
+
+	return normalize(lightPosition);
 }
 
+// Soft shadow (Quilez) times occlusion along the normal (Evans), traced in model space of every instance.
+// Pixels outside the influence region of an instance skip it, so the cost follows the affected pixels.
+float distanceFieldVisibility(vec3 P, vec3 N)
+{
+	vec3 L = dominantLightDirection();
+	float shadow = 1.0;
+	float occlusion = 0.0;
+
+	for (int i = 0; i < distanceFieldInstanceCount; i++)
+	{
+		int field = instanceField[i];
+		float scale = instanceScale[i];
+		vec3 p = (instanceWorldToLocal[i] * vec4(P, 1)).xyz;
+		vec3 n = normalize(mat3(instanceWorldToLocal[i]) * N);
+		vec3 l = normalize(mat3(instanceWorldToLocal[i]) * L);
+
+		float boxDistance = length(max(max(distanceFields[field].boundsMin - p, p - distanceFields[field].boundsMax), vec3(0)));
+		if (boxDistance * scale > distanceFieldInfluence) continue;
+
+		// Shadow ray until it leaves the padded bounds
+		vec3 tNear = (distanceFields[field].boundsMin - p) / l;
+		vec3 tFar = (distanceFields[field].boundsMax - p) / l;
+		vec3 tMin = min(tNear, tFar);
+		vec3 tMax = max(tNear, tFar);
+		float tEnter = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+		float tExit = min(min(tMax.x, tMax.y), tMax.z);
+
+		float epsilon = 0.002 / scale;
+		float t = max(tEnter, 0.01 / scale);
+
+		for (int step = 0; step < 32 && t < tExit; step++)
+		{
+			float distance = fieldDistance(field, p + l * t);
+			shadow = min(shadow, distanceFieldShadowSoftness * distance / t);
+			if (shadow < 0.01) break;
+			t += max(distance, epsilon);
+		}
+
+		// Five taps along the normal, closer taps weigh more
+		float weight = 1.0;
+		float totalWeight = 0.0;
+		float instanceOcclusion = 0.0;
+
+		for (int k = 1; k <= 5; k++)
+		{
+			float h = distanceFieldInfluence * 0.2 * k / scale;
+			instanceOcclusion += weight * max(h - fieldDistance(field, p + n * h), 0.0) / h;
+			totalWeight += weight;
+			weight *= 0.6;
+		}
+
+		occlusion = max(occlusion, instanceOcclusion / totalWeight);
+	}
+
+	float visibility = mix(1.0, clamp(shadow, 0.0, 1.0), distanceFieldShadowStrength);
+	return visibility * clamp(1.0 - occlusion * distanceFieldOcclusionStrength, 0.0, 1.0);
+}
+
+// Helper functions
+
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
 {
     //return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
@@ -55,7 +233,62 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }   
 
-vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao, float mRoughness, float mMetallic, out vec3 outEnvColor)
+float distributionGGX(float NdotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float denominator = NdotH * NdotH * (a2 - 1.0) + 1.0;
+	return a2 / (pi * denominator * denominator);
+}
+
+float geometrySmith(float NdotV, float NdotL, float roughness)
+{
+	float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+	return (NdotV / (NdotV * (1.0 - k) + k)) * (NdotL / (NdotL * (1.0 - k) + k));
+}
+
+// Cook-Torrance for a single light direction, the incoming radiance is already attenuated
+vec3 evaluateLight(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, vec3 F0, float mRoughness, float mMetallic)
+{
+	float NdotL = dot(N, L);
+	if (NdotL <= 0.0) return vec3(0);
+
+	float NdotV = max(dot(N, V), 1e-4);
+	vec3 H = normalize(V + L);
+	vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+	vec3 specular = distributionGGX(max(dot(N, H), 0.0), mRoughness) * geometrySmith(NdotV, NdotL, mRoughness) * F / (4.0 * NdotV * NdotL + 1e-4);
+	vec3 kD = (1.0 - F) * (1.0 - mMetallic);
+
+	return (kD * albedo / pi + specular) * radiance * NdotL;
+}
+
+// Cook-Torrance over the lights of one cluster, windowed inverse square falloff (Karis 2013)
+vec3 clusteredLighting(int cluster, vec3 P, vec3 N, vec3 V, vec3 albedo, vec3 F0, float mRoughness, float mMetallic)
+{
+	vec3 radiance = vec3(0);
+	uint base = uint(cluster * (maxLightsPerCluster + 1));
+	uint count = clusterData[base];
+
+	for (uint i = 0u; i < count; i++)
+	{
+		PointLight light = lights[clusterData[base + 1u + i]];
+		vec3 toLight = light.positionRadius.xyz - P;
+		float distanceSquared = max(dot(toLight, toLight), 1e-4);
+		float radiusSquared = light.positionRadius.w * light.positionRadius.w;
+
+		float window = clamp(1.0 - (distanceSquared * distanceSquared) / (radiusSquared * radiusSquared), 0.0, 1.0);
+		float attenuation = window * window / distanceSquared;
+
+		if (attenuation <= 0.0) continue;
+
+		vec3 L = toLight * inversesqrt(distanceSquared);
+		radiance += evaluateLight(N, V, L, light.color.rgb * attenuation, albedo, F0, mRoughness, mMetallic);
+	}
+
+	return radiance;
+}
+
+vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao, vec4 inTransfer, float mRoughness, float mMetallic, int cluster, float shadow, out vec3 outEnvColor)
 {
 	vec3 albedo = inColor.rgb;
 	
@@ -74,7 +307,10 @@ vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao,
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - mMetallic;
 	
-	vec3 irradiance = texture(irradianceMap, N).rgb;
+	vec3 irradiance = (useSHIrradiance == 1) ? irradianceSH(normalize(N)) : texture(irradianceMap, N).rgb;
+
+	// Baked meshes bring their self shadowed irradiance from the gPass
+	if (inTransfer.a > 0.0) irradiance = inTransfer.rgb;
 	//vec2 sampleCoord = vec2(1080 / 1920.0, 1) * csN.xy;
 	//sampleCoord = sampleCoord * 0.5 + 0.5;
 	//irradiance = texture(reflectanceMap, sampleCoord).rgb;
@@ -82,7 +318,7 @@ vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao,
 	
 	// sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
     const float MAX_REFLECTION_LOD = 5.0;
-    vec3 prefilteredColor = textureLod(prefilterMap, R, mRoughness * MAX_REFLECTION_LOD).rgb;
+    vec3 prefilteredColor = samplePrefilter(R, mRoughness * MAX_REFLECTION_LOD);
 	vec4 reflectionColor = inReflection;
 	//reflectionColor.rgb += prefilteredColor;
 	//reflectionColor.rgb = mix(reflectionColor.rgb, reflectionColor.rgb + prefilteredColor, 1 - pow(1 - metallic, 5));
@@ -100,8 +336,15 @@ vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao,
     vec2 brdf = texture(brdfLUT, vec2(max(dot(N, V), 0.0), mRoughness)).rg;
     vec3 specular = envColor * (F * brdf.x + brdf.y);
 
-    vec3 ambient = (kD * diffuse + specular) * ao;
+    // Baked transfer already holds the self occlusion, SSAO would darken it twice
+    vec3 diffuseAO = (inTransfer.a > 0.0) ? vec3(1) : ao;
+    vec3 ambient = kD * diffuse * diffuseAO + specular * ao;
     vec3 color = ambient;
+
+	if (cluster >= 0) color += clusteredLighting(cluster, P, N, V, albedo, F0, mRoughness, mMetallic);
+
+	// The background pass lights the real surfaces without shadows, the composite ratio keeps only the shadows
+	if (useDirectLight == 1) color += evaluateLight(N, V, normalize(lightPosition), lightColor * lightIntensity * shadow, albedo, F0, mRoughness, mMetallic);
 	
 	
 	return color;
@@ -112,24 +355,33 @@ vec3 render(vec3 P, vec3 N, vec3 csN, vec4 inColor, vec4 inReflection, vec3 ao,
 
 void main()
 {
-	//float depth = texture(gDepth, TexCoord).r;
-	vec4 position = texture(gPosition, TexCoord);
-	vec3 positionWorld = (viewInverse * vec4(position.xyz, 1)).xyz;
-    vec4 normal = texture(gNormal, TexCoord);
-	vec3 normalWorld = mat3(viewInverse) * normal.xyz;
+	// Reconstruct position from depth buffer
+	float depth = texture(gDepth, TexCoord).r;
+	vec3 position = depthToViewPosition(depth, TexCoord);
+	vec3 positionWorld = (viewInverse * vec4(position, 1)).xyz;
+    vec3 normal = decodeNormal(texture(gNormal, TexCoord).xy);
+	vec3 normalWorld = mat3(viewInverse) * normal;
     vec4 color = texture(gColor, TexCoord);
+	vec4 material = texture(gMaterial, TexCoord);
 	vec4 reflection = texture(reflectionMap, TexCoord);
-	float roughness = position.a;
-	float metallic = normal.a;
-	
-	// Reconstruct position from depth buffer
-	//position = depthToViewPosition(depth, TexCoord);
+	float roughness = material.r;
+	float metallic = material.g;
 	
 	
 	vec4 finalColor = vec4(0);
 	vec3 ao = texture(aoMap, TexCoord).rgb;
+
+	// Virtual objects darken the real surfaces around them beyond the reach of SSAO
+	if (distanceFieldInstanceCount > 0 && color.a == 0.0)
+	{
+		ao *= distanceFieldVisibility(positionWorld, normalize(normalWorld));
+	}
+
+	vec4 transfer = (useTransferMap == 1) ? texture(transferMap, TexCoord) : vec4(0);
+	int cluster = (useClusteredLights == 1) ? clusterIndex(TexCoord, -position.z) : -1;
+	float shadow = (useShadowMap == 1) ? shadowVisibility(positionWorld, normalize(normalWorld)) : 1.0;
 	vec3 envColor;
-	finalColor.rgb = render(positionWorld, normalWorld, normal.xyz, color, reflection, ao, roughness, metallic, envColor);
+	finalColor.rgb = render(positionWorld, normalWorld, normal, color, reflection, ao, transfer, roughness, metallic, cluster, shadow, envColor);
 	
 	/*vec2 sampleCoord = vec2(1080 / 1920.0, 1) * normal.xy;
 	sampleCoord = sampleCoord * 0.5 + 0.5;
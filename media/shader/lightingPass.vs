@@ -5,8 +5,11 @@ layout (location = 1) in vec2 texcoord;
 
 out vec2 TexCoord;
 
+#include "tiles.glsl"
+
 void main()
 {
-    gl_Position = vec4(position.xy, 0.0, 1.0);
-	TexCoord = texcoord;
+	vec2 vertexTexcoord = (useTiles == 1) ? tileTexcoord() : texcoord;
+    gl_Position = vec4(vertexTexcoord * 2.0 - 1.0, 0.0, 1.0);
+	TexCoord = vertexTexcoord;
 }
\ No newline at end of file
@@ -6,8 +6,10 @@ layout (location = 0) out vec4 outColor;
 
 uniform int displayMode = 1;
 
+#include "gbuffer.glsl"
+
 uniform sampler2D inColor;
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gColor;
 uniform sampler2D aoMap;
@@ -71,8 +73,8 @@ void main()
 	outColor = color;*/
 	
     vec4 color = texture(inColor, TexCoord);
-	vec3 position = texture(gPosition, TexCoord).xyz;
-	vec3 normal = texture(gNormal, TexCoord).xyz;
+	vec3 position = depthToViewPosition(gDepth, TexCoord);
+	vec3 normal = decodeNormal(texture(gNormal, TexCoord).xy);
 	vec3 albedo = texture(gColor, TexCoord).xyz;
 	vec3 ao = texture(aoMap, TexCoord).rgb;
 	
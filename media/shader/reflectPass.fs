@@ -47,20 +47,12 @@ layout (location = 0) out vec4 outReflection;
 layout (location = 1) out vec4 outReflectionRay;
 layout (location = 2) out vec4 outAmbientOcclusion;
 
-layout (std140, binding = 9) uniform MatCam
-{
-    mat4 projection;
-	mat4 projectionInverse;
-    mat4 view;
-	mat4 viewInverse;
-	mat4 kinectProjection;
-	mat4 kinectProjectionInverse;
-};
+#include "gbuffer.glsl"
 
 uniform vec2 bufferSize = vec2(1920, 1080);
 uniform vec2 texelSize = 1.0 / vec2(1920, 1080);
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 
 
@@ -110,18 +102,32 @@ uniform sampler2D gNormal;
 
  */
  
-uniform float maxSteps = 100;
-uniform float binarySearchSteps = 10;
-uniform float maxRayTraceDistance = 0.2;
-uniform float nearPlaneZ = -0.01;
-uniform float rayZThickness = 0.002;
-uniform float stride = 3;
-uniform float strideZCutoff = 2.5;
-uniform float jitterFactor = 0.5;
-
-uniform float screenEdgeFadeStart = 0.8;
-uniform float cameraFadeStart = 0.01;
-uniform float cameraFadeLength = 0.1;
+layout (std140, binding = 14) uniform SSRParameters
+{
+	float maxSteps;
+	float binarySearchSteps;
+	float maxRayTraceDistance;
+	float nearPlaneZ;
+	float rayZThickness;
+	float stride;
+	float strideZCutoff;
+	float jitterFactor;
+	float screenEdgeFadeStart;
+	float cameraFadeStart;
+	float cameraFadeLength;
+	int frameIndex;
+};
+
+// Camera space z of a pixel, zero where the depth buffer is empty
+float fetchViewZ(ivec2 pixel)
+{
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	if (depth >= 1.0) return 0.0;
+
+	vec2 texcoord = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+	vec4 viewPosition = kinectProjectionInverse * vec4(texcoord * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	return viewPosition.z / viewPosition.w;
+}
 
 float distanceSquared(vec2 a, vec2 b) { a -= b; return dot(a, a); }
 void swap(inout float a, inout float b) { float t = a; a = b; b = t; }
@@ -254,7 +260,7 @@ bool traceSSRay(vec3 rayOrigin, vec3 rayDirection, float jitter,
         if (rayZMin > rayZMax) { swap(rayZMin, rayZMax); }
 
         // Camera-space z of the background
-        sceneZMax = texelFetch(gPosition, ivec2(hitPixel), 0).z;
+        sceneZMax = fetchViewZ(ivec2(hitPixel));
 
 		intersect = intersectZ(rayZMin, rayZMax, sceneZMax);
     } // pixel on ray
@@ -279,7 +285,7 @@ bool traceSSRay(vec3 rayOrigin, vec3 rayDirection, float jitter,
 			prevZMaxEstimate = rayZMax;
 			if (rayZMin > rayZMax) { swap(rayZMin, rayZMax); }
 		
-			sceneZMax = texelFetch(gPosition, ivec2(hitPixel), 0).z;
+			sceneZMax = fetchViewZ(ivec2(hitPixel));
 			
 			bool newIntersect = intersectZ(rayZMin, rayZMax, sceneZMax);
 			if (newIntersect)
@@ -329,6 +335,19 @@ uniform sampler2D inColor;
 uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 
+#include "sh.glsl"
+
+uniform sampler2D blueNoise;
+uniform vec4 blueNoiseOffset = vec4(0);
+uniform int useBlueNoise = 0;
+
+// Per pixel blue noise, shifted along the golden ratio every frame
+vec4 sampleBlueNoise(ivec2 pxCoord)
+{
+	ivec2 noiseSize = textureSize(blueNoise, 0);
+	return fract(texelFetch(blueNoise, pxCoord % noiseSize, 0) + blueNoiseOffset);
+}
+
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
 // http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
@@ -376,8 +395,8 @@ vec3 ImportanceSampleGGX(vec2 Xi, vec3 N, float roughness)
 
 void main()
 {
-	vec3 position = texture(gPosition, TexCoord).xyz;
-    vec3 normal = texture(gNormal, TexCoord).xyz;
+	vec3 position = depthToViewPosition(gDepth, TexCoord);
+    vec3 normal = decodeNormal(texture(gNormal, TexCoord).xy);
 	
 	// Screen space reflections
 	vec3 rayOrigin = position;
@@ -390,6 +409,8 @@ void main()
 	float jF = jitterFactor;
 	if (stride == 1) jF = 0;
 	float rand = fract(sin(dot(TexCoord, vec2(12.9898, 78.233))) * 43758.5453);
+	rand = fract(rand + frameIndex * 0.61803398875); // Golden ratio sequence over frames
+	if (useBlueNoise == 1) rand = sampleBlueNoise(ivec2(gl_FragCoord.xy)).x;
 	float jitter = 1.0 + (rand - 0.5) * jF;
 	
 	bool intersect = traceSSRay(rayOrigin, rayDirection, jitter, hitCoord, hitPoint, steps);
@@ -433,7 +454,7 @@ void main()
 		else
 		{
 			vec3 worldH = (viewInverse * vec4(H, 1)).xyz;
-			vec3 irradiance = texture(irradianceMap, worldH).rgb;
+			vec3 irradiance = (useSHIrradiance == 1) ? irradianceSH(normalize(worldH)) : texture(irradianceMap, worldH).rgb;
 			totalColor += irradiance;
 		}
     }
@@ -25,12 +25,15 @@ const mat4 mTexture = mat4
 	0.5, 0.5, 0.0, 1.0
 );
 
+#include "tiles.glsl"
+
 void main()
 {
-    gl_Position = vec4(position.xy, 0.0, 1.0);
-	TexCoord = texcoord;
+	vec2 vertexTexcoord = (useTiles == 1) ? tileTexcoord() : texcoord;
+    gl_Position = vec4(vertexTexcoord * 2.0 - 1.0, 0.0, 1.0);
+	TexCoord = vertexTexcoord;
 	
-	vec4 cameraRay = vec4(texcoord.xy * 2.0 - 1.0, 0.0, 1.0);
+	vec4 cameraRay = vec4(vertexTexcoord * 2.0 - 1.0, 0.0, 1.0);
 	cameraRay = kinectProjectionInverse * cameraRay;
 	RayDirection = cameraRay.xyz / cameraRay.w;
 	ProjectionTexture = mTexture * kinectProjection;
@@ -4,15 +4,7 @@ in vec2 TexCoord;
 
 layout (location = 0) out vec4 outColor;
 
-layout (std140, binding = 9) uniform MatCam
-{
-    mat4 projection;
-	mat4 projectionInverse;
-    mat4 view;
-	mat4 viewInverse;
-	mat4 kinectProjection;
-	mat4 kinectProjectionInverse;
-};
+#include "gbuffer.glsl"
 
 uniform sampler2D gNormal;
 uniform sampler2D inColor;
@@ -22,10 +14,9 @@ const ivec2 bufferSize = ivec2(1920, 1080);
 const vec2 texelSize = 1.0 / vec2(1920, 1080);
 const float aspect = 1080.0 / 1920;
 
-
 void main()
 {
-	vec3 normal = texture(gNormal, TexCoord).xyz;
+	vec3 normal = decodeNormal(texture(gNormal, TexCoord).xy);
 	vec4 color = texture(inColor, TexCoord);
 	
 	vec4 envColor = texture(envMap, normal);
@@ -39,7 +30,7 @@ void main()
 		{
 			vec2 sampleCoord = vec2(i, j) * texelSize;
 			vec3 sampleColor = texture(inColor, sampleCoord).rgb;
-			vec3 sampleNormal = texture(gNormal, sampleCoord).xyz;
+			vec3 sampleNormal = decodeNormal(texture(gNormal, sampleCoord).xy);
 			vec3 envColor = texture(envMap, sampleNormal).rgb;
 			
 			vec2 ssCoord = sampleNormal.xy;
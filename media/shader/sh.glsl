@@ -0,0 +1,23 @@
+// Spherical harmonics irradiance written by PBR::computeSHIrradiance, see shIrradiance.cs for the projection.
+
+layout (std140, binding = 11) uniform SHIrradiance
+{
+	vec4 shCoefficients[9];
+	int useSHIrradiance;
+};
+
+// Irradiance from the convolved spherical harmonics of the camera frame
+vec3 irradianceSH(vec3 n)
+{
+	vec3 irradiance = shCoefficients[0].rgb * 0.282095
+		+ shCoefficients[1].rgb * 0.488603 * n.y
+		+ shCoefficients[2].rgb * 0.488603 * n.z
+		+ shCoefficients[3].rgb * 0.488603 * n.x
+		+ shCoefficients[4].rgb * 1.092548 * n.x * n.y
+		+ shCoefficients[5].rgb * 1.092548 * n.y * n.z
+		+ shCoefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+		+ shCoefficients[7].rgb * 1.092548 * n.x * n.z
+		+ shCoefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+
+	return max(irradiance, vec3(0));
+}
\ No newline at end of file
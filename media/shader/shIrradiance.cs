@@ -0,0 +1,100 @@
+#version 450
+
+// Projects the camera frame onto 9 spherical harmonics coefficients of irradiance in a single work group.
+// Directions map to the frame exactly like 2dToCube, so the result matches the convolved irradiance cubemap.
+layout (local_size_x = 128) in;
+
+layout (std430, binding = 5) writeonly buffer SHIrradiance
+{
+	vec4 shCoefficients[9];
+};
+
+uniform sampler2D colorMap;
+
+uniform int sampleCount = 16384;
+uniform int equirectangular = 0;
+uniform int recapture = 1;
+
+const float PI = 3.14159265359;
+const float goldenAngle = 2.39996323;
+const int threadCount = 128;
+
+shared vec4 partialSums[threadCount * 9];
+
+vec3 sampleFrame(vec3 dir)
+{
+	// Panorama files map like hdrToCube
+	if (equirectangular == 1)
+	{
+		vec2 uv = vec2(atan(dir.z, dir.x), -asin(dir.y)) * vec2(0.1591, 0.3183) + 0.5;
+		return pow(texture(colorMap, uv).rgb, vec3(2.2));
+	}
+
+	vec2 frameSize = vec2(textureSize(colorMap, 0));
+	vec2 uv = dir.xy;
+	uv.x *= frameSize.y / frameSize.x;
+	uv = uv * 0.5 + 0.5;
+	if (recapture > 0) uv.y = 1 - uv.y;
+
+	return texture(colorMap, uv).rgb;
+}
+
+void main()
+{
+	int threadIndex = int(gl_LocalInvocationIndex);
+
+	vec3 sums[9];
+	for (int c = 0; c < 9; c++) sums[c] = vec3(0);
+
+	// Fibonacci sphere, every direction covers the same solid angle
+	for (int i = threadIndex; i < sampleCount; i += threadCount)
+	{
+		float z = 1.0 - (2.0 * i + 1.0) / sampleCount;
+		float r = sqrt(max(1.0 - z * z, 0.0));
+		float phi = i * goldenAngle;
+		vec3 dir = vec3(r * cos(phi), r * sin(phi), z);
+
+		vec3 radiance = sampleFrame(dir);
+
+		sums[0] += radiance * 0.282095;
+		sums[1] += radiance * 0.488603 * dir.y;
+		sums[2] += radiance * 0.488603 * dir.z;
+		sums[3] += radiance * 0.488603 * dir.x;
+		sums[4] += radiance * 1.092548 * dir.x * dir.y;
+		sums[5] += radiance * 1.092548 * dir.y * dir.z;
+		sums[6] += radiance * 0.315392 * (3.0 * dir.z * dir.z - 1.0);
+		sums[7] += radiance * 1.092548 * dir.x * dir.z;
+		sums[8] += radiance * 0.546274 * (dir.x * dir.x - dir.y * dir.y);
+	}
+
+	for (int c = 0; c < 9; c++) partialSums[c * threadCount + threadIndex] = vec4(sums[c], 0);
+
+	// Tree reduction of all coefficients at once
+	for (int stride = threadCount / 2; stride > 0; stride /= 2)
+	{
+		memoryBarrierShared();
+		barrier();
+
+		if (threadIndex < stride)
+		{
+			for (int c = 0; c < 9; c++)
+			{
+				partialSums[c * threadCount + threadIndex] += partialSums[c * threadCount + threadIndex + stride];
+			}
+		}
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	// Convolve with the clamped cosine lobe (Ramamoorthi and Hanrahan) and divide by PI,
+	// the lighting pass multiplies irradiance by albedo just like the cubemap value
+	if (threadIndex < 9)
+	{
+		int band = (threadIndex == 0) ? 0 : ((threadIndex < 4) ? 1 : 2);
+		float cosineLobe = (band == 0) ? 1.0 : ((band == 1) ? 2.0 / 3.0 : 0.25);
+		float solidAngle = 4.0 * PI / sampleCount;
+
+		shCoefficients[threadIndex] = partialSums[threadIndex * threadCount] * solidAngle * cosineLobe;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 450
+
+// Depth only, the fragment shader writes nothing
+void main()
+{
+}
\ No newline at end of file
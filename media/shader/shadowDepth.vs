@@ -0,0 +1,11 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+
+uniform mat4 lightViewProjection;
+uniform mat4 model;
+
+void main()
+{
+	gl_Position = lightViewProjection * model * vec4(position, 1.0);
+}
\ No newline at end of file
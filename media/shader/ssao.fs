@@ -4,37 +4,51 @@ in vec2 TexCoord;
 
 layout (location = 0) out vec3 outColor;
 
-layout (std140, binding = 9) uniform MatCam
-{
-    mat4 projection;
-	mat4 projectionInverse;
-    mat4 view;
-	mat4 viewInverse;
-	mat4 kinectProjection;
-	mat4 kinectProjectionInverse;
-};
+#include "gbuffer.glsl"
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gColor;
+uniform sampler2D blueNoise;
+uniform vec4 blueNoiseOffset = vec4(0);
+uniform int useBlueNoise = 0;
 
 uniform vec3 inSamples[64];
-uniform int kernelSize = 64;
-uniform float kernelRadius = 0.35;
-uniform float bias = 0.005;
-uniform float intensity = 1.0;
-uniform float power = 1.0;
+
+layout (std140, binding = 13) uniform SSAOParameters
+{
+	int kernelSize;
+	int samples;
+	int frameIndex;
+	float kernelRadius;
+	float bias;
+	float intensity;
+	float power;
+};
 
 const float epsilon = 0.0001;
-uniform int samples = 9;
-uniform vec2 bufferSize = vec2(1920, 1080);
 
-// Alchemy AO random disc samples
-vec2 randomSamples(int sampleNumber, int samples, ivec2 pxCoord)
+// Per pixel blue noise, shifted along the golden ratio every frame
+vec4 sampleBlueNoise(ivec2 pxCoord)
+{
+	ivec2 noiseSize = textureSize(blueNoise, 0);
+	return fract(texelFetch(blueNoise, pxCoord % noiseSize, 0) + blueNoiseOffset);
+}
+
+// Spiral rotation (in turns) and radial offset of the sample disc
+vec2 pixelNoise(ivec2 pxCoord)
 {
-	float radius = float(sampleNumber + 0.5) * (1.0 / samples);
+	if (useBlueNoise == 1) return sampleBlueNoise(pxCoord).xy;
+
 	float hash = (3 * pxCoord.x ^ pxCoord.y + pxCoord.x * pxCoord.y) * 10.0;
-	float angle = radius * (7 * 6.28) + hash;
+	return vec2(hash / 6.28 + frameIndex * 0.381966, 0.5); // Golden angle per frame
+}
+
+// Alchemy AO random disc samples
+vec2 randomSamples(int sampleNumber, int samples, vec2 noise)
+{
+	float radius = float(sampleNumber + noise.y) * (1.0 / samples);
+	float angle = radius * (7 * 6.28) + noise.x * 6.28;
 
 	return radius * vec2(cos(angle), sin(angle));
 }
@@ -47,18 +61,19 @@ void main()
 		return;
 	}
 	
-	vec3 position = texture(gPosition, TexCoord).xyz;
-    vec3 normal = texture(gNormal, TexCoord).xyz;
+	vec3 position = depthToViewPosition(gDepth, TexCoord);
+    vec3 normal = decodeNormal(texture(gNormal, TexCoord).xy);
 	
 	float sumOcclusion = 0.0;
 	vec3 sumColor = vec3(0);
-	ivec2 ssC = ivec2(bufferSize * TexCoord);
+	ivec2 ssC = ivec2(gl_FragCoord.xy);
+	vec2 noise = pixelNoise(ssC);
 	
 	for (int i = 0; i < samples; i++)
 	{
-		vec2 unitOffset = randomSamples(i, samples, ssC);
+		vec2 unitOffset = randomSamples(i, samples, noise);
 		vec2 sampleCoord = TexCoord + unitOffset * kernelRadius;
-		vec3 samplePosition = texture(gPosition, sampleCoord).xyz;
+		vec3 samplePosition = depthToViewPosition(gDepth, sampleCoord);
 		vec3 sampleColor = texture(gColor, sampleCoord).rgb;
 
 		vec3 v = samplePosition - position;
@@ -4,8 +4,10 @@ in vec2 TexCoord;
 
 layout (location = 0) out vec3 outColor;
 
+#include "gbuffer.glsl"
+
 uniform sampler2D inColor;
-uniform sampler2D inPosition;
+uniform sampler2D inDepth;
 uniform sampler2D inNormal;
 
 uniform int isVertical = 0;
@@ -23,8 +25,8 @@ void main()
 {
 	// Depth sensor textures
 	vec3 color = texture(inColor, TexCoord).rgb;
-	float z = texture(inPosition, TexCoord).z;
-	vec3 normal = texture(inNormal, TexCoord).rgb;
+	float z = depthToViewPosition(inDepth, TexCoord).z;
+	vec3 normal = decodeNormal(texture(inNormal, TexCoord).xy);
 	vec2 texelSize = 1.0 / vec2(textureSize(inColor, 0));
 	
 	if (isVertical == 1) texelSize = vec2(0, texelSize.y);
@@ -38,8 +40,8 @@ void main()
 	{
 		vec2 sampleCoord = TexCoord + i * texelSize;
 		vec3 sampleValue = texture(inColor, sampleCoord).rgb;
-		float sampleZ = texture(inPosition, sampleCoord).z;
-		vec3 sampleNormal = texture(inNormal, sampleCoord).rgb;
+		float sampleZ = depthToViewPosition(inDepth, sampleCoord).z;
+		vec3 sampleNormal = decodeNormal(texture(inNormal, sampleCoord).xy);
 		vec3 distv = normal - sampleNormal;
 		float sampleWeight = normpdf(z - sampleZ, zsigma) * normpdf(dot(distv, distv), nsigma) * kernel[kernelRadius + i];
 		
@@ -0,0 +1,84 @@
+#version 450
+
+// Inclusive prefix scan of one row (or column) per work group.
+// Values are stored as fixed point integers with 8 fractional bits. The sums wrap around, but a box difference is
+// exact modulo 2^32 as long as the box itself sums below it, which holds for maxRadiance over coneTraceSAT's largest box.
+layout (local_size_x = 1024) in;
+
+layout (rgba32ui, binding = 0) uniform writeonly uimage2D outTable;
+layout (rgba32ui, binding = 1) uniform readonly uimage2D inRows;
+
+uniform sampler2D inColor;
+
+uniform int isVertical = 0;
+
+const float fixedPointScale = 255.0;
+const float maxRadiance = 64.0;
+const int chunkSize = 2048;
+
+shared uvec4 threadSums[1024];
+shared uvec4 chunkCarry;
+
+uvec4 loadValue(ivec2 coord)
+{
+	if (isVertical == 1)
+	{
+		return imageLoad(inRows, coord);
+	}
+
+	vec4 color = clamp(texelFetch(inColor, coord, 0), 0.0, maxRadiance);
+	return uvec4(round(color * fixedPointScale));
+}
+
+ivec2 lineCoord(int line, int index)
+{
+	return (isVertical == 1) ? ivec2(line, index) : ivec2(index, line);
+}
+
+void main()
+{
+	ivec2 tableSize = imageSize(outTable);
+	int line = int(gl_WorkGroupID.y);
+	int lineLength = (isVertical == 1) ? tableSize.y : tableSize.x;
+	int threadIndex = int(gl_LocalInvocationIndex);
+
+	if (threadIndex == 0) chunkCarry = uvec4(0);
+
+	for (int chunkStart = 0; chunkStart < lineLength; chunkStart += chunkSize)
+	{
+		// Every thread scans a pair of neighboring elements
+		int index = chunkStart + threadIndex * 2;
+		uvec4 first = (index < lineLength) ? loadValue(lineCoord(line, index)) : uvec4(0);
+		uvec4 second = (index + 1 < lineLength) ? loadValue(lineCoord(line, index + 1)) : uvec4(0);
+		second += first;
+
+		threadSums[threadIndex] = second;
+		memoryBarrierShared();
+		barrier();
+
+		// Hillis-Steele scan over the pair sums
+		for (int offset = 1; offset < 1024; offset *= 2)
+		{
+			uvec4 value = (threadIndex >= offset) ? threadSums[threadIndex - offset] : uvec4(0);
+			memoryBarrierShared();
+			barrier();
+
+			threadSums[threadIndex] += value;
+			memoryBarrierShared();
+			barrier();
+		}
+
+		uvec4 prefix = chunkCarry + ((threadIndex > 0) ? threadSums[threadIndex - 1] : uvec4(0));
+
+		if (index < lineLength) imageStore(outTable, lineCoord(line, index), prefix + first);
+		if (index + 1 < lineLength) imageStore(outTable, lineCoord(line, index + 1), prefix + second);
+
+		memoryBarrierShared();
+		barrier();
+
+		if (threadIndex == 0) chunkCarry += threadSums[1023];
+
+		memoryBarrierShared();
+		barrier();
+	}
+}
\ No newline at end of file
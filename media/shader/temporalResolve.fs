@@ -0,0 +1,75 @@
+#version 450
+
+in vec2 TexCoord;
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) out vec4 outGeometry;
+
+#include "gbuffer.glsl"
+
+uniform sampler2D inCurrent;
+uniform sampler2D inDepth;
+uniform sampler2D inNormal;
+uniform sampler2D inMotion;
+uniform sampler2D inHistory;
+uniform sampler2D inHistoryGeometry;
+
+uniform float blendFactor = 0.1;
+uniform float depthThreshold = 0.05;
+uniform float normalThreshold = 0.9;
+uniform int clampHistory = 0;
+uniform int historyValid = 0;
+uniform int useMotion = 1;
+
+void main()
+{
+	vec4 current = texture(inCurrent, TexCoord);
+	vec3 position = depthToViewPosition(inDepth, TexCoord);
+	vec3 normal = decodeNormal(texture(inNormal, TexCoord).xy);
+	vec2 motion = (useMotion == 1) ? texture(inMotion, TexCoord).xy : vec2(0);
+
+	outGeometry = vec4(normal, position.z);
+	outColor = current;
+
+	vec2 previousCoord = TexCoord - motion;
+
+	if (historyValid == 0 || any(lessThan(previousCoord, vec2(0))) || any(greaterThan(previousCoord, vec2(1))))
+	{
+		return;
+	}
+
+	// Disocclusion: the reprojected pixel must still see the same surface
+	vec4 previousGeometry = texture(inHistoryGeometry, previousCoord);
+	float depthDifference = abs(previousGeometry.w - position.z) / max(abs(position.z), 0.0001);
+	float normalSimilarity = dot(previousGeometry.xyz, normal);
+
+	if (depthDifference > depthThreshold || normalSimilarity < normalThreshold)
+	{
+		return;
+	}
+
+	vec4 history = texture(inHistory, previousCoord);
+
+	// Optionally clamp history to the current neighborhood, removes ghosting of shading changes
+	if (clampHistory == 1)
+	{
+		ivec2 pixel = ivec2(gl_FragCoord.xy);
+		ivec2 maxPixel = textureSize(inCurrent, 0) - 1;
+		vec4 minColor = current;
+		vec4 maxColor = current;
+
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				vec4 neighbor = texelFetch(inCurrent, clamp(pixel + ivec2(x, y), ivec2(0), maxPixel), 0);
+				minColor = min(minColor, neighbor);
+				maxColor = max(maxColor, neighbor);
+			}
+		}
+
+		history = clamp(history, minColor, maxColor);
+	}
+
+	outColor = mix(history, current, blendFactor);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#version 450
+
+// One work group per 16x16 screen tile
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (std430, binding = 4) writeonly buffer TileFlags
+{
+	uint tileFlags[];
+};
+
+uniform sampler2D inMaterial;
+uniform sampler2D inColor;
+
+uniform float roughnessThreshold = 0.75;
+
+const uint TILE_HAS_VIRTUAL = 1u;
+const uint TILE_HIGH_ROUGHNESS = 2u;
+const uint TILE_HAS_REAL = 4u;
+
+shared uint flags;
+shared uint minRoughness;
+
+void main()
+{
+	if (gl_LocalInvocationIndex == 0)
+	{
+		flags = 0u;
+		minRoughness = floatBitsToUint(1e9);
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+
+	if (all(lessThan(coord, textureSize(inColor, 0))))
+	{
+		// Alpha of the composed color marks virtual objects
+		float mask = texelFetch(inColor, coord, 0).a;
+		float roughness = texelFetch(inMaterial, coord, 0).r;
+
+		if (mask > 0.5) atomicOr(flags, TILE_HAS_VIRTUAL);
+		if (mask < 1.0) atomicOr(flags, TILE_HAS_REAL);
+		atomicMin(minRoughness, floatBitsToUint(max(roughness, 0.0)));
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0)
+	{
+		uint tileFlag = flags;
+		if (uintBitsToFloat(minRoughness) >= roughnessThreshold) tileFlag |= TILE_HIGH_ROUGHNESS;
+
+		tileFlags[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = tileFlag;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#version 450
+
+// One thread per tile, appends the tile to every list it belongs to
+layout (local_size_x = 64) in;
+
+layout (std430, binding = 4) readonly buffer TileFlags
+{
+	uint tileFlags[];
+};
+
+// Indirect draw commands (count, instanceCount, first, baseInstance) of every list, followed by the lists
+layout (std430, binding = 3) buffer TileList
+{
+	uint tileData[];
+};
+
+uniform ivec2 tileCount;
+uniform int maxTiles;
+uniform int dilationRadius = 2;
+
+const uint TILE_HAS_VIRTUAL = 1u;
+const uint TILE_HIGH_ROUGHNESS = 2u;
+const uint TILE_HAS_REAL = 4u;
+
+const int TILE_LIST_REAL_ONLY = 0;
+const int TILE_LIST_VIRTUAL = 1;
+const int TILE_LIST_EDGE = 2;
+const int TILE_LIST_REFLECTIVE = 3;
+const int TILE_LIST_COUNT = 4;
+
+void appendTile(int list, uint tile)
+{
+	uint index = atomicAdd(tileData[list * 4 + 1], 1u);
+	tileData[TILE_LIST_COUNT * 4 + list * maxTiles + index] = tile;
+}
+
+void main()
+{
+	int tileIndex = int(gl_GlobalInvocationID.x);
+	if (tileIndex >= tileCount.x * tileCount.y) return;
+
+	ivec2 tileCoord = ivec2(tileIndex % tileCount.x, tileIndex / tileCount.x);
+	uint flags = tileFlags[tileIndex];
+	uint tile = uint(tileCoord.x) | (uint(tileCoord.y) << 16);
+
+	// Virtual objects still influence nearby real pixels through AO and reflections
+	bool virtualNearby = false;
+
+	for (int y = -dilationRadius; y <= dilationRadius; y++)
+	{
+		for (int x = -dilationRadius; x <= dilationRadius; x++)
+		{
+			ivec2 neighbor = clamp(tileCoord + ivec2(x, y), ivec2(0), tileCount - 1);
+			if ((tileFlags[neighbor.y * tileCount.x + neighbor.x] & TILE_HAS_VIRTUAL) != 0u) virtualNearby = true;
+		}
+	}
+
+	appendTile(virtualNearby ? TILE_LIST_VIRTUAL : TILE_LIST_REAL_ONLY, tile);
+
+	// Real pixels under virtual influence need the back scene for the differential
+	if (virtualNearby && (flags & TILE_HAS_REAL) != 0u) appendTile(TILE_LIST_EDGE, tile);
+
+	// Rough tiles are left out, they fall back to the prefiltered environment
+	if ((flags & TILE_HIGH_ROUGHNESS) == 0u) appendTile(TILE_LIST_REFLECTIVE, tile);
+}
\ No newline at end of file
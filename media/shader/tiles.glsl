@@ -0,0 +1,19 @@
+// Tiled drawing of full screen passes, see TileClassifier::drawTiles.
+// The vertex shader places quad corners of the listed tiles when useTiles is set, else it passes the quad through.
+layout (std430, binding = 3) readonly buffer TileList
+{
+	uint tileData[];
+};
+
+uniform int useTiles = 0;
+uniform int tileListOffset = 0;
+uniform vec2 tileScale = vec2(1.0);
+
+const vec2 tileCorners[6] = vec2[](vec2(0, 1), vec2(0, 0), vec2(1, 1), vec2(1, 1), vec2(0, 0), vec2(1, 0));
+
+vec2 tileTexcoord()
+{
+	uint tile = tileData[tileListOffset + gl_InstanceID];
+	vec2 tileCoord = vec2(tile & 0xFFFFu, tile >> 16);
+	return min((tileCoord + tileCorners[gl_VertexID]) * tileScale, vec2(1.0));
+}
\ No newline at end of file
@@ -0,0 +1,458 @@
+// Per pass benchmark of the ARFW render stages on synthetic sensor frames, without a scene, GUI or sensor.
+// Every pass is run in isolation over a parameter sweep and timed on the GPU (GL_TIME_ELAPSED) and CPU (submit).
+// Results are mean, p50 and p99 in milliseconds as JSON, so runs on different machines or commits can be diffed.
+//
+// Build: the arfw_bench project of ARFW.sln, it compiles the ARFW sources without main.cpp
+// Usage: arfw_bench [output.json] [iterations] [warmup]
+// Default output is arfw_bench.json, 100 timed iterations after 10 warmup iterations per configuration.
+
+#include "DSensor.h"
+#include "SSAO.h"
+#include "SSReflection.h"
+#include "PBR.h"
+#include "Shader.h"
+#include "Quad.h"
+#include "HeadlessContext.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace glm;
+
+string g_ExePath;
+int g_windowWidth = 1920;
+int g_windowHeight = 1080;
+
+const int videoWidth = 640;
+const int videoHeight = 480;
+const int syntheticFrames = 8;
+
+struct Resolution
+{
+	int width, height;
+};
+
+struct Statistics
+{
+	double mean, p50, p99;
+};
+
+struct Result
+{
+	string pass;
+	Resolution resolution;
+	string parameters;
+	Statistics gpu, cpu;
+};
+
+// Screen space passes at the resolutions the framework runs at
+const vector<Resolution> resolutions = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+const vector<int> fillPassSweep = { 1, 3, 5 };
+const vector<int> blurRadiusSweep = { 2, 4, 8 };
+const vector<int> sampleSweep = { 8, 16, 32, 64 };
+const vector<float> maxStepSweep = { 50.0f, 100.0f, 200.0f, 400.0f };
+const vector<float> boxRadiusSweep = { 8.0f, 16.0f, 32.0f, 64.0f };
+
+int iterations = 100;
+int warmup = 10;
+vector<Result> results;
+
+// A tilted floor with a sphere on it, in the 16 bit histogram mapping DSensor::update produces (near is bright).
+// Random holes and depth noise give the temporal median and fill passes real work.
+void createSyntheticFrames(vector<vector<uint16_t>>& depthFrames, vector<vector<uint8_t>>& colorFrames)
+{
+	mt19937 generator(1234);
+	normal_distribution<float> noise(0.0f, 0.004f);
+	uniform_real_distribution<float> holes(0.0f, 1.0f);
+
+	depthFrames.resize(syntheticFrames);
+	colorFrames.resize(syntheticFrames);
+
+	for (int f = 0; f < syntheticFrames; f++)
+	{
+		depthFrames[f].resize(videoWidth * videoHeight);
+		colorFrames[f].resize(videoWidth * videoHeight * 3);
+
+		for (int y = 0; y < videoHeight; y++)
+		{
+			for (int x = 0; x < videoWidth; x++)
+			{
+				float u = (float)x / videoWidth;
+				float v = (float)y / videoHeight;
+
+				float distance = 0.3f + 0.6f * v;
+				float dx = u - 0.5f, dy = v - 0.55f;
+				float radius = dx * dx + dy * dy;
+				if (radius < 0.02f) distance -= sqrt(0.02f - radius);
+
+				int index = y * videoWidth + x;
+				bool hole = holes(generator) < 0.03f || (x < 16);
+				float mapped = glm::clamp(1.0f - distance + noise(generator), 0.0f, 1.0f);
+				depthFrames[f][index] = hole ? 0 : (uint16_t)(mapped * 65535.0f);
+
+				colorFrames[f][index * 3 + 0] = (uint8_t)(255 * u);
+				colorFrames[f][index * 3 + 1] = (uint8_t)(255 * v);
+				colorFrames[f][index * 3 + 2] = (uint8_t)(radius < 0.02f ? 200 : 80);
+			}
+		}
+	}
+}
+
+// Nearest rank percentiles
+Statistics computeStatistics(vector<double> samples)
+{
+	Statistics statistics = {};
+	if (samples.empty()) return statistics;
+
+	sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (double sample : samples) sum += sample;
+
+	statistics.mean = sum / samples.size();
+	statistics.p50 = samples[(size_t)(ceil(0.50 * samples.size())) - 1];
+	statistics.p99 = samples[(size_t)(ceil(0.99 * samples.size())) - 1];
+	return statistics;
+}
+
+// The queue is drained before every iteration, so the query measures the pass alone.
+// The query result is read right away, stalling is fine here unlike in the frame loop.
+void measure(string pass, Resolution resolution, string parameters, function<void()> prepare, function<void()> draw)
+{
+	GLuint query;
+	glGenQueries(1, &query);
+
+	vector<double> gpuSamples, cpuSamples;
+
+	for (int i = 0; i < warmup + iterations; i++)
+	{
+		if (prepare) prepare();
+		glFinish();
+
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		auto start = chrono::high_resolution_clock::now();
+
+		draw();
+
+		auto end = chrono::high_resolution_clock::now();
+		glEndQuery(GL_TIME_ELAPSED);
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+		if (i < warmup) continue;
+
+		gpuSamples.push_back(elapsed / 1000000.0);
+		cpuSamples.push_back(chrono::duration<double, milli>(end - start).count());
+	}
+
+	glDeleteQueries(1, &query);
+
+	Result result = { pass, resolution, parameters, computeStatistics(gpuSamples), computeStatistics(cpuSamples) };
+	results.push_back(result);
+
+	printf("%-14s %4dx%-4d %-28s gpu %8.3f ms  cpu %8.3f ms\n", pass.c_str(), resolution.width, resolution.height, parameters.c_str(), result.gpu.mean, result.cpu.mean);
+}
+
+GLuint createTexture(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void benchResolution(Resolution resolution, const vector<vector<uint16_t>>& depthFrames, const vector<vector<uint8_t>>& colorFrames)
+{
+	int width = resolution.width;
+	int height = resolution.height;
+	g_windowWidth = width;
+	g_windowHeight = height;
+
+	DSensor* sensor = new DSensor();
+	sensor->initializeSynthetic(width, height, videoWidth, videoHeight);
+
+	// Camera at the sensor, the same MatCam layout Scene fills every frame
+	GLuint uniformCamMat;
+	mat4 matrices[6] = { sensor->getMatProjection(), sensor->getMatProjectionInverse(), mat4(1), mat4(1), sensor->getMatProjection(), sensor->getMatProjectionInverse() };
+	glGenBuffers(1, &uniformCamMat);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformCamMat);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(matrices), matrices, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 9, uniformCamMat);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	int frame = 0;
+	auto uploadNextFrame = [&]()
+	{
+		sensor->uploadFrame(depthFrames[frame].data(), colorFrames[frame].data());
+		frame = (frame + 1) % syntheticFrames;
+	};
+
+	// Depth sensor filter chain
+	for (int fillPasses : fillPassSweep)
+	{
+		for (int blurRadius : blurRadiusSweep)
+		{
+			sensor->setFillPasses(fillPasses);
+			sensor->setBlurKernelRadius(blurRadius);
+
+			ostringstream parameters;
+			parameters << "\"fillPasses\": " << fillPasses << ", \"blurKernelRadius\": " << blurRadius;
+			measure("sensorFilter", resolution, parameters.str(), uploadNextFrame, [&]() { sensor->filterFrame(); });
+		}
+	}
+
+	sensor->setFillPasses(3);
+	sensor->setBlurKernelRadius(4);
+
+	// G-buffer of the real surfaces, the way the sensorSeed pass of Scene resamples them
+	GLuint gDepth = createTexture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+	GLuint gNormal = createTexture(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+	GLuint gColor = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+	GLuint gMaterial = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	GLuint cLighting = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+	GLuint cReflection = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+	GLuint cReflectionAO = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	GLuint gBuffer;
+	glGenFramebuffers(1, &gBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gColor, 0);
+	glDrawBuffers(2, attachments);
+
+	GLuint captureFBO;
+	glGenFramebuffers(1, &captureFBO);
+
+	Quad* quad = new Quad();
+	Shader* dsSeedShader = new Shader("dsSeed");
+	dsSeedShader->setUniform("dsPosition", 0);
+	dsSeedShader->setUniform("dsNormal", 1);
+	dsSeedShader->setUniform("dsColor", 2);
+
+	uploadNextFrame();
+	sensor->filterFrame();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+
+	dsSeedShader->apply();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sensor->getPositionMapId());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, sensor->getNormalMapId());
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, sensor->getColorMapId());
+	quad->draw();
+
+	glDepthFunc(GL_LESS);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Default material of the real surfaces, see Scene::update
+	const float bgMaterial[4] = { 0.0f, 0.8f, 0.0f, 0.0f };
+	glClearTexImage(gMaterial, 0, GL_RGBA, GL_FLOAT, bgMaterial);
+
+	// Environment precomputation, also what a lighting change costs
+	PBR* pbr = new PBR(width, height);
+	measure("pbrEnvMaps", resolution, "", nullptr, [&]() { pbr->computeEnvMaps(); });
+	measure("pbrBRDFLut", resolution, "", nullptr, [&]() { pbr->computeBRDFLut(); });
+
+	// Ambient occlusion of the real surfaces, both layers and their combination like the ssao pass of Scene
+	SSAO* ssao = new SSAO(width, height);
+	for (int samples : sampleSweep)
+	{
+		for (int blurRadius : blurRadiusSweep)
+		{
+			ssao->setSamples(samples);
+			ssao->setBlurKernelRadius(blurRadius);
+
+			ostringstream parameters;
+			parameters << "\"samples\": " << samples << ", \"blurKernelRadius\": " << blurRadius;
+			measure("ssao", resolution, parameters.str(), nullptr, [&]()
+			{
+				ssao->drawLayer(1, gDepth, gNormal, gColor);
+				ssao->drawLayer(2, gDepth, gNormal, gColor);
+				ssao->drawCombined(gColor);
+			});
+		}
+	}
+
+	// Lighting pass with the settings of the lightingBack pass, no lights, shadows or transfer
+	Shader* lightingPassShader = new Shader("lightingPass");
+	lightingPassShader->setUniform("gDepth", 0);
+	lightingPassShader->setUniform("gNormal", 1);
+	lightingPassShader->setUniform("gColor", 2);
+	lightingPassShader->setUniform("aoMap", 3);
+	lightingPassShader->setUniform("irradianceMap", 4);
+	lightingPassShader->setUniform("prefilterMap", 5);
+	lightingPassShader->setUniform("brdfLUT", 6);
+	lightingPassShader->setUniform("reflectionMap", 7);
+	lightingPassShader->setUniform("gMaterial", 8);
+	lightingPassShader->setUniform("prefilterOctMap", 9);
+	lightingPassShader->setUniform("useTransferMap", 0);
+	lightingPassShader->setUniform("distanceFieldInstanceCount", 0);
+	lightingPassShader->setUniform("useClusteredLights", 0);
+	lightingPassShader->setUniform("useShadowMap", 0);
+
+	measure("lighting", resolution, "", nullptr, [&]()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cLighting, 0);
+		glViewport(0, 0, width, height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		lightingPassShader->apply();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, gDepth);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, gNormal);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, gColor);
+		glActiveTexture(GL_TEXTURE8);
+		glBindTexture(GL_TEXTURE_2D, gMaterial);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, ssao->getTextureLayer(2));
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, pbr->getIrradianceMapId());
+		pbr->bindPrefilter(lightingPassShader->getShaderId(), 5, 9);
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, pbr->getBrdfLUTId());
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, cReflection);
+
+		quad->draw();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	});
+
+	// Screen space reflections traced into the lit image
+	SSReflection* ssr = new SSReflection(width, height);
+	for (float maxSteps : maxStepSweep)
+	{
+		for (float boxRadius : boxRadiusSweep)
+		{
+			ssr->setMaxSteps(maxSteps);
+			ssr->setMaxBoxRadius(boxRadius);
+
+			ostringstream parameters;
+			parameters << "\"maxSteps\": " << maxSteps << ", \"maxBoxRadius\": " << boxRadius;
+			measure("ssr", resolution, parameters.str(), nullptr, [&]()
+			{
+				ssr->draw(gDepth, gNormal, gMaterial, cLighting, pbr->getIrradianceMapId(), pbr->getPrefilterMapId(), cReflection, cReflectionAO);
+			});
+		}
+	}
+
+	delete ssr;
+	delete lightingPassShader;
+	delete ssao;
+	delete pbr;
+	delete dsSeedShader;
+	delete quad;
+	delete sensor;
+
+	GLuint textures[7] = { gDepth, gNormal, gColor, gMaterial, cLighting, cReflection, cReflectionAO };
+	glDeleteTextures(7, textures);
+	glDeleteFramebuffers(1, &gBuffer);
+	glDeleteFramebuffers(1, &captureFBO);
+	glDeleteBuffers(1, &uniformCamMat);
+}
+
+void writeStatistics(FILE* file, const char* name, const Statistics& statistics)
+{
+	fprintf(file, "\"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f }", name, statistics.mean, statistics.p50, statistics.p99);
+}
+
+bool writeJSON(string filepath)
+{
+	FILE* file = fopen(filepath.c_str(), "w");
+	if (file == nullptr) return false;
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+	fprintf(file, "\t\"version\": \"%s\",\n", (const char*)glGetString(GL_VERSION));
+	fprintf(file, "\t\"iterations\": %d,\n", iterations);
+	fprintf(file, "\t\"warmup\": %d,\n", warmup);
+	fprintf(file, "\t\"unit\": \"ms\",\n");
+	fprintf(file, "\t\"results\": [\n");
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& result = results[i];
+
+		fprintf(file, "\t\t{ \"pass\": \"%s\", \"width\": %d, \"height\": %d, \"parameters\": { %s }, ", result.pass.c_str(), result.resolution.width, result.resolution.height, result.parameters.c_str());
+		writeStatistics(file, "gpu", result.gpu);
+		fprintf(file, ", ");
+		writeStatistics(file, "cpu", result.cpu);
+		fprintf(file, " }%s\n", (i + 1 < results.size()) ? "," : "");
+	}
+
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	string exePath(argv[0]);
+	g_ExePath = exePath.substr(0, exePath.find_last_of("\\/")) + "\\";
+
+	string outputPath = (argc > 1) ? argv[1] : "arfw_bench.json";
+	if (argc > 2) iterations = std::max(1, atoi(argv[2]));
+	if (argc > 3) warmup = std::max(0, atoi(argv[3]));
+
+	// The largest resolution, passes only ever render into their own targets
+	HeadlessContext context;
+	if (!context.create(resolutions.back().width, resolutions.back().height))
+	{
+		printf("Cannot create an offscreen OpenGL context\n");
+		return 1;
+	}
+
+	// The headless context is a 4.5 core profile, GLEW only loads all of its entry points this way
+	glewExperimental = GL_TRUE;
+	glewInit();
+
+	vector<vector<uint16_t>> depthFrames;
+	vector<vector<uint8_t>> colorFrames;
+	createSyntheticFrames(depthFrames, colorFrames);
+
+	for (const Resolution& resolution : resolutions)
+	{
+		benchResolution(resolution, depthFrames, colorFrames);
+	}
+
+	if (!writeJSON(outputPath))
+	{
+		printf("Cannot write %s\n", outputPath.c_str());
+		return 1;
+	}
+
+	printf("Wrote %d results to %s\n", (int)results.size(), outputPath.c_str());
+
+	context.destroy();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+// Offline blue noise generator using the void-and-cluster method (Ulichney 1993).
+// Writes a tileable RGB binary PPM, every channel is an independent blue noise mask.
+//
+// Build: cl /O2 /EHsc bluenoise.cpp   or   g++ -O2 -std=c++11 bluenoise.cpp -o bluenoise
+// Usage: bluenoise [output.ppm] [size] [seed]
+// Default output is ../../media/bluenoise64.ppm, the texture loaded by ARFW's BlueNoise class.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Toroidal gaussian energy of the set pixels, the lowest energy pixel is the largest void
+class EnergyField
+{
+
+private:
+
+	int size;
+	vector<float> kernel;
+	vector<float> energy;
+
+public:
+
+	EnergyField(int size, float sigma) : size(size), kernel(size * size), energy(size * size, 0.0f)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int dx = min(x, size - x);
+				int dy = min(y, size - y);
+				kernel[y * size + x] = exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+			}
+		}
+	}
+
+	void splat(int index, float sign)
+	{
+		int px = index % size;
+		int py = index / size;
+
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int dx = (x - px + size) % size;
+				int dy = (y - py + size) % size;
+				energy[y * size + x] += sign * kernel[dy * size + dx];
+			}
+		}
+	}
+
+	// Tightest cluster among set pixels or largest void among empty ones
+	int find(const vector<char>& pattern, bool findCluster) const
+	{
+		int best = -1;
+
+		for (int i = 0; i < size * size; i++)
+		{
+			if ((pattern[i] != 0) != findCluster) continue;
+
+			if (best < 0 || (findCluster ? energy[i] > energy[best] : energy[i] < energy[best]))
+			{
+				best = i;
+			}
+		}
+
+		return best;
+	}
+};
+
+vector<int> generateRanks(int size, unsigned int seed)
+{
+	const int pixels = size * size;
+	const float sigma = 1.5f;
+
+	default_random_engine generator(seed);
+	uniform_int_distribution<int> randomPixel(0, pixels - 1);
+
+	// Initial binary pattern, roughly a tenth of the pixels set at random
+	vector<char> pattern(pixels, 0);
+	EnergyField field(size, sigma);
+	int ones = 0;
+
+	while (ones < pixels / 10)
+	{
+		int i = randomPixel(generator);
+		if (pattern[i] != 0) continue;
+
+		pattern[i] = 1;
+		field.splat(i, 1.0f);
+		ones++;
+	}
+
+	// Move points from the tightest cluster into the largest void until it settles
+	while (true)
+	{
+		int cluster = field.find(pattern, true);
+		pattern[cluster] = 0;
+		field.splat(cluster, -1.0f);
+
+		int hole = field.find(pattern, false);
+		pattern[hole] = 1;
+		field.splat(hole, 1.0f);
+
+		if (hole == cluster) break;
+	}
+
+	vector<int> ranks(pixels, 0);
+
+	// Phase 1: remove the prototype points cluster by cluster, ranking them downwards
+	{
+		vector<char> prototype = pattern;
+		EnergyField prototypeField = field;
+		int rank = ones;
+
+		while (rank > 0)
+		{
+			int cluster = prototypeField.find(prototype, true);
+			prototype[cluster] = 0;
+			prototypeField.splat(cluster, -1.0f);
+			ranks[cluster] = --rank;
+		}
+	}
+
+	// Phase 2 and 3: fill the largest void until every pixel is ranked
+	// The tightest cluster of empty pixels is the set pixel energy minimum, so one loop covers both phases
+	for (int rank = ones; rank < pixels; rank++)
+	{
+		int hole = field.find(pattern, false);
+		pattern[hole] = 1;
+		field.splat(hole, 1.0f);
+		ranks[hole] = rank;
+	}
+
+	return ranks;
+}
+
+int main(int argc, char** argv)
+{
+	string filepath = (argc > 1) ? argv[1] : "../../media/bluenoise64.ppm";
+	int size = (argc > 2) ? atoi(argv[2]) : 64;
+	unsigned int seed = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1;
+
+	if (size < 4 || size > 256)
+	{
+		printf("Invalid size %d, expected 4 to 256\n", size);
+		return 1;
+	}
+
+	const int pixels = size * size;
+	vector<unsigned char> image(pixels * 3);
+
+	for (int channel = 0; channel < 3; channel++)
+	{
+		printf("Generating channel %d...\n", channel);
+		vector<int> ranks = generateRanks(size, seed + channel * 7919);
+
+		// Ranks are spread uniformly over the 8 bit range
+		for (int i = 0; i < pixels; i++)
+		{
+			image[i * 3 + channel] = (unsigned char)((long long)ranks[i] * 256 / pixels);
+		}
+	}
+
+	FILE* file = fopen(filepath.c_str(), "wb");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", filepath.c_str());
+		return 1;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", size, size);
+	fwrite(&image[0], 1, image.size(), file);
+	fclose(file);
+
+	printf("Written %s\n", filepath.c_str());
+	return 0;
+}
\ No newline at end of file
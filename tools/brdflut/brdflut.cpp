@@ -0,0 +1,186 @@
+// Offline generator of the split sum BRDF lookup table (Karis 2013), the CPU twin of brdf.fs.
+// Writes the scale and bias terms as half floats, ready to be uploaded as an RG16F texture.
+//
+// Build: cl /O2 /EHsc brdflut.cpp   or   g++ -O2 -std=c++11 -pthread brdflut.cpp -o brdflut
+// Usage: brdflut [output.bin] [size] [samples]
+// Default output is ../../media/brdfLUT.bin, the table loaded by ARFW's PBR class.
+//
+// File layout: "BRDF", int32 width, int32 height, width * height * 2 half floats, bottom row first.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const float PI = 3.14159265359f;
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+Vec3 normalize(Vec3 v)
+{
+	float length = sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	return { v.x / length, v.y / length, v.z / length };
+}
+
+float dot(Vec3 a, Vec3 b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float radicalInverse(unsigned int bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+// Normal is fixed to +Z, so the tangent frame is the identity
+Vec3 importanceSampleGGX(float u, float v, float roughness)
+{
+	float a = roughness * roughness;
+
+	float phi = 2.0f * PI * u;
+	float cosTheta = sqrt((1.0f - v) / (1.0f + (a * a - 1.0f) * v));
+	float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+
+	return normalize({ cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta });
+}
+
+float geometrySchlickGGX(float NdotV, float roughness)
+{
+	float k = (roughness * roughness) / 2.0f;
+	return NdotV / (NdotV * (1.0f - k) + k);
+}
+
+void integrateBRDF(float NdotV, float roughness, unsigned int sampleCount, float& scale, float& bias)
+{
+	Vec3 V = { sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV };
+
+	float A = 0.0f;
+	float B = 0.0f;
+
+	for (unsigned int i = 0; i < sampleCount; i++)
+	{
+		Vec3 H = importanceSampleGGX(float(i) / float(sampleCount), radicalInverse(i), roughness);
+		float VdotH = dot(V, H);
+		Vec3 L = normalize({ 2.0f * VdotH * H.x - V.x, 2.0f * VdotH * H.y - V.y, 2.0f * VdotH * H.z - V.z });
+
+		float NdotL = max(L.z, 0.0f);
+		float NdotH = max(H.z, 0.0f);
+		VdotH = max(VdotH, 0.0f);
+
+		if (NdotL > 0.0f)
+		{
+			float G = geometrySchlickGGX(max(NdotV, 0.0f), roughness) * geometrySchlickGGX(NdotL, roughness);
+			float G_Vis = (G * VdotH) / (NdotH * NdotV);
+			float Fc = pow(1.0f - VdotH, 5.0f);
+
+			A += (1.0f - Fc) * G_Vis;
+			B += Fc * G_Vis;
+		}
+	}
+
+	scale = A / float(sampleCount);
+	bias = B / float(sampleCount);
+}
+
+// Round to nearest IEEE half, values of the table are small and positive so infinities never occur
+unsigned short toHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000u;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffffu;
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10) return (unsigned short)sign;
+
+		mantissa |= 0x800000u;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1u) half++;
+		return (unsigned short)(sign | half);
+	}
+
+	if (exponent >= 31) return (unsigned short)(sign | 0x7c00u);
+
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000u) half++;
+	return (unsigned short)half;
+}
+
+int main(int argc, char** argv)
+{
+	string filepath = (argc > 1) ? argv[1] : "../../media/brdfLUT.bin";
+	int size = (argc > 2) ? atoi(argv[2]) : 512;
+	unsigned int sampleCount = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1024;
+
+	if (size < 2 || size > 4096 || sampleCount == 0)
+	{
+		printf("Invalid size %d or sample count %u\n", size, sampleCount);
+		return 1;
+	}
+
+	vector<unsigned short> table(size * size * 2);
+
+	// Rows are interleaved over the threads, every row costs about the same
+	unsigned int threadCount = max(thread::hardware_concurrency(), 1u);
+	vector<thread> threads;
+
+	printf("Integrating %dx%d with %u samples on %u threads...\n", size, size, sampleCount, threadCount);
+
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(thread([&, t]()
+		{
+			for (int y = t; y < size; y += threadCount)
+			{
+				// Texel centers, matching the texture coordinates of the fullscreen quad in brdf.fs
+				float roughness = (y + 0.5f) / size;
+
+				for (int x = 0; x < size; x++)
+				{
+					float NdotV = (x + 0.5f) / size;
+					float scale, bias;
+					integrateBRDF(NdotV, roughness, sampleCount, scale, bias);
+
+					table[(y * size + x) * 2 + 0] = toHalf(scale);
+					table[(y * size + x) * 2 + 1] = toHalf(bias);
+				}
+			}
+		}));
+	}
+
+	for (thread& t : threads) t.join();
+
+	FILE* file = fopen(filepath.c_str(), "wb");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", filepath.c_str());
+		return 1;
+	}
+
+	int header[2] = { size, size };
+	fwrite("BRDF", 1, 4, file);
+	fwrite(header, sizeof(int), 2, file);
+	fwrite(&table[0], sizeof(unsigned short), table.size(), file);
+	fclose(file);
+
+	printf("Written %s\n", filepath.c_str());
+	return 0;
+}
\ No newline at end of file
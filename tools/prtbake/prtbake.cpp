@@ -0,0 +1,415 @@
+// Offline baker of precomputed radiance transfer (Sloan et al. 2002) for static virtual meshes.
+// Projects the visibility weighted clamped cosine of every vertex onto 9 spherical harmonics,
+// self shadowing is traced against the whole model through a bounding volume hierarchy.
+//
+// Build: cl /O2 /EHsc prtbake.cpp /I <assimp>\include <assimp>\lib\assimp.lib
+//        or   g++ -O2 -std=c++11 -pthread prtbake.cpp -lassimp -o prtbake
+// Usage: prtbake model.obj [samples]
+// Writes model.prt next to the model, ARFW's Model class picks it up when loading model.obj.
+//
+// File layout: "PRT9", int32 mesh count, then per mesh int32 vertex count and 9 floats per vertex.
+// Meshes and vertices are in the order Model::processNode creates them, so the same assimp flags are used.
+// Coefficients are divided by the cosine lobe of their band, an unoccluded vertex dotted with the
+// convolved coefficients of shIrradiance.cs gives exactly the irradianceSH() of the lighting pass.
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const float PI = 3.14159265359f;
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+Vec3 operator-(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+Vec3 operator*(Vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+
+float dot(Vec3 a, Vec3 b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Vec3 cross(Vec3 a, Vec3 b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+Vec3 normalize(Vec3 v)
+{
+	float length = sqrt(dot(v, v));
+	return (length > 0.0f) ? v * (1.0f / length) : Vec3{ 0.0f, 1.0f, 0.0f };
+}
+
+Vec3 minimum(Vec3 a, Vec3 b) { return { min(a.x, b.x), min(a.y, b.y), min(a.z, b.z) }; }
+Vec3 maximum(Vec3 a, Vec3 b) { return { max(a.x, b.x), max(a.y, b.y), max(a.z, b.z) }; }
+
+float component(Vec3 v, int axis)
+{
+	return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+}
+
+struct Triangle
+{
+	Vec3 a, b, c;
+};
+
+struct BVHNode
+{
+	Vec3 boundsMin, boundsMax;
+	int first, count; // Leaves reference triangles, inner nodes store the right child in first
+};
+
+struct MeshData
+{
+	vector<Vec3> positions;
+	vector<Vec3> normals;
+};
+
+// Binary BVH over all triangles of the model, split at the median of the longest axis
+class TriangleBVH
+{
+
+private:
+
+	vector<Triangle> triangles;
+	vector<BVHNode> nodes;
+
+	int build(int first, int count, vector<Vec3>& centers)
+	{
+		BVHNode node;
+		node.boundsMin = { 1e30f, 1e30f, 1e30f };
+		node.boundsMax = { -1e30f, -1e30f, -1e30f };
+
+		for (int i = first; i < first + count; i++)
+		{
+			node.boundsMin = minimum(node.boundsMin, minimum(triangles[i].a, minimum(triangles[i].b, triangles[i].c)));
+			node.boundsMax = maximum(node.boundsMax, maximum(triangles[i].a, maximum(triangles[i].b, triangles[i].c)));
+		}
+
+		int index = (int)nodes.size();
+		nodes.push_back(node);
+
+		if (count <= 4)
+		{
+			nodes[index].first = first;
+			nodes[index].count = count;
+			return index;
+		}
+
+		Vec3 extent = node.boundsMax - node.boundsMin;
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+		int middle = first + count / 2;
+
+		// Sort triangles and their centers together through an index permutation
+		vector<int> order(count);
+		for (int i = 0; i < count; i++) order[i] = first + i;
+		nth_element(order.begin(), order.begin() + count / 2, order.end(),
+			[&](int a, int b) { return component(centers[a], axis) < component(centers[b], axis); });
+
+		vector<Triangle> sortedTriangles(count);
+		vector<Vec3> sortedCenters(count);
+		for (int i = 0; i < count; i++)
+		{
+			sortedTriangles[i] = triangles[order[i]];
+			sortedCenters[i] = centers[order[i]];
+		}
+		copy(sortedTriangles.begin(), sortedTriangles.end(), triangles.begin() + first);
+		copy(sortedCenters.begin(), sortedCenters.end(), centers.begin() + first);
+
+		build(first, middle - first, centers);
+		int right = build(middle, first + count - middle, centers);
+		nodes[index].first = right;
+		nodes[index].count = 0;
+		return index;
+	}
+
+	static bool intersectBounds(const BVHNode& node, Vec3 origin, Vec3 inverseDirection, float maxDistance)
+	{
+		float t0 = 0.0f, t1 = maxDistance;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float tNear = (component(node.boundsMin, axis) - component(origin, axis)) * component(inverseDirection, axis);
+			float tFar = (component(node.boundsMax, axis) - component(origin, axis)) * component(inverseDirection, axis);
+			if (tNear > tFar) swap(tNear, tFar);
+			t0 = max(t0, tNear);
+			t1 = min(t1, tFar);
+			if (t0 > t1) return false;
+		}
+
+		return true;
+	}
+
+	// Moller-Trumbore, only whether there is any hit in front of the origin matters
+	static bool intersectTriangle(const Triangle& triangle, Vec3 origin, Vec3 direction, float maxDistance)
+	{
+		Vec3 edge1 = triangle.b - triangle.a;
+		Vec3 edge2 = triangle.c - triangle.a;
+		Vec3 p = cross(direction, edge2);
+		float determinant = dot(edge1, p);
+		if (fabs(determinant) < 1e-12f) return false;
+
+		float inverseDeterminant = 1.0f / determinant;
+		Vec3 s = origin - triangle.a;
+		float u = dot(s, p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f) return false;
+
+		Vec3 q = cross(s, edge1);
+		float v = dot(direction, q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f) return false;
+
+		float t = dot(edge2, q) * inverseDeterminant;
+		return t > 0.0f && t < maxDistance;
+	}
+
+public:
+
+	TriangleBVH(const vector<Triangle>& input) : triangles(input)
+	{
+		vector<Vec3> centers(triangles.size());
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			centers[i] = (triangles[i].a + triangles[i].b + triangles[i].c) * (1.0f / 3.0f);
+		}
+
+		if (!triangles.empty()) build(0, (int)triangles.size(), centers);
+	}
+
+	bool occluded(Vec3 origin, Vec3 direction, float maxDistance) const
+	{
+		if (nodes.empty()) return false;
+
+		Vec3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			int index = stack[--stackSize];
+			const BVHNode& node = nodes[index];
+
+			if (!intersectBounds(node, origin, inverseDirection, maxDistance)) continue;
+
+			if (node.count > 0)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					if (intersectTriangle(triangles[i], origin, direction, maxDistance)) return true;
+				}
+			}
+			else
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = index + 1;
+			}
+		}
+
+		return false;
+	}
+
+};
+
+// Same basis as irradianceSH() in lightingPass.fs
+void evaluateSH(Vec3 n, float sh[9])
+{
+	sh[0] = 0.282095f;
+	sh[1] = 0.488603f * n.y;
+	sh[2] = 0.488603f * n.z;
+	sh[3] = 0.488603f * n.x;
+	sh[4] = 1.092548f * n.x * n.y;
+	sh[5] = 1.092548f * n.y * n.z;
+	sh[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	sh[7] = 1.092548f * n.x * n.z;
+	sh[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+float radicalInverse(unsigned int bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+// Cosine weighted hemisphere directions around the normal, the cosine cancels against the pdf
+void bakeVertex(const TriangleBVH& bvh, Vec3 position, Vec3 normal, unsigned int sampleCount, float bias, float transfer[9])
+{
+	Vec3 tangent = normalize(cross(fabs(normal.y) < 0.999f ? Vec3{ 0.0f, 1.0f, 0.0f } : Vec3{ 1.0f, 0.0f, 0.0f }, normal));
+	Vec3 bitangent = cross(normal, tangent);
+	Vec3 origin = position + normal * bias;
+
+	for (int i = 0; i < 9; i++) transfer[i] = 0.0f;
+
+	for (unsigned int s = 0; s < sampleCount; s++)
+	{
+		float u = (s + 0.5f) / sampleCount;
+		float v = radicalInverse(s);
+		float phi = 2.0f * PI * v;
+		float sinTheta = sqrt(u);
+		float cosTheta = sqrt(1.0f - u);
+
+		Vec3 direction = normalize(tangent * (cos(phi) * sinTheta) + bitangent * (sin(phi) * sinTheta) + normal * cosTheta);
+		if (bvh.occluded(origin, direction, 1e30f)) continue;
+
+		float sh[9];
+		evaluateSH(direction, sh);
+		for (int i = 0; i < 9; i++) transfer[i] += sh[i];
+	}
+
+	// Monte Carlo weight pi / N, then undo the cosine lobe of each band (pi, 2pi/3, pi/4)
+	const float bandLobe[9] = { PI, 2.0f * PI / 3.0f, 2.0f * PI / 3.0f, 2.0f * PI / 3.0f,
+		PI / 4.0f, PI / 4.0f, PI / 4.0f, PI / 4.0f, PI / 4.0f };
+
+	for (int i = 0; i < 9; i++)
+	{
+		transfer[i] *= PI / sampleCount / bandLobe[i];
+	}
+}
+
+void collectMeshes(const aiNode* node, const aiScene* scene, vector<MeshData>& meshes, vector<Triangle>& triangles)
+{
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+	{
+		const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		MeshData data;
+
+		for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+		{
+			data.positions.push_back({ mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z });
+			data.normals.push_back(normalize({ mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z }));
+		}
+
+		for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+		{
+			const aiFace& face = mesh->mFaces[f];
+			if (face.mNumIndices != 3) continue;
+			triangles.push_back({ data.positions[face.mIndices[0]], data.positions[face.mIndices[1]], data.positions[face.mIndices[2]] });
+		}
+
+		meshes.push_back(data);
+	}
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+	{
+		collectMeshes(node->mChildren[i], scene, meshes, triangles);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: prtbake model.obj [samples]\n");
+		return 1;
+	}
+
+	string modelPath = argv[1];
+	unsigned int sampleCount = (argc > 2) ? (unsigned int)atoi(argv[2]) : 512;
+
+	if (sampleCount == 0)
+	{
+		printf("Invalid sample count %u\n", sampleCount);
+		return 1;
+	}
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(modelPath, aiProcess_GenNormals | aiProcess_Triangulate | aiProcess_FlipUVs);
+
+	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		printf("Could not load %s: %s\n", modelPath.c_str(), importer.GetErrorString());
+		return 1;
+	}
+
+	vector<MeshData> meshes;
+	vector<Triangle> triangles;
+	collectMeshes(scene->mRootNode, scene, meshes, triangles);
+
+	printf("Building BVH over %d triangles...\n", (int)triangles.size());
+	TriangleBVH bvh(triangles);
+
+	// Rays start slightly above the surface, relative to the model size so any unit works
+	Vec3 boundsMin = { 1e30f, 1e30f, 1e30f }, boundsMax = { -1e30f, -1e30f, -1e30f };
+	for (const Triangle& triangle : triangles)
+	{
+		boundsMin = minimum(boundsMin, minimum(triangle.a, minimum(triangle.b, triangle.c)));
+		boundsMax = maximum(boundsMax, maximum(triangle.a, maximum(triangle.b, triangle.c)));
+	}
+	Vec3 diagonal = boundsMax - boundsMin;
+	float bias = sqrt(dot(diagonal, diagonal)) * 1e-4f;
+
+	unsigned int threadCount = max(thread::hardware_concurrency(), 1u);
+	vector<vector<float>> transfers(meshes.size());
+
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		const MeshData& mesh = meshes[m];
+		int vertexCount = (int)mesh.positions.size();
+		vector<float>& transfer = transfers[m];
+		transfer.resize(vertexCount * 9);
+
+		printf("Mesh %d: %d vertices with %u samples on %u threads...\n", (int)m, vertexCount, sampleCount, threadCount);
+
+		// Vertices are handed out in small batches, occlusion cost varies a lot over the surface
+		atomic<int> nextVertex(0);
+		vector<thread> threads;
+
+		for (unsigned int t = 0; t < threadCount; t++)
+		{
+			threads.push_back(thread([&]()
+			{
+				for (int first = nextVertex.fetch_add(64); first < vertexCount; first = nextVertex.fetch_add(64))
+				{
+					for (int v = first; v < min(first + 64, vertexCount); v++)
+					{
+						bakeVertex(bvh, mesh.positions[v], mesh.normals[v], sampleCount, bias, &transfer[v * 9]);
+					}
+				}
+			}));
+		}
+
+		for (thread& t : threads) t.join();
+	}
+
+	string filepath = modelPath.substr(0, modelPath.find_last_of('.')) + ".prt";
+	FILE* file = fopen(filepath.c_str(), "wb");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", filepath.c_str());
+		return 1;
+	}
+
+	int meshCount = (int)transfers.size();
+	fwrite("PRT9", 1, 4, file);
+	fwrite(&meshCount, sizeof(int), 1, file);
+
+	for (const vector<float>& transfer : transfers)
+	{
+		int vertexCount = (int)transfer.size() / 9;
+		fwrite(&vertexCount, sizeof(int), 1, file);
+		if (vertexCount > 0) fwrite(&transfer[0], sizeof(float), transfer.size(), file);
+	}
+
+	fclose(file);
+
+	printf("Written %s\n", filepath.c_str());
+	return 0;
+}
\ No newline at end of file